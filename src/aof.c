@@ -743,6 +743,15 @@ void aofOpenIfNeededOnServerStart(void) {
     server.aof_last_incr_size = getAppendOnlyFileSize(aof_name, NULL);
     server.aof_last_incr_fsync_offset = server.aof_last_incr_size;
 
+    /* We don't know which keys the existing INCR AOFs touched, so we can only
+     * track them for compaction if there's nothing in them yet. */
+    if (listLength(server.aof_manifest->incr_aof_list) == 1 && server.aof_last_incr_size == 0) {
+        aofInfo *ai = listNodeValue(listFirst(server.aof_manifest->incr_aof_list));
+        aofResetCompactionKeys(ai->file_seq);
+    } else {
+        aofResetCompactionKeys(0);
+    }
+
     if (incr_aof_len) {
         serverLog(LL_NOTICE, "Opening AOF incr file %s on server start", aof_name);
     } else {
@@ -955,6 +964,7 @@ void stopAppendOnly(void) {
     killAppendOnlyChild();
     sdsfree(server.aof_buf);
     server.aof_buf = sdsempty();
+    aofResetCompactionKeys(0);
 }
 
 /* Called when the user switches from "appendonly no" to "appendonly yes"
@@ -1271,15 +1281,27 @@ sds catAppendOnlyGenericCommand(sds dst, int argc, robj **argv) {
     dst = sdscatlen(dst, buf, len);
 
     for (j = 0; j < argc; j++) {
-        o = getDecodedObject(argv[j]);
+        char llstr[LONG_STR_SIZE];
+        const char *p;
+        size_t plen;
+
+        o = argv[j];
+        if (o->encoding == OBJ_ENCODING_INT) {
+            plen = ll2string(llstr, sizeof(llstr), (long)o->ptr);
+            p = llstr;
+        } else {
+            plen = sdslen(o->ptr);
+            p = o->ptr;
+        }
         buf[0] = '$';
-        len = 1 + ll2string(buf + 1, sizeof(buf) - 1, sdslen(o->ptr));
+        len = 1 + ll2string(buf + 1, sizeof(buf) - 1, plen);
         buf[len++] = '\r';
         buf[len++] = '\n';
-        dst = sdscatlen(dst, buf, len);
-        dst = sdscatlen(dst, o->ptr, sdslen(o->ptr));
-        dst = sdscatlen(dst, "\r\n", 2);
-        decrRefCount(o);
+        dst = sdsMakeRoomFor(dst, len + plen + 2);
+        memcpy(dst + sdslen(dst), buf, len);
+        memcpy(dst + sdslen(dst) + len, p, plen);
+        memcpy(dst + sdslen(dst) + len + plen, "\r\n", 2);
+        sdsIncrLen(dst, len + plen + 2);
     }
     return dst;
 }
@@ -1308,19 +1330,27 @@ sds genAofTimestampAnnotationIfNeeded(int force) {
  *          this is used in order to decide if a `select` command
  *          should also be written to the aof. Value of -1 means
  *          to avoid writing `select` command in any case.
- * argv   - The command to write to the aof.
- * argc   - Number of values in argv
+ * cmd    - The RESP encoding of the command to write to the aof, see
+ *          catAppendOnlyGenericCommand().
+ * len    - Length of cmd in bytes.
+ *
+ * All commands should be propagated the same way in AOF as in replication,
+ * so the caller can share the encoding with replicationFeedReplicasEncoded().
  */
-void feedAppendOnlyFile(int dictid, robj **argv, int argc) {
-    sds buf = sdsempty();
-
+void feedAppendOnlyFile(int dictid, const char *cmd, size_t len) {
     serverAssert(dictid == -1 || (dictid >= 0 && dictid < server.dbnum));
 
+    /* Append to the AOF buffer. This will be flushed on disk just before
+     * of re-entering the event loop, so before the client will get a
+     * positive reply about the operation performed. */
+    int accept =
+        server.aof_state == AOF_ON || (server.aof_state == AOF_WAIT_REWRITE && server.child_type == CHILD_TYPE_AOF);
+
     /* Feed timestamp if needed */
     if (server.aof_timestamp_enabled) {
         sds ts = genAofTimestampAnnotationIfNeeded(0);
         if (ts != NULL) {
-            buf = sdscatsds(buf, ts);
+            if (accept) server.aof_buf = sdscatsds(server.aof_buf, ts);
             sdsfree(ts);
         }
     }
@@ -1331,22 +1361,13 @@ void feedAppendOnlyFile(int dictid, robj **argv, int argc) {
         char seldb[64];
 
         snprintf(seldb, sizeof(seldb), "%d", dictid);
-        buf = sdscatprintf(buf, "*2\r\n$6\r\nSELECT\r\n$%lu\r\n%s\r\n", (unsigned long)strlen(seldb), seldb);
+        if (accept)
+            server.aof_buf = sdscatprintf(server.aof_buf, "*2\r\n$6\r\nSELECT\r\n$%lu\r\n%s\r\n",
+                                          (unsigned long)strlen(seldb), seldb);
         server.aof_selected_db = dictid;
     }
 
-    /* All commands should be propagated the same way in AOF as in replication.
-     * No need for AOF-specific translation. */
-    buf = catAppendOnlyGenericCommand(buf, argc, argv);
-
-    /* Append to the AOF buffer. This will be flushed on disk just before
-     * of re-entering the event loop, so before the client will get a
-     * positive reply about the operation performed. */
-    if (server.aof_state == AOF_ON || (server.aof_state == AOF_WAIT_REWRITE && server.child_type == CHILD_TYPE_AOF)) {
-        server.aof_buf = sdscatlen(server.aof_buf, buf, sdslen(buf));
-    }
-
-    sdsfree(buf);
+    if (accept) server.aof_buf = sdscatlen(server.aof_buf, cmd, len);
 }
 
 /* ----------------------------------------------------------------------------
@@ -1379,6 +1400,121 @@ struct client *createAOFClient(void) {
     return c;
 }
 
+/* Reads the commands of an AOF file in big chunks, so that the protocol is
+ * parsed from memory instead of calling into stdio for every line and every
+ * argument of every command. The FILE keeps its EOF and error flags, so
+ * feof() and ferror() can still be used once the reader reports a failure. */
+#define AOF_READER_BUF_LEN (1024 * 1024)
+
+typedef struct aofReader {
+    FILE *fp;
+    char *buf;
+    size_t pos;   /* Position of the next byte to parse in 'buf'. */
+    size_t len;   /* Bytes available in 'buf'. */
+    off_t offset; /* File offset of buf[pos]. */
+} aofReader;
+
+static void aofReaderInit(aofReader *r, FILE *fp) {
+    r->fp = fp;
+    r->buf = zmalloc(AOF_READER_BUF_LEN);
+    r->pos = r->len = 0;
+    r->offset = ftello(fp);
+}
+
+static void aofReaderRelease(aofReader *r) {
+    zfree(r->buf);
+}
+
+static off_t aofReaderTell(aofReader *r) {
+    return r->offset;
+}
+
+/* Try to have at least 'n' bytes buffered, n <= AOF_READER_BUF_LEN.
+ * Returns the number of bytes available, that is less than 'n' only on
+ * EOF or error. */
+static size_t aofReaderFill(aofReader *r, size_t n) {
+    size_t avail = r->len - r->pos;
+    if (avail >= n) return avail;
+
+    memmove(r->buf, r->buf + r->pos, avail);
+    r->pos = 0;
+    r->len = avail;
+    while (r->len < n) {
+        size_t nread = fread(r->buf + r->len, 1, AOF_READER_BUF_LEN - r->len, r->fp);
+        if (nread == 0) break;
+        r->len += nread;
+    }
+    return r->len;
+}
+
+static void aofReaderConsume(aofReader *r, size_t n) {
+    r->pos += n;
+    r->offset += n;
+}
+
+/* Like fgets(): reads a line, including its newline, truncated to 'size' - 1
+ * bytes. Returns NULL if nothing could be read. */
+static char *aofReaderGets(aofReader *r, char *line, size_t size) {
+    size_t avail = aofReaderFill(r, size - 1);
+    if (avail == 0) return NULL;
+
+    size_t n = avail < size - 1 ? avail : size - 1;
+    char *nl = memchr(r->buf + r->pos, '\n', n);
+    if (nl) n = nl - (r->buf + r->pos) + 1;
+    memcpy(line, r->buf + r->pos, n);
+    line[n] = '\0';
+    aofReaderConsume(r, n);
+    return line;
+}
+
+/* Like fread(dst, n, 1, fp): returns 1 if 'n' bytes were read, 0 otherwise. */
+static int aofReaderRead(aofReader *r, void *dst, size_t n) {
+    size_t avail = r->len - r->pos;
+    if (n <= AOF_READER_BUF_LEN) {
+        avail = aofReaderFill(r, n);
+        if (avail < n) return 0;
+        memcpy(dst, r->buf + r->pos, n);
+        aofReaderConsume(r, n);
+        return 1;
+    }
+
+    /* Big payloads skip the buffer. */
+    memcpy(dst, r->buf + r->pos, avail);
+    aofReaderConsume(r, avail);
+    if (fread((char *)dst + avail, n - avail, 1, r->fp) == 0) return 0;
+    r->offset += n - avail;
+    return 1;
+}
+
+/* Reads a bulk string payload of 'len' bytes, followed by CRLF, as a string
+ * object. Returns NULL on short read. */
+static robj *aofReaderReadArg(aofReader *r, size_t len) {
+    robj *o;
+    char crlf[2];
+
+    if (len <= AOF_READER_BUF_LEN) {
+        /* Create the object straight from the buffer, as the networking code
+         * does from the query buffer, so small arguments get embedded. */
+        if (aofReaderFill(r, len) < len) return NULL;
+        o = createStringObject(r->buf + r->pos, len);
+        aofReaderConsume(r, len);
+    } else {
+        sds argsds = sdsnewlen(SDS_NOINIT, len);
+        if (!aofReaderRead(r, argsds, len)) {
+            sdsfree(argsds);
+            return NULL;
+        }
+        o = createObject(OBJ_STRING, argsds);
+    }
+
+    /* Discard CRLF. */
+    if (!aofReaderRead(r, crlf, 2)) {
+        decrRefCount(o);
+        return NULL;
+    }
+    return o;
+}
+
 /* Replay an append log file. On success AOF_OK or AOF_TRUNCATED is returned,
  * otherwise, one of the following is returned:
  * AOF_OPEN_ERR: Failed to open the AOF file.
@@ -1394,6 +1530,7 @@ int loadSingleAppendOnlyFile(char *filename) {
     off_t valid_before_multi = 0; /* Offset before MULTI command loaded. */
     off_t last_progress_report_size = 0;
     int ret = AOF_OK;
+    aofReader reader = {0};
 
     sds aof_filepath = makePath(server.aof_dirname, filename);
     FILE *fp = fopen(aof_filepath, "r");
@@ -1461,23 +1598,23 @@ int loadSingleAppendOnlyFile(char *filename) {
     }
 
     /* Read the actual AOF file, in REPL format, command by command. */
+    aofReaderInit(&reader, fp);
     while (1) {
         int argc, j;
         unsigned long len;
         robj **argv;
         char buf[AOF_ANNOTATION_LINE_MAX_LEN];
-        sds argsds;
         struct serverCommand *cmd;
 
         /* Serve the clients from time to time */
         if (!(loops++ % 1024)) {
-            off_t progress_delta = ftello(fp) - last_progress_report_size;
+            off_t progress_delta = aofReaderTell(&reader) - last_progress_report_size;
             loadingIncrProgress(progress_delta);
             last_progress_report_size += progress_delta;
             processEventsWhileBlocked();
             processModuleLoadingProgressEvent(1);
         }
-        if (fgets(buf, sizeof(buf), fp) == NULL) {
+        if (aofReaderGets(&reader, buf, sizeof(buf)) == NULL) {
             if (feof(fp)) {
                 break;
             } else {
@@ -1500,7 +1637,7 @@ int loadSingleAppendOnlyFile(char *filename) {
 
         for (j = 0; j < argc; j++) {
             /* Parse the argument len. */
-            char *readres = fgets(buf, sizeof(buf), fp);
+            char *readres = aofReaderGets(&reader, buf, sizeof(buf));
             if (readres == NULL || buf[0] != '$') {
                 fakeClient->argc = j; /* Free up to j-1. */
                 freeClientArgv(fakeClient);
@@ -1512,21 +1649,11 @@ int loadSingleAppendOnlyFile(char *filename) {
             len = strtol(buf + 1, NULL, 10);
 
             /* Read it into a string object. */
-            argsds = sdsnewlen(SDS_NOINIT, len);
-            if (len && fread(argsds, len, 1, fp) == 0) {
-                sdsfree(argsds);
+            if ((argv[j] = aofReaderReadArg(&reader, len)) == NULL) {
                 fakeClient->argc = j; /* Free up to j-1. */
                 freeClientArgv(fakeClient);
                 goto readerr;
             }
-            argv[j] = createObject(OBJ_STRING, argsds);
-
-            /* Discard CRLF. */
-            if (fread(buf, 2, 1, fp) == 0) {
-                fakeClient->argc = j + 1; /* Free up to j. */
-                freeClientArgv(fakeClient);
-                goto readerr;
-            }
         }
 
         /* Command lookup */
@@ -1561,7 +1688,7 @@ int loadSingleAppendOnlyFile(char *filename) {
         /* Clean up. Command code may have changed argv/argc so we use the
          * argv/argc of the client instead of the local variables. */
         freeClientArgv(fakeClient);
-        if (server.aof_load_truncated) valid_up_to = ftello(fp);
+        if (server.aof_load_truncated) valid_up_to = aofReaderTell(&reader);
         if (server.key_load_delay) debugDelay(server.key_load_delay);
     }
 
@@ -1576,7 +1703,7 @@ int loadSingleAppendOnlyFile(char *filename) {
     }
 
 loaded_ok: /* DB loaded, cleanup and return success (AOF_OK or AOF_TRUNCATED). */
-    loadingIncrProgress(ftello(fp) - last_progress_report_size);
+    loadingIncrProgress((reader.buf ? aofReaderTell(&reader) : ftello(fp)) - last_progress_report_size);
     server.aof_state = old_aof_state;
     goto cleanup;
 
@@ -1631,6 +1758,7 @@ cleanup:
     if (fakeClient) freeClient(fakeClient);
     server.current_client = old_cur_client;
     server.executing_client = old_exec_client;
+    aofReaderRelease(&reader);
     fclose(fp);
     sdsfree(aof_filepath);
     return ret;
@@ -2133,7 +2261,7 @@ int rewriteStreamObject(rio *r, robj *key, robj *o) {
                 raxStart(&ri_pel, consumer->pel);
                 raxSeek(&ri_pel, "^", NULL, 0);
                 while (raxNext(&ri_pel)) {
-                    streamNACK *nack = ri_pel.data;
+                    streamNACK *nack = streamLookupNACK(group, ri_pel.key);
                     if (rioWriteStreamPendingEntry(r, key, (char *)ri.key, ri.key_len, consumer, ri_pel.key, nack) ==
                         0) {
                         raxStop(&ri_pel);
@@ -2189,6 +2317,44 @@ werr:
     return 0;
 }
 
+/* Emit the commands needed to rebuild a single key: the value itself using
+ * the most compact variadic commands for its type, followed by a PEXPIREAT
+ * if the key has an expire set ('expiretime' is -1 otherwise).
+ * Return 1 on success, 0 on write error. */
+static int rewriteKeyValue(rio *aof, int dbid, robj *key, robj *o, long long expiretime) {
+    if (o->type == OBJ_STRING) {
+        /* Emit a SET command */
+        char cmd[] = "*3\r\n$3\r\nSET\r\n";
+        if (rioWrite(aof, cmd, sizeof(cmd) - 1) == 0) return 0;
+        /* Key and value */
+        if (rioWriteBulkObject(aof, key) == 0) return 0;
+        if (rioWriteBulkObject(aof, o) == 0) return 0;
+    } else if (o->type == OBJ_LIST) {
+        if (rewriteListObject(aof, key, o) == 0) return 0;
+    } else if (o->type == OBJ_SET) {
+        if (rewriteSetObject(aof, key, o) == 0) return 0;
+    } else if (o->type == OBJ_ZSET) {
+        if (rewriteSortedSetObject(aof, key, o) == 0) return 0;
+    } else if (o->type == OBJ_HASH) {
+        if (rewriteHashObject(aof, key, o) == 0) return 0;
+    } else if (o->type == OBJ_STREAM) {
+        if (rewriteStreamObject(aof, key, o) == 0) return 0;
+    } else if (o->type == OBJ_MODULE) {
+        if (rewriteModuleObject(aof, key, o, dbid) == 0) return 0;
+    } else {
+        serverPanic("Unknown object type");
+    }
+
+    /* Save the expire time */
+    if (expiretime != -1) {
+        char cmd[] = "*3\r\n$9\r\nPEXPIREAT\r\n";
+        if (rioWrite(aof, cmd, sizeof(cmd) - 1) == 0) return 0;
+        if (rioWriteBulkObject(aof, key) == 0) return 0;
+        if (rioWriteBulkLongLong(aof, expiretime) == 0) return 0;
+    }
+    return 1;
+}
+
 int rewriteAppendOnlyFileRio(rio *aof) {
     dictEntry *de;
     int j;
@@ -2231,29 +2397,8 @@ int rewriteAppendOnlyFileRio(rio *aof) {
 
             expiretime = getExpire(db, &key);
 
-            /* Save the key and associated value */
-            if (o->type == OBJ_STRING) {
-                /* Emit a SET command */
-                char cmd[] = "*3\r\n$3\r\nSET\r\n";
-                if (rioWrite(aof, cmd, sizeof(cmd) - 1) == 0) goto werr;
-                /* Key and value */
-                if (rioWriteBulkObject(aof, &key) == 0) goto werr;
-                if (rioWriteBulkObject(aof, o) == 0) goto werr;
-            } else if (o->type == OBJ_LIST) {
-                if (rewriteListObject(aof, &key, o) == 0) goto werr;
-            } else if (o->type == OBJ_SET) {
-                if (rewriteSetObject(aof, &key, o) == 0) goto werr;
-            } else if (o->type == OBJ_ZSET) {
-                if (rewriteSortedSetObject(aof, &key, o) == 0) goto werr;
-            } else if (o->type == OBJ_HASH) {
-                if (rewriteHashObject(aof, &key, o) == 0) goto werr;
-            } else if (o->type == OBJ_STREAM) {
-                if (rewriteStreamObject(aof, &key, o) == 0) goto werr;
-            } else if (o->type == OBJ_MODULE) {
-                if (rewriteModuleObject(aof, &key, o, j) == 0) goto werr;
-            } else {
-                serverPanic("Unknown object type");
-            }
+            /* Save the key, its associated value and expire time */
+            if (rewriteKeyValue(aof, j, &key, o, expiretime) == 0) goto werr;
 
             /* In fork child process, we can try to release memory back to the
              * OS and possibly avoid or decrease COW. We give the dismiss
@@ -2261,14 +2406,6 @@ int rewriteAppendOnlyFileRio(rio *aof) {
             size_t dump_size = aof->processed_bytes - aof_bytes_before_key;
             if (server.in_fork_child) dismissObject(o, dump_size);
 
-            /* Save the expire time */
-            if (expiretime != -1) {
-                char cmd[] = "*3\r\n$9\r\nPEXPIREAT\r\n";
-                if (rioWrite(aof, cmd, sizeof(cmd) - 1) == 0) goto werr;
-                if (rioWriteBulkObject(aof, &key) == 0) goto werr;
-                if (rioWriteBulkLongLong(aof, expiretime) == 0) goto werr;
-            }
-
             /* Update info every 1 second (approximately).
              * in order to avoid calling mstime() on each iteration, we will
              * check the diff every 1024 keys */
@@ -2364,6 +2501,258 @@ werr:
     stopSaving(0);
     return C_ERR;
 }
+
+/* ----------------------------------------------------------------------------
+ * AOF incremental compaction
+ * ------------------------------------------------------------------------- */
+
+/* When a small set of hot keys is responsible for most of the INCR AOF growth,
+ * a full rewrite is wasteful: it forks and serializes the whole dataset just
+ * to drop the intermediate versions of those few keys. As long as we know
+ * every key written since the BASE was created, the INCR AOFs can instead be
+ * replaced by a single new INCR AOF holding only the current value of those
+ * keys (or a DEL for the ones that no longer exist). Loading the BASE and
+ * this new INCR AOF produces the same dataset as loading the original files.
+ *
+ * The keys are collected from the commands propagated to the AOF. Commands
+ * that change the keyspace without naming the keys (FLUSHALL, SWAPDB, MOVE,
+ * FUNCTION LOAD, ...) can't be compacted this way, so they invalidate the
+ * tracking until the next full rewrite starts from a clean state again. The
+ * same happens when more than 'aof-compaction-max-keys' distinct keys were
+ * written, since the compaction runs in the main thread. For the same reason
+ * a compaction that would write more than 'aof-compaction-max-bytes' is given
+ * up, and a full rewrite is done in the background instead. */
+
+/* Forget the tracked keys. 'start_seq' is the sequence of the first INCR AOF
+ * the tracking will cover from now on, or 0 to stop tracking until the next
+ * AOF rewrite. */
+void aofResetCompactionKeys(long long start_seq) {
+    if (server.aof_compaction_keys) {
+        for (int j = 0; j < server.dbnum; j++) {
+            if (server.aof_compaction_keys[j]) dictRelease(server.aof_compaction_keys[j]);
+        }
+        zfree(server.aof_compaction_keys);
+        server.aof_compaction_keys = NULL;
+    }
+    server.aof_compaction_keys_count = 0;
+    server.aof_compaction_start_seq = server.aof_compaction_max_keys ? start_seq : 0;
+}
+
+/* Called for every command propagated to the AOF, in order to remember the
+ * keys it wrote. */
+void aofTrackCompactionKeys(int dictid, robj **argv, int argc) {
+    if (server.aof_compaction_start_seq == 0) return;
+
+    struct serverCommand *cmd = lookupCommand(argv, argc);
+    if (cmd && !(cmd->flags & CMD_WRITE)) return; /* MULTI, EXEC, ... */
+
+    /* The key extraction functions expect the arguments as the client sent
+     * them, while propagated commands may contain integer encoded ones. */
+    robj **keyargv = argv;
+    for (int j = 0; j < argc; j++) {
+        if (sdsEncodedObject(argv[j])) continue;
+        keyargv = zmalloc(sizeof(robj *) * argc);
+        for (j = 0; j < argc; j++) keyargv[j] = getDecodedObject(argv[j]);
+        break;
+    }
+
+    /* MOVE and COPY ... DB write a key in another DB than the one the
+     * command is propagated to. */
+    int crossdb = 0;
+    if (cmd && cmd->proc == moveCommand) crossdb = 1;
+    if (cmd && cmd->proc == copyCommand) {
+        for (int j = 3; j < argc; j++) {
+            if (!strcasecmp(keyargv[j]->ptr, "db")) crossdb = 1;
+        }
+    }
+
+    getKeysResult result;
+    initGetKeysResult(&result);
+    int numkeys = (cmd && !crossdb && dictid >= 0) ? getKeysFromCommand(cmd, keyargv, argc, &result) : 0;
+    if (numkeys == 0) {
+        /* Unknown command, or a write we can't attribute to a set of keys. */
+        aofResetCompactionKeys(0);
+    } else {
+        if (server.aof_compaction_keys == NULL) server.aof_compaction_keys = zcalloc(sizeof(dict *) * server.dbnum);
+        if (server.aof_compaction_keys[dictid] == NULL) server.aof_compaction_keys[dictid] = dictCreate(&setDictType);
+        dict *d = server.aof_compaction_keys[dictid];
+        for (int j = 0; j < numkeys; j++) {
+            sds key = keyargv[result.keys[j].pos]->ptr;
+            if (dictFind(d, key) == NULL) {
+                dictAdd(d, sdsdup(key), NULL);
+                server.aof_compaction_keys_count++;
+            }
+        }
+        if (server.aof_compaction_keys_count > (unsigned long)server.aof_compaction_max_keys)
+            aofResetCompactionKeys(0);
+    }
+    getKeysFreeResult(&result);
+
+    if (keyargv != argv) {
+        for (int j = 0; j < argc; j++) decrRefCount(keyargv[j]);
+        zfree(keyargv);
+    }
+}
+
+/* Write into 'aof' the commands rebuilding the current state of every
+ * tracked key. Return C_OK on success, C_ERR on write error or, setting
+ * '*too_big', when the keys don't fit in 'aof-compaction-max-bytes'. The
+ * memory used by a value is checked before writing it, so that a single big
+ * key can't make us go much over the limit. */
+static int aofCompactionWriteKeys(rio *aof, int *too_big) {
+    size_t max_bytes = server.aof_compaction_max_bytes;
+
+    if (server.aof_timestamp_enabled) {
+        sds ts = genAofTimestampAnnotationIfNeeded(1);
+        int ok = rioWrite(aof, ts, sdslen(ts));
+        sdsfree(ts);
+        if (!ok) return C_ERR;
+    }
+
+    for (int j = 0; j < server.dbnum; j++) {
+        dict *d = server.aof_compaction_keys ? server.aof_compaction_keys[j] : NULL;
+        if (d == NULL || dictSize(d) == 0) continue;
+
+        char selectcmd[] = "*2\r\n$6\r\nSELECT\r\n";
+        if (rioWrite(aof, selectcmd, sizeof(selectcmd) - 1) == 0) return C_ERR;
+        if (rioWriteBulkLongLong(aof, j) == 0) return C_ERR;
+
+        serverDb *db = server.db + j;
+        dictIterator *di = dictGetIterator(d);
+        dictEntry *tde;
+        while ((tde = dictNext(di)) != NULL) {
+            sds keystr = dictGetKey(tde);
+            robj key;
+            initStaticStringObject(key, keystr);
+
+            /* The BASE may hold an older version of the key, so always
+             * start from scratch. */
+            char delcmd[] = "*2\r\n$3\r\nDEL\r\n";
+            if (rioWrite(aof, delcmd, sizeof(delcmd) - 1) == 0 || rioWriteBulkObject(aof, &key) == 0) {
+                dictReleaseIterator(di);
+                return C_ERR;
+            }
+
+            dictEntry *de = dbFind(db, keystr);
+            if (de == NULL) continue;
+            robj *o = dictGetVal(de);
+            if (aof->processed_bytes + objectComputeSize(&key, o, OBJ_COMPUTE_SIZE_DEF_SAMPLES, j) > max_bytes) {
+                *too_big = 1;
+                dictReleaseIterator(di);
+                return C_ERR;
+            }
+            if (rewriteKeyValue(aof, j, &key, o, getExpire(db, &key)) == 0) {
+                dictReleaseIterator(di);
+                return C_ERR;
+            }
+            if (aof->processed_bytes > max_bytes) {
+                *too_big = 1;
+                dictReleaseIterator(di);
+                return C_ERR;
+            }
+        }
+        dictReleaseIterator(di);
+    }
+    return C_OK;
+}
+
+/* Replace all the INCR AOFs with a new one holding only the current value of
+ * the keys written since the BASE AOF was created, without forking. The new
+ * INCR AOF becomes the one we append to.
+ *
+ * Return C_OK if the compaction was performed. C_ERR is returned when it is not
+ * possible (disabled, too many or untracked writes, a child is active, ...) or
+ * failed, in which case the caller should fall back to a full rewrite. */
+int aofCompactIncrFiles(void) {
+    if (server.aof_state != AOF_ON || server.aof_fd == -1 || hasActiveChildProcess()) return C_ERR;
+    if (server.aof_compaction_start_seq == 0 || server.aof_manifest->base_aof_info == NULL) return C_ERR;
+
+    /* The tracked keys must cover every existing INCR AOF: after a failed
+     * rewrite we may still have older INCR AOFs. */
+    aofManifest *am = server.aof_manifest;
+    if (!listLength(am->incr_aof_list)) return C_ERR;
+    aofInfo *first = listNodeValue(listFirst(am->incr_aof_list));
+    if (first->file_seq < server.aof_compaction_start_seq) return C_ERR;
+
+    /* Everything propagated so far must be in the files we are going to
+     * replace, since the compacted AOF is generated from the dataset. */
+    flushAppendOnlyFile(1);
+    if (sdslen(server.aof_buf) || server.aof_last_write_status != C_OK) return C_ERR;
+
+    long long start = ustime();
+    aofManifest *temp_am = aofManifestDup(am);
+    sds new_aof_name = sdsdup(getNewIncrAofName(temp_am));
+    sds new_aof_filepath = makePath(server.aof_dirname, new_aof_name);
+    long long new_aof_seq = temp_am->curr_incr_file_seq;
+    int newfd = -1, too_big = 0;
+    rio aof;
+
+    FILE *fp = fopen(new_aof_filepath, "w");
+    if (!fp) {
+        serverLog(LL_WARNING, "Can't open the append-only file %s: %s", new_aof_name, strerror(errno));
+        goto cleanup;
+    }
+    rioInitWithFile(&aof, fp);
+    int ret = aofCompactionWriteKeys(&aof, &too_big);
+    if (too_big) {
+        serverLog(LL_NOTICE, "AOF incr files compaction given up: more than %lld bytes to write",
+                  server.aof_compaction_max_bytes);
+        goto cleanup;
+    }
+    if (ret == C_ERR || fflush(fp) || valkey_fsync(fileno(fp)) == -1 ||
+        (newfd = dup(fileno(fp))) == -1) {
+        serverLog(LL_WARNING, "Error writing the compacted append-only file %s: %s", new_aof_name, strerror(errno));
+        goto cleanup;
+    }
+    fclose(fp);
+    fp = NULL;
+
+    /* The previous INCR AOFs are now superseded by the new one (the last one
+     * in the list, which is skipped since it's the one we'll write to). */
+    markRewrittenIncrAofAsHistory(temp_am);
+    if (persistAofManifest(temp_am) == C_ERR) goto cleanup;
+
+    /* If reaches here, we can safely modify the `server.aof_manifest`
+     * and `server.aof_fd`. Like in openNewIncrAofForAppend(), the old
+     * INCR AOF is closed in the background, since close() may block when
+     * it releases the last reference to a big file. */
+    aof_background_fsync_and_close(server.aof_fd);
+    server.aof_fd = newfd;
+    server.aof_selected_db = -1;
+    server.aof_last_incr_size = aof.processed_bytes;
+    server.aof_last_incr_fsync_offset = server.aof_last_incr_size;
+    server.aof_last_fsync = server.mstime;
+    atomic_store_explicit(&server.fsynced_reploff_pending, server.primary_repl_offset, memory_order_relaxed);
+    aofManifestFreeAndUpdate(temp_am);
+    server.aof_current_size = getAppendOnlyFileSize(server.aof_manifest->base_aof_info->file_name, NULL) +
+                              server.aof_last_incr_size;
+    server.aof_compaction_start_seq = new_aof_seq;
+    server.stat_aof_compactions++;
+    aofDelHistoryFiles();
+
+    serverLog(LL_NOTICE, "AOF incr files compacted into %s (%lu keys, %lld bytes) in %lld ms", new_aof_name,
+              server.aof_compaction_keys_count, (long long)server.aof_last_incr_size, (ustime() - start) / 1000);
+
+    /* If the hot keys are themselves big, compacting again won't bring the
+     * AOF back under the growth threshold: let the next one be a rewrite. */
+    long long base = server.aof_rewrite_base_size ? server.aof_rewrite_base_size : 1;
+    if (server.aof_rewrite_perc && (server.aof_current_size * 100 / base) - 100 >= server.aof_rewrite_perc)
+        aofResetCompactionKeys(0);
+
+    sdsfree(new_aof_name);
+    sdsfree(new_aof_filepath);
+    return C_OK;
+
+cleanup:
+    if (fp) fclose(fp);
+    if (newfd != -1) close(newfd);
+    bg_unlink(new_aof_filepath);
+    sdsfree(new_aof_filepath);
+    sdsfree(new_aof_name);
+    aofManifestFree(temp_am);
+    return C_ERR;
+}
+
 /* ----------------------------------------------------------------------------
  * AOF background rewrite
  * ------------------------------------------------------------------------- */
@@ -2402,6 +2791,18 @@ int rewriteAppendOnlyFileBackground(void) {
         return C_ERR;
     }
 
+    /* If the rewrite succeeds, the INCR AOF we just opened (or the temporary
+     * one that will be renamed to the next INCR AOF) will be the only one, so
+     * start tracking the keys written to it from scratch. */
+    if (server.aof_state == AOF_WAIT_REWRITE) {
+        aofResetCompactionKeys(server.aof_manifest->curr_incr_file_seq + 1);
+    } else if (server.aof_state == AOF_ON) {
+        aofInfo *ai = listNodeValue(listLast(server.aof_manifest->incr_aof_list));
+        aofResetCompactionKeys(ai->file_seq);
+    } else {
+        aofResetCompactionKeys(0);
+    }
+
     if (server.aof_state == AOF_WAIT_REWRITE) {
         /* Wait for all bio jobs related to AOF to drain. This prevents a race
          * between updates to `fsynced_reploff_pending` of the worker thread, belonging
@@ -283,6 +283,10 @@ void *bioProcessBackgroundJobs(void *arg) {
         }
         zfree(job);
 
+        /* Return the objects the job freed to the allocator, no one else
+         * can do it for this thread. */
+        zmalloc_cache_release();
+
         /* Lock again before reiterating the loop, if there are no longer
          * jobs to process we'll block again in pthread_cond_wait(). */
         pthread_mutex_lock(&bio_mutex[worker]);
@@ -571,9 +571,17 @@ static void handleClientsBlockedOnKey(readyList *rl) {
         /* Avoid processing more than the initial count so that we're not stuck
          * in an endless loop in case the reprocessing of the command blocks again. */
         long count = listLength(clients);
+        /* Clients reading the same stream entries can share their reply. */
+        streamSharedRepliesBegin();
         while ((ln = listNext(&li)) && count--) {
             client *receiver = listNodeValue(ln);
             robj *o = lookupKeyReadWithFlags(rl->db, rl->key, LOOKUP_NOEFFECTS);
+            /* Re-executing the command of a client blocked on a stream that
+             * has no new entries for it would only block it again, like all
+             * the consumers of a group but the one that got the new entries. */
+            if (o != NULL && o->type == OBJ_STREAM && receiver->bstate.btype == BLOCKED_STREAM &&
+                !streamHasNewEntriesForClient(receiver, rl->key, o->ptr))
+                continue;
             /* 1. In case new key was added/touched we need to verify it satisfy the
              *    blocked type, since we might process the wrong key type.
              * 2. We want to serve clients blocked on module keys
@@ -589,6 +597,7 @@ static void handleClientsBlockedOnKey(readyList *rl) {
                     moduleUnblockClientOnKey(receiver, rl->key);
             }
         }
+        streamSharedRepliesEnd();
     }
 }
 
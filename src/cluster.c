@@ -121,6 +121,8 @@ void createDumpPayload(rio *payload, robj *o, robj *key, int dbid) {
     /* Serialize the object in an RDB-like format. It consist of an object type
      * byte followed by the serialized object. This is understood by RESTORE. */
     rioInitWithBuffer(payload, sdsempty());
+    /* Keep the payload readable by RESTORE on servers without LZ4. */
+    payload->flags |= RIO_FLAG_LZF_ONLY;
     serverAssert(rdbSaveObjectType(payload, o));
     serverAssert(rdbSaveObject(payload, o, key, dbid));
 
@@ -1024,9 +1026,24 @@ getNodeByQuery(client *c, struct serverCommand *cmd, robj **argv, int argc, int
     int pubsubshard_included =
         (cmd_flags & CMD_PUBSUB) || (c->cmd->proc == execCommand && (c->mstate.cmd_flags & CMD_PUBSUB));
 
+    /* The I/O thread that parsed this command already extracted its keys
+     * and verified they all hash to c->slot. Unless the slot is being migrated
+     * or imported, in which case we need to look the keys up, there is no need
+     * to go over the keys again. */
+    int keys_checked = 0;
+    if (ms == &_ms && c->slot >= 0 && c->io_parsed_cmd == cmd && argv == c->argv) {
+        n = getNodeBySlot(c->slot);
+        if (n != NULL && getMigratingSlotDest(c->slot) == NULL && getImportingSlotSource(c->slot) == NULL) {
+            slot = c->slot;
+            keys_checked = 1;
+        } else {
+            n = NULL;
+        }
+    }
+
     /* Check that all the keys are in the same hash slot, and obtain this
      * slot and the node associated. */
-    for (i = 0; i < ms->count; i++) {
+    for (i = 0; !keys_checked && i < ms->count; i++) {
         struct serverCommand *mcmd;
         robj **margv;
         int margc, numkeys, j;
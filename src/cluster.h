@@ -126,6 +126,5 @@ void clusterCommand(client *c);
 ConnectionType *connTypeOfCluster(void);
 int isNodeAvailable(clusterNode *node);
 long long getNodeReplicationOffset(clusterNode *node);
-sds aggregateClientOutputBuffer(client *c);
 void resetClusterStats(void);
 #endif /* __CLUSTER_H */
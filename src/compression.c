@@ -0,0 +1,64 @@
+/*
+ * Copyright Valkey Contributors.
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ * A thin dispatch layer over the compression libraries, so that the RDB
+ * strings, the quicklist nodes and the replication stream can pick their
+ * codec without calling a specific library directly.
+ */
+
+#include "compression.h"
+#include "lzf.h"
+#include "lz4.h"
+
+#include <limits.h>
+
+typedef struct compressionCodec {
+    /* Both return the number of bytes written to 'out', or 0 if the result
+     * does not fit 'outlen' bytes or the input is invalid. */
+    size_t (*compress)(const void *in, size_t inlen, void *out, size_t outlen);
+    size_t (*decompress)(const void *in, size_t inlen, void *out, size_t outlen);
+} compressionCodec;
+
+static size_t lzfCodecCompress(const void *in, size_t inlen, void *out, size_t outlen) {
+    if (inlen > UINT_MAX) return 0;
+    if (outlen > UINT_MAX) outlen = UINT_MAX;
+    return lzf_compress(in, inlen, out, outlen);
+}
+
+static size_t lzfCodecDecompress(const void *in, size_t inlen, void *out, size_t outlen) {
+    if (inlen > UINT_MAX || outlen > UINT_MAX) return 0;
+    return lzf_decompress(in, inlen, out, outlen);
+}
+
+static size_t lz4CodecCompress(const void *in, size_t inlen, void *out, size_t outlen) {
+    if (inlen > UINT_MAX) return 0;
+    if (outlen > UINT_MAX) outlen = UINT_MAX;
+    return lz4_compress(in, inlen, out, outlen);
+}
+
+static size_t lz4CodecDecompress(const void *in, size_t inlen, void *out, size_t outlen) {
+    if (inlen > UINT_MAX || outlen > UINT_MAX) return 0;
+    return lz4_decompress(in, inlen, out, outlen);
+}
+
+static const compressionCodec codecs[COMPRESSION_CODEC_COUNT] = {
+    [COMPRESSION_CODEC_LZF] = {lzfCodecCompress, lzfCodecDecompress},
+    [COMPRESSION_CODEC_LZ4] = {lz4CodecCompress, lz4CodecDecompress},
+};
+
+/* Compress 'inlen' bytes from 'in' into at most 'outlen' bytes at 'out'.
+ * Returns the compressed length, or 0 if the data could not be compressed
+ * into 'outlen' bytes: callers should then store it uncompressed. */
+size_t compressionCompress(int codec, const void *in, size_t inlen, void *out, size_t outlen) {
+    if (codec < 0 || codec >= COMPRESSION_CODEC_COUNT || inlen == 0) return 0;
+    return codecs[codec].compress(in, inlen, out, outlen);
+}
+
+/* Decompress 'inlen' bytes from 'in' into at most 'outlen' bytes at 'out'.
+ * Returns the decompressed length, or 0 on corrupted input. */
+size_t compressionDecompress(int codec, const void *in, size_t inlen, void *out, size_t outlen) {
+    if (codec < 0 || codec >= COMPRESSION_CODEC_COUNT || inlen == 0) return 0;
+    return codecs[codec].decompress(in, inlen, out, outlen);
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright Valkey Contributors.
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stddef.h>
+
+/* Compression codecs known to the server. The ids are never reused, since
+ * data compressed with a codec may outlive the process that produced it. */
+typedef enum {
+    COMPRESSION_CODEC_LZF = 0,
+    COMPRESSION_CODEC_LZ4 = 1,
+    COMPRESSION_CODEC_COUNT
+} compressionCodecId;
+
+size_t compressionCompress(int codec, const void *in, size_t inlen, void *out, size_t outlen);
+size_t compressionDecompress(int codec, const void *in, size_t inlen, void *out, size_t outlen);
+
+#endif /* COMPRESSION_H */
@@ -28,10 +28,12 @@
 
 #include "crc64.h"
 #include "crcspeed.h"
+#include "crccombine.h"
 #include "serverassert.h"
 static uint64_t crc64_table[8][256] = {{0}};
 
 #define POLY UINT64_C(0xad93d23594c935a9)
+#define CRC64_REVERSED_POLY UINT64_C(0x95ac9329ac4bc9b5)
 /******************** BEGIN GENERATED PYCRC FUNCTIONS ********************/
 /**
  * Generated on Sun Dec 21 14:14:07 2014,
@@ -141,3 +143,10 @@ void crc64_init(void) {
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l) {
     return crcspeed64native(crc64_table, crc, (void *) s, l);
 }
+
+/* Given the crc64 of some data, and the crc64 of the same data followed by
+ * 'suffix_len' more bytes, return the crc64 of these bytes alone, as if they
+ * were computed with crc64(0, ...). Requires crc64_init(). */
+uint64_t crc64_suffix(uint64_t crc_prefix, uint64_t crc_whole, uint64_t suffix_len) {
+    return crc_whole ^ crc64_combine(crc_prefix, 0, suffix_len, CRC64_REVERSED_POLY, 64);
+}
@@ -5,5 +5,6 @@
 
 void crc64_init(void);
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
+uint64_t crc64_suffix(uint64_t crc_prefix, uint64_t crc_whole, uint64_t suffix_len);
 
 #endif
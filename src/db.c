@@ -99,6 +99,8 @@ void updateLFU(robj *val) {
  * in the replication link. */
 robj *lookupKey(serverDb *db, robj *key, int flags) {
     int dict_index = getKVStoreIndexForKey(key->ptr);
+    if (flags & LOOKUP_WRITE && server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, dict_index);
+    if (flags & LOOKUP_WRITE && listLength(server.reply_generators)) replyGeneratorsKeyWillChange(db, key->ptr);
     dictEntry *de = dbFindWithDictIndex(db, key->ptr, dict_index);
     robj *val = NULL;
     if (de) {
@@ -185,6 +187,14 @@ robj *lookupKeyWrite(serverDb *db, robj *key) {
     return lookupKeyWriteWithFlags(db, key, LOOKUP_NONE);
 }
 
+/* Must be called before modifying in place the value of a key that was
+ * looked up for reading, like consumer group commands do with the stream,
+ * so that a forkless BGSAVE saves the old value first. Lookups with
+ * LOOKUP_WRITE already take care of it. */
+void dbKeyWillChange(serverDb *db, robj *key) {
+    if (server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, getKVStoreIndexForKey(key->ptr));
+}
+
 robj *lookupKeyReadOrReply(client *c, robj *key, robj *reply) {
     robj *o = lookupKeyRead(c->db, key);
     if (!o) addReplyOrErrorObject(c, reply);
@@ -209,6 +219,7 @@ robj *lookupKeyWriteOrReply(client *c, robj *key, robj *reply) {
 static void dbAddInternal(serverDb *db, robj *key, robj *val, int update_if_existing) {
     dictEntry *existing;
     int dict_index = getKVStoreIndexForKey(key->ptr);
+    if (server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, dict_index);
     dictEntry *de = kvstoreDictAddRaw(db->keys, dict_index, key->ptr, &existing);
     if (update_if_existing && existing) {
         dbSetValue(db, key, val, 1, existing);
@@ -296,6 +307,8 @@ int dbAddRDBLoad(serverDb *db, sds key, robj *val) {
  * The program is aborted if the key was not already present. */
 static void dbSetValue(serverDb *db, robj *key, robj *val, int overwrite, dictEntry *de) {
     int dict_index = getKVStoreIndexForKey(key->ptr);
+    if (server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, dict_index);
+    if (listLength(server.reply_generators)) replyGeneratorsKeyWillChange(db, key->ptr);
     if (!de) de = kvstoreDictFind(db->keys, dict_index, key->ptr);
     serverAssertWithInfo(NULL, key, de != NULL);
     robj *old = dictGetVal(de);
@@ -410,6 +423,8 @@ robj *dbRandomKey(serverDb *db) {
 int dbGenericDeleteWithDictIndex(serverDb *db, robj *key, int async, int flags, int dict_index) {
     dictEntry **plink;
     int table;
+    if (server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, dict_index);
+    if (listLength(server.reply_generators)) replyGeneratorsKeyWillChange(db, key->ptr);
     dictEntry *de = kvstoreDictTwoPhaseUnlinkFind(db->keys, dict_index, key->ptr, &plink, &table);
     if (de) {
         robj *val = dictGetVal(de);
@@ -559,6 +574,10 @@ long long emptyData(int dbnum, int flags, void(callback)(dict *)) {
         return -1;
     }
 
+    /* Like a BGSAVE child, a forkless BGSAVE can't survive the flush. */
+    rdbForklessSaveAbort();
+    drainAllReplyGenerators();
+
     /* Fire the flushdb modules event. */
     moduleFireServerEvent(VALKEYMODULE_EVENT_FLUSHDB, VALKEYMODULE_SUBEVENT_FLUSHDB_START, &fi);
 
@@ -1563,6 +1582,10 @@ void scanDatabaseForDeletedKeys(serverDb *emptied, serverDb *replaced_with) {
 int dbSwapDatabases(int id1, int id2) {
     if (id1 < 0 || id1 >= server.dbnum || id2 < 0 || id2 >= server.dbnum) return C_ERR;
     if (id1 == id2) return C_OK;
+    /* The forkless BGSAVE tracks its progress by DB id, and so do the
+     * incremental replies. */
+    rdbForklessSaveAbort();
+    drainAllReplyGenerators();
     serverDb aux = server.db[id1];
     serverDb *db1 = &server.db[id1], *db2 = &server.db[id2];
 
@@ -1606,6 +1629,8 @@ int dbSwapDatabases(int id1, int id2) {
  * database (temp) as the main (active) database, the actual freeing of old database
  * (which will now be placed in the temp one) is done later. */
 void swapMainDbWithTempDb(serverDb *tempDb) {
+    rdbForklessSaveAbort();
+    drainAllReplyGenerators();
     for (int i = 0; i < server.dbnum; i++) {
         serverDb aux = server.db[i];
         serverDb *activedb = &server.db[i], *newdb = &tempDb[i];
@@ -1678,7 +1703,9 @@ void swapdbCommand(client *c) {
  *----------------------------------------------------------------------------*/
 
 int removeExpire(serverDb *db, robj *key) {
-    return kvstoreDictDelete(db->expires, getKVStoreIndexForKey(key->ptr), key->ptr) == DICT_OK;
+    int dict_index = getKVStoreIndexForKey(key->ptr);
+    if (server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, dict_index);
+    return kvstoreDictDelete(db->expires, dict_index, key->ptr) == DICT_OK;
 }
 
 /* Set an expire to the specified key. If the expire is set in the context
@@ -1690,6 +1717,7 @@ void setExpire(client *c, serverDb *db, robj *key, long long when) {
 
     /* Reuse the sds from the main dict in the expire dict */
     int dict_index = getKVStoreIndexForKey(key->ptr);
+    if (server.rdb_forkless) rdbForklessSaveKeyWillChange(db, key->ptr, dict_index);
     kde = kvstoreDictFind(db->keys, dict_index, key->ptr);
     serverAssertWithInfo(NULL, key, kde != NULL);
     de = kvstoreDictAddRaw(db->expires, dict_index, dictGetKey(kde), &existing);
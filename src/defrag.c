@@ -195,18 +195,10 @@ luaScript *activeDefragLuaScript(luaScript *script) {
  * and should NOT be accessed. */
 dict *dictDefragTables(dict *d) {
     dict *ret = NULL;
-    dictEntry **newtable;
     /* handle the dict struct */
     if ((ret = activeDefragAlloc(d))) d = ret;
-    /* handle the first hash table */
-    if (!d->ht_table[0]) return ret; /* created but unused */
-    newtable = activeDefragAlloc(d->ht_table[0]);
-    if (newtable) d->ht_table[0] = newtable;
-    /* handle the second hash table */
-    if (d->ht_table[1]) {
-        newtable = activeDefragAlloc(d->ht_table[1]);
-        if (newtable) d->ht_table[1] = newtable;
-    }
+    /* handle the hash tables, including the segments of large ones */
+    dictDefragHashTables(d, activeDefragAlloc);
     return ret;
 }
 
@@ -336,6 +328,8 @@ void activeDefragList(list *l, int val_type) {
 void activeDefragQuickListNode(quicklist *ql, quicklistNode **node_ref) {
     quicklistNode *newnode, *node = *node_ref;
     unsigned char *newzl;
+    /* The positional index refers to nodes by address. */
+    if (node->indexed) quicklistIndexClear(ql);
     if ((newnode = activeDefragAlloc(node))) {
         if (newnode->prev)
             newnode->prev->next = newnode;
@@ -447,8 +441,12 @@ void scanLaterSet(robj *ob, unsigned long *cursor) {
 void scanLaterHash(robj *ob, unsigned long *cursor) {
     if (ob->type != OBJ_HASH || ob->encoding != OBJ_ENCODING_HT) return;
     dict *d = ob->ptr;
+    /* Interned field names are referenced by other hashes and can't be moved,
+     * and embedded ones are moved together with their entry. */
     dictDefragFunctions defragfns = {.defragAlloc = activeDefragAlloc,
-                                     .defragKey = (dictDefragAllocFunction *)activeDefragSds,
+                                     .defragKey = d->type == &hashInternedDictType || d->type->embedded_entry
+                                                      ? NULL
+                                                      : (dictDefragAllocFunction *)activeDefragSds,
                                      .defragVal = (dictDefragAllocFunction *)activeDefragSds};
     *cursor = dictScanDefrag(d, *cursor, scanCallbackCountScanned, &defragfns, NULL);
 }
@@ -494,10 +492,16 @@ void defragHash(serverDb *db, dictEntry *kde) {
     dict *d, *newd;
     serverAssert(ob->type == OBJ_HASH && ob->encoding == OBJ_ENCODING_HT);
     d = ob->ptr;
-    if (dictSize(d) > server.active_defrag_max_scan_fields)
+    if (dictSize(d) > server.active_defrag_max_scan_fields) {
         defragLater(db, kde);
-    else
+    } else if (d->type == &hashInternedDictType || d->type->embedded_entry) {
+        unsigned long cursor = 0;
+        do {
+            scanLaterHash(ob, &cursor);
+        } while (cursor);
+    } else {
         activeDefragSdsDict(d, DEFRAG_SDS_DICT_VAL_IS_SDS);
+    }
     /* defrag the dict struct and tables */
     if ((newd = dictDefragTables(ob->ptr))) ob->ptr = newd;
 }
@@ -608,18 +612,12 @@ typedef struct {
     streamConsumer *c;
 } PendingEntryContext;
 
+/* The consumer PELs hold no values, the NACKs are defragged with the group
+ * PEL, but they point to their consumer, that may have been moved. */
 void *defragStreamConsumerPendingEntry(raxIterator *ri, void *privdata) {
     PendingEntryContext *ctx = privdata;
-    streamNACK *nack = ri->data, *newnack;
-    nack->consumer = ctx->c; /* update nack pointer to consumer */
-    newnack = activeDefragAlloc(nack);
-    if (newnack) {
-        /* update consumer group pointer to the nack */
-        void *prev;
-        raxInsert(ctx->cg->pel, ri->key, ri->key_len, newnack, &prev);
-        serverAssert(prev == nack);
-    }
-    return newnack;
+    streamLookupNACK(ctx->cg, ri->key)->consumer = ctx->c;
+    return NULL;
 }
 
 void *defragStreamConsumer(raxIterator *ri, void *privdata) {
@@ -633,7 +631,7 @@ void *defragStreamConsumer(raxIterator *ri, void *privdata) {
     if (newsds) c->name = newsds;
     if (c->pel) {
         PendingEntryContext pel_ctx = {cg, c};
-        defragRadixTree(&c->pel, 0, defragStreamConsumerPendingEntry, &pel_ctx);
+        defragRadixTree(&c->pel, 0, newc ? defragStreamConsumerPendingEntry : NULL, &pel_ctx);
     }
     return newc; /* returns NULL if c was not defragged */
 }
@@ -642,7 +640,7 @@ void *defragStreamConsumerGroup(raxIterator *ri, void *privdata) {
     streamCG *cg = ri->data;
     UNUSED(privdata);
     if (cg->consumers) defragRadixTree(&cg->consumers, 0, defragStreamConsumer, cg);
-    if (cg->pel) defragRadixTree(&cg->pel, 0, NULL, NULL);
+    if (cg->pel) defragRadixTree(&cg->pel, 1, NULL, NULL);
     return NULL;
 }
 
@@ -682,6 +680,9 @@ void defragKey(defragCtx *ctx, dictEntry *de) {
     robj *newob, *ob;
     unsigned char *newzl;
 
+    /* An incremental reply may be iterating over the value. */
+    if (listLength(server.reply_generators) && keyHasReplyGenerator(db, dictGetKey(de))) return;
+
     /* Try to defrag robj and / or string value. */
     ob = dictGetVal(de);
     if ((newob = activeDefragStringOb(ob))) {
@@ -817,7 +818,9 @@ void defragOtherGlobals(void) {
 /* returns 0 more work may or may not be needed (see non-zero cursor),
  * and 1 if time is up and more work is needed. */
 int defragLaterItem(dictEntry *de, unsigned long *cursor, long long endtime, int dbid) {
-    if (de) {
+    if (de && listLength(server.reply_generators) && keyHasReplyGenerator(&server.db[dbid], dictGetKey(de))) {
+        *cursor = 0; /* an incremental reply may be iterating over the value */
+    } else if (de) {
         robj *ob = dictGetVal(de);
         if (ob->type == OBJ_LIST) {
             return scanLaterList(ob, cursor, endtime);
@@ -1033,9 +1036,12 @@ void activeDefragCycle(void) {
                 if (server.active_defrag_running != 0 && ustime() < endtime) continue;
                 break;
             } else if (current_db == 0) {
-                /* Start a scan from the first database. */
+                /* Start a scan from the first database. Objects kept in the
+                 * allocation caches pin the slabs they live in, so return them
+                 * to the allocator first. */
                 start_scan = ustime();
                 start_stat = server.stat_active_defrag_hits;
+                zmalloc_cache_release();
             }
 
             db = &server.db[current_db];
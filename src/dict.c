@@ -234,7 +234,7 @@ static inline void *decodeMaskedPtr(const dictEntry *de) {
 }
 
 static inline dictEntry *createEntryNormal(void *key, dictEntry *next) {
-    dictEntryNormal *entry = zmalloc(sizeof(dictEntryNormal));
+    dictEntryNormal *entry = zmalloc_cached(sizeof(dictEntryNormal));
     entry->key = key;
     entry->next = next;
     return encodeMaskedPtr(entry, ENTRY_PTR_NORMAL);
@@ -242,7 +242,7 @@ static inline dictEntry *createEntryNormal(void *key, dictEntry *next) {
 
 /* Creates an entry without a value field. */
 static inline dictEntry *createEntryNoValue(void *key, dictEntry *next) {
-    dictEntryNoValue *entry = zmalloc(sizeof(*entry));
+    dictEntryNoValue *entry = zmalloc_cached(sizeof(*entry));
     entry->key = key;
     entry->next = next;
     return encodeMaskedPtr(entry, ENTRY_PTR_NO_VALUE);
@@ -275,6 +275,155 @@ static inline dictEntryNormal *decodeEntryNormal(const dictEntry *de) {
     return decodeMaskedPtr(de);
 }
 
+/* Frees the allocation of an entry, if it has one. The fixed-size entries
+ * go back to the allocation cache they were taken from. */
+static void dictFreeEntryAlloc(dictEntry *de) {
+    if (entryIsNormal(de)) {
+        zfree_cached(decodeEntryNormal(de), sizeof(dictEntryNormal));
+    } else if (entryIsNoValue(de)) {
+        zfree_cached(decodeEntryNoValue(de), sizeof(dictEntryNoValue));
+    } else if (entryIsEmbedded(de)) {
+        zfree(decodeEntryEmbedded(de));
+    }
+}
+
+/* --------------------------- Segmented tables ----------------------------- */
+
+/* Tables with more than DICT_SEGMENT_SIZE buckets are not allocated as one
+ * flat array. Instead ht_table[] points to a directory of segments of
+ * DICT_SEGMENT_SIZE buckets each, and segments are allocated only when a key
+ * is first stored in them. During rehashing, the segments of the old table
+ * are released as soon as the rehashing index moves past them, so expanding
+ * or shrinking a large dict no longer needs both tables fully allocated at
+ * the same time. Smaller tables keep using a flat array, which avoids the
+ * extra indirection where the saving would be negligible anyway. */
+#define DICT_SEGMENT_EXP 16
+#define DICT_SEGMENT_SIZE (1UL << DICT_SEGMENT_EXP)
+#define DICT_SEGMENT_MASK (DICT_SEGMENT_SIZE - 1)
+
+static inline int dictTableIsSegmented(signed char exp) {
+    return exp > DICT_SEGMENT_EXP;
+}
+
+static inline dictEntry ***dictTableSegments(const dict *d, int htidx) {
+    return (dictEntry ***)d->ht_table[htidx];
+}
+
+/* Returns a reference to the bucket at index 'idx' of the given table, or
+ * NULL if the bucket belongs to a segment that isn't allocated, in which case
+ * the bucket is empty. */
+static inline dictEntry **dictBucketRef(const dict *d, int htidx, unsigned long idx) {
+    if (!dictTableIsSegmented(d->ht_size_exp[htidx])) return &d->ht_table[htidx][idx];
+    dictEntry **segment = dictTableSegments(d, htidx)[idx >> DICT_SEGMENT_EXP];
+    return segment ? &segment[idx & DICT_SEGMENT_MASK] : NULL;
+}
+
+static inline dictEntry *dictBucketHead(const dict *d, int htidx, unsigned long idx) {
+    dictEntry **bucket = dictBucketRef(d, htidx, idx);
+    return bucket ? *bucket : NULL;
+}
+
+/* Like dictBucketRef(), but allocates the segment if needed. */
+static dictEntry **dictBucketRefForInsert(dict *d, int htidx, unsigned long idx) {
+    if (!dictTableIsSegmented(d->ht_size_exp[htidx])) return &d->ht_table[htidx][idx];
+    dictEntry ***segment = &dictTableSegments(d, htidx)[idx >> DICT_SEGMENT_EXP];
+    if (*segment == NULL) *segment = zcalloc(DICT_SEGMENT_SIZE * sizeof(dictEntry *));
+    return &(*segment)[idx & DICT_SEGMENT_MASK];
+}
+
+/* Allocates a table of 2^exp empty buckets. Segmented tables only get their
+ * directory allocated, unless malloc_failed is non-NULL: in that case the
+ * caller wants to know upfront whether the memory is available, so all the
+ * segments are allocated too and NULL is returned if any allocation fails.
+ *
+ * Each segment is small enough to be granted by an overcommitting kernel, so
+ * a table larger than the physical memory, like one sized after a corrupt
+ * payload, is refused upfront instead of allocating segments until the
+ * process is killed. */
+static dictEntry **dictAllocTable(signed char exp, int *malloc_failed) {
+    if (!dictTableIsSegmented(exp)) {
+        if (!malloc_failed) return zcalloc(DICTHT_SIZE(exp) * sizeof(dictEntry *));
+        dictEntry **table = ztrycalloc(DICTHT_SIZE(exp) * sizeof(dictEntry *));
+        *malloc_failed = table == NULL;
+        return table;
+    }
+
+    unsigned long segments = DICTHT_SIZE(exp) >> DICT_SEGMENT_EXP;
+    if (!malloc_failed) return zcalloc(segments * sizeof(dictEntry **));
+    size_t memory_size = zmalloc_get_memory_size();
+    dictEntry ***dir = NULL;
+    if (memory_size == 0 || DICTHT_SIZE(exp) * sizeof(dictEntry *) <= memory_size)
+        dir = ztrycalloc(segments * sizeof(dictEntry **));
+    for (unsigned long j = 0; dir && j < segments; j++) {
+        dir[j] = ztrycalloc(DICT_SEGMENT_SIZE * sizeof(dictEntry *));
+        if (dir[j] == NULL) {
+            while (j--) zfree(dir[j]);
+            zfree(dir);
+            dir = NULL;
+        }
+    }
+    *malloc_failed = dir == NULL;
+    return (dictEntry **)dir;
+}
+
+static void dictFreeTable(dictEntry **table, signed char exp) {
+    if (table && dictTableIsSegmented(exp)) {
+        dictEntry ***dir = (dictEntry ***)table;
+        for (unsigned long j = 0; j < DICTHT_SIZE(exp) >> DICT_SEGMENT_EXP; j++) zfree(dir[j]);
+    }
+    zfree(table);
+}
+
+/* Called every time the rehashing index moves forward: once it leaves a
+ * segment of the old table, that segment holds no entries anymore and no key
+ * can be added to it (see dictFindPositionForInsert), so it is released. */
+static void dictReleaseRehashedSegment(dict *d) {
+    if (!dictTableIsSegmented(d->ht_size_exp[0]) || (d->rehashidx & DICT_SEGMENT_MASK) != 0) return;
+    dictEntry ***segment = &dictTableSegments(d, 0)[(d->rehashidx >> DICT_SEGMENT_EXP) - 1];
+    zfree(*segment);
+    *segment = NULL;
+}
+
+/* Returns a reference to a bucket, or NULL if the bucket is empty and its
+ * memory isn't allocated. */
+dictEntry **dictGetBucket(dict *d, int htidx, unsigned long idx) {
+    return dictBucketRef(d, htidx, idx);
+}
+
+/* Calls 'fn' for every allocation holding buckets of the dict's tables. */
+void dictForEachTableAlloc(dict *d, void (*fn)(void *ptr, size_t size)) {
+    for (int htidx = 0; htidx <= 1; htidx++) {
+        if (d->ht_table[htidx] == NULL) continue;
+        signed char exp = d->ht_size_exp[htidx];
+        if (!dictTableIsSegmented(exp)) {
+            fn(d->ht_table[htidx], DICTHT_SIZE(exp) * sizeof(dictEntry *));
+            continue;
+        }
+        dictEntry ***dir = dictTableSegments(d, htidx);
+        unsigned long segments = DICTHT_SIZE(exp) >> DICT_SEGMENT_EXP;
+        for (unsigned long j = 0; j < segments; j++) {
+            if (dir[j]) fn(dir[j], DICT_SEGMENT_SIZE * sizeof(dictEntry *));
+        }
+        fn(dir, segments * sizeof(dictEntry **));
+    }
+}
+
+/* Reallocates the dict's tables using 'defragfn', which returns the new
+ * allocation or NULL if the memory wasn't moved. */
+void dictDefragHashTables(dict *d, dictDefragAllocFunction *defragfn) {
+    for (int htidx = 0; htidx <= 1; htidx++) {
+        if (d->ht_table[htidx] == NULL) continue;
+        dictEntry **newtable = defragfn(d->ht_table[htidx]);
+        if (newtable) d->ht_table[htidx] = newtable;
+        if (!dictTableIsSegmented(d->ht_size_exp[htidx])) continue;
+        dictEntry ***dir = dictTableSegments(d, htidx);
+        for (unsigned long j = 0; j < DICTHT_SIZE(d->ht_size_exp[htidx]) >> DICT_SEGMENT_EXP; j++) {
+            dictEntry **newsegment;
+            if (dir[j] && (newsegment = defragfn(dir[j]))) dir[j] = newsegment;
+        }
+    }
+}
+
 /* ----------------------------- API implementation ------------------------- */
 
 /* Reset hash table parameters already initialized with dictInit()*/
@@ -329,13 +478,8 @@ static int dictResizeWithOptionalCheck(dict *d, unsigned long size, int *malloc_
     if (new_ht_size_exp == d->ht_size_exp[0]) return DICT_ERR;
 
     /* Allocate the new hash table and initialize all pointers to NULL */
-    if (malloc_failed) {
-        new_ht_table = ztrycalloc(newsize * sizeof(dictEntry *));
-        *malloc_failed = new_ht_table == NULL;
-        if (*malloc_failed) return DICT_ERR;
-    } else {
-        new_ht_table = zcalloc(newsize * sizeof(dictEntry *));
-    }
+    new_ht_table = dictAllocTable(new_ht_size_exp, malloc_failed);
+    if (malloc_failed && *malloc_failed) return DICT_ERR;
 
     new_ht_used = 0;
 
@@ -353,7 +497,7 @@ static int dictResizeWithOptionalCheck(dict *d, unsigned long size, int *malloc_
      * it can accept keys. */
     if (d->ht_table[0] == NULL || d->ht_used[0] == 0) {
         if (d->type->rehashingCompleted) d->type->rehashingCompleted(d);
-        if (d->ht_table[0]) zfree(d->ht_table[0]);
+        dictFreeTable(d->ht_table[0], d->ht_size_exp[0]);
         d->ht_size_exp[0] = new_ht_size_exp;
         d->ht_used[0] = new_ht_used;
         d->ht_table[0] = new_ht_table;
@@ -401,7 +545,9 @@ int dictShrink(dict *d, unsigned long size) {
 /* Helper function for `dictRehash` and `dictBucketRehash` which rehashes all the keys
  * in a bucket at index `idx` from the old to the new hash HT. */
 static void rehashEntriesInBucketAtIndex(dict *d, uint64_t idx) {
-    dictEntry *de = d->ht_table[0][idx];
+    dictEntry **bucket = dictBucketRef(d, 0, idx);
+    if (bucket == NULL) return;
+    dictEntry *de = *bucket;
     uint64_t h;
     dictEntry *nextde;
     while (de) {
@@ -416,32 +562,33 @@ static void rehashEntriesInBucketAtIndex(dict *d, uint64_t idx) {
              * to get the bucket index in the smaller table. */
             h = idx & DICTHT_SIZE_MASK(d->ht_size_exp[1]);
         }
+        dictEntry **dst = dictBucketRefForInsert(d, 1, h);
         if (d->type->no_value) {
-            if (d->type->keys_are_odd && !d->ht_table[1][h]) {
+            if (d->type->keys_are_odd && !*dst) {
                 /* Destination bucket is empty and we can store the key
                  * directly without an allocated entry. Free the old entry
                  * if it's an allocated entry. */
                 assert(entryIsKey(key));
-                if (!entryIsKey(de)) zfree(decodeMaskedPtr(de));
+                dictFreeEntryAlloc(de);
                 de = key;
             } else if (entryIsKey(de)) {
                 /* We don't have an allocated entry but we need one. */
-                de = createEntryNoValue(key, d->ht_table[1][h]);
+                de = createEntryNoValue(key, *dst);
             } else {
                 /* Just move the existing entry to the destination table and
                  * update the 'next' field. */
                 assert(entryIsNoValue(de));
-                dictSetNext(de, d->ht_table[1][h]);
+                dictSetNext(de, *dst);
             }
         } else {
-            dictSetNext(de, d->ht_table[1][h]);
+            dictSetNext(de, *dst);
         }
-        d->ht_table[1][h] = de;
+        *dst = de;
         d->ht_used[0]--;
         d->ht_used[1]++;
         de = nextde;
     }
-    d->ht_table[0][idx] = NULL;
+    *bucket = NULL;
 }
 
 /* This checks if we already rehashed the whole table and if more rehashing is required */
@@ -449,7 +596,7 @@ static int dictCheckRehashingCompleted(dict *d) {
     if (d->ht_used[0] != 0) return 0;
 
     if (d->type->rehashingCompleted) d->type->rehashingCompleted(d);
-    zfree(d->ht_table[0]);
+    dictFreeTable(d->ht_table[0], d->ht_size_exp[0]);
     /* Copy the new ht onto the old one */
     d->ht_table[0] = d->ht_table[1];
     d->ht_used[0] = d->ht_used[1];
@@ -485,13 +632,18 @@ int dictRehash(dict *d, int n) {
         /* Note that rehashidx can't overflow as we are sure there are more
          * elements because ht[0].used != 0 */
         assert(DICTHT_SIZE(d->ht_size_exp[0]) > (unsigned long)d->rehashidx);
-        while (d->ht_table[0][d->rehashidx] == NULL) {
+        dictEntry **bucket;
+        while ((bucket = dictBucketRef(d, 0, d->rehashidx)) == NULL || *bucket == NULL) {
+            /* A missing segment is skipped at once, as a single empty visit. */
+            if (bucket == NULL) d->rehashidx |= DICT_SEGMENT_MASK;
             d->rehashidx++;
+            dictReleaseRehashedSegment(d);
             if (--empty_visits == 0) return 1;
         }
         /* Move all the keys in this bucket from the old to the new hash HT */
         rehashEntriesInBucketAtIndex(d, d->rehashidx);
         d->rehashidx++;
+        dictReleaseRehashedSegment(d);
     }
 
     return !dictCheckRehashingCompleted(d);
@@ -586,12 +738,12 @@ dictEntry *dictAddRaw(dict *d, void *key, dictEntry **existing) {
  * splitting dictAddRaw in two parts. Normally, dictAddRaw or dictAdd should be
  * used instead. */
 dictEntry *dictInsertAtPosition(dict *d, void *key, void *position) {
-    dictEntry **bucket = position; /* It's a bucket, but the API hides that. */
+    /* It's a bucket, with the index of its table stored in the lowest bit,
+     * but the API hides that. */
+    int htidx = (uintptr_t)position & 1;
+    dictEntry **bucket = (dictEntry **)((uintptr_t)position & ~(uintptr_t)1);
     dictEntry *entry;
-    /* If rehashing is ongoing, we insert in table 1, otherwise in table 0.
-     * Assert that the provided bucket is the right table. */
-    int htidx = dictIsRehashing(d) ? 1 : 0;
-    assert(bucket >= &d->ht_table[htidx][0] && bucket <= &d->ht_table[htidx][DICTHT_SIZE_MASK(d->ht_size_exp[htidx])]);
+    assert(htidx == 0 || dictIsRehashing(d));
     /* Allocate the memory and store the new entry.
      * Insert the element in top, with the assumption that in a database
      * system it is more likely that recently added entries are accessed
@@ -672,7 +824,7 @@ static dictEntry *dictGenericDelete(dict *d, const void *key, int nofree) {
     idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[0]);
 
     if (dictIsRehashing(d)) {
-        if ((long)idx >= d->rehashidx && d->ht_table[0][idx]) {
+        if ((long)idx >= d->rehashidx && dictBucketHead(d, 0, idx)) {
             /* If we have a valid hash entry at `idx` in ht0, we perform
              * rehash on the bucket at `idx` (being more CPU cache friendly) */
             dictBucketRehash(d, idx);
@@ -686,7 +838,8 @@ static dictEntry *dictGenericDelete(dict *d, const void *key, int nofree) {
     for (table = 0; table <= 1; table++) {
         if (table == 0 && (long)idx < d->rehashidx) continue;
         idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
-        he = d->ht_table[table][idx];
+        dictEntry **bucket = dictBucketRef(d, table, idx);
+        he = bucket ? *bucket : NULL;
         prevHe = NULL;
         while (he) {
             void *he_key = dictGetKey(he);
@@ -695,7 +848,7 @@ static dictEntry *dictGenericDelete(dict *d, const void *key, int nofree) {
                 if (prevHe)
                     dictSetNext(prevHe, dictGetNext(he));
                 else
-                    d->ht_table[table][idx] = dictGetNext(he);
+                    *bucket = dictGetNext(he);
                 if (!nofree) {
                     dictFreeUnlinkedEntry(d, he);
                 }
@@ -761,7 +914,7 @@ void dictFreeUnlinkedEntry(dict *d, dictEntry *he) {
     dictFreeKey(d, he);
     dictFreeVal(d, he);
     /* Clear the dictEntry */
-    if (!entryIsKey(he)) zfree(decodeMaskedPtr(he));
+    dictFreeEntryAlloc(he);
 }
 
 /* Destroy an entire dictionary */
@@ -774,18 +927,23 @@ static int dictClear(dict *d, int htidx, void(callback)(dict *)) {
 
         if (callback && (i & 65535) == 0) callback(d);
 
-        if ((he = d->ht_table[htidx][i]) == NULL) continue;
+        dictEntry **bucket = dictBucketRef(d, htidx, i);
+        if (bucket == NULL) {
+            i |= DICT_SEGMENT_MASK; /* Skip the rest of the missing segment. */
+            continue;
+        }
+        if ((he = *bucket) == NULL) continue;
         while (he) {
             nextHe = dictGetNext(he);
             dictFreeKey(d, he);
             dictFreeVal(d, he);
-            if (!entryIsKey(he)) zfree(decodeMaskedPtr(he));
+            dictFreeEntryAlloc(he);
             d->ht_used[htidx]--;
             he = nextHe;
         }
     }
     /* Free the table and the allocated cache structure */
-    zfree(d->ht_table[htidx]);
+    dictFreeTable(d->ht_table[htidx], d->ht_size_exp[htidx]);
     /* Re-initialize the table */
     dictReset(d, htidx);
     return DICT_OK; /* never fails */
@@ -811,7 +969,7 @@ dictEntry *dictFind(dict *d, const void *key) {
     idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[0]);
 
     if (dictIsRehashing(d)) {
-        if ((long)idx >= d->rehashidx && d->ht_table[0][idx]) {
+        if ((long)idx >= d->rehashidx && dictBucketHead(d, 0, idx)) {
             /* If we have a valid hash entry at `idx` in ht0, we perform
              * rehash on the bucket at `idx` (being more CPU cache friendly) */
             dictBucketRehash(d, idx);
@@ -825,7 +983,7 @@ dictEntry *dictFind(dict *d, const void *key) {
     for (table = 0; table <= 1; table++) {
         if (table == 0 && (long)idx < d->rehashidx) continue;
         idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
-        he = d->ht_table[table][idx];
+        he = dictBucketHead(d, table, idx);
         while (he) {
             void *he_key = dictGetKey(he);
             if (key == he_key || dictCompareKeys(d, key, he_key)) return he;
@@ -869,7 +1027,7 @@ dictEntry *dictTwoPhaseUnlinkFind(dict *d, const void *key, dictEntry ***plink,
     for (table = 0; table <= 1; table++) {
         idx = h & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
         if (table == 0 && (long)idx < d->rehashidx) continue;
-        dictEntry **ref = &d->ht_table[table][idx];
+        dictEntry **ref = dictBucketRef(d, table, idx);
         while (ref && *ref) {
             void *de_key = dictGetKey(*ref);
             if (key == de_key || dictCompareKeys(d, key, de_key)) {
@@ -891,7 +1049,7 @@ void dictTwoPhaseUnlinkFree(dict *d, dictEntry *he, dictEntry **plink, int table
     *plink = dictGetNext(he);
     dictFreeKey(d, he);
     dictFreeVal(d, he);
-    if (!entryIsKey(he)) zfree(decodeMaskedPtr(he));
+    dictFreeEntryAlloc(he);
     dictShrinkIfAutoResizeAllowed(d);
     dictResumeRehashing(d);
 }
@@ -1156,7 +1314,7 @@ dictEntry *dictNext(dictIterator *iter) {
                     break;
                 }
             }
-            iter->entry = iter->d->ht_table[iter->table][iter->index];
+            iter->entry = dictBucketHead(iter->d, iter->table, iter->index);
         } else {
             iter->entry = iter->nextEntry;
         }
@@ -1190,13 +1348,13 @@ dictEntry *dictGetRandomKey(dict *d) {
             /* We are sure there are no elements in indexes from 0
              * to rehashidx-1 */
             h = d->rehashidx + (randomULong() % (dictBuckets(d) - d->rehashidx));
-            he = (h >= s0) ? d->ht_table[1][h - s0] : d->ht_table[0][h];
+            he = (h >= s0) ? dictBucketHead(d, 1, h - s0) : dictBucketHead(d, 0, h);
         } while (he == NULL);
     } else {
         unsigned long m = DICTHT_SIZE_MASK(d->ht_size_exp[0]);
         do {
             h = randomULong() & m;
-            he = d->ht_table[0][h];
+            he = dictBucketHead(d, 0, h);
         } while (he == NULL);
     }
 
@@ -1279,7 +1437,7 @@ unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count) {
                     continue;
             }
             if (i >= DICTHT_SIZE(d->ht_size_exp[j])) continue; /* Out of range for this table. */
-            dictEntry *he = d->ht_table[j][i];
+            dictEntry *he = dictBucketHead(d, j, i);
 
             /* Count contiguous empty buckets, and jump to other
              * locations if they reach 'count' (with a minimum of 5). */
@@ -1340,15 +1498,13 @@ static void dictDefragBucket(dictEntry **bucketref, dictDefragFunctions *defragf
             }
             if (newkey) entry->key = newkey;
         } else if (entryIsEmbedded(de)) {
-            defragfns->defragEntryStartCb(privdata, de);
+            if (defragfns->defragEntryStartCb) defragfns->defragEntryStartCb(privdata, de);
             dictEntryEmbedded *entry = decodeEntryEmbedded(de), *newentry;
             if ((newentry = defragalloc(entry))) {
                 newde = encodeMaskedPtr(newentry, ENTRY_PTR_EMBEDDED);
                 entry = newentry;
-                defragfns->defragEntryFinishCb(privdata, newde);
-            } else {
-                defragfns->defragEntryFinishCb(privdata, NULL);
             }
+            if (defragfns->defragEntryFinishCb) defragfns->defragEntryFinishCb(privdata, newde);
             if (newval) entry->v.val = newval;
         } else {
             assert(entryIsNormal(de));
@@ -1490,6 +1646,17 @@ unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, void *pri
     return dictScanDefrag(d, v, fn, NULL, privdata);
 }
 
+/* Returns 1 if the bucket 'key' hashes to was already visited by the dictScan()
+ * calls that returned the cursor 'v', 0 otherwise (including when the scan is
+ * complete and 'v' is 0 again). The answer is only exact while the table can't
+ * change in size, so the dict must not be rehashing, and the caller must keep
+ * rehashing and automatic resizing paused for the whole scan. */
+int dictScanCursorPassed(dict *d, unsigned long v, const void *key) {
+    assert(!dictIsRehashing(d));
+    unsigned long idx = dictHashKey(d, key) & DICTHT_SIZE_MASK(d->ht_size_exp[0]);
+    return rev(idx) < rev(v);
+}
+
 /* Like dictScan, but additionally reallocates the memory used by the dict
  * entries using the provided allocation function. This feature was added for
  * the active defrag feature.
@@ -1515,9 +1682,9 @@ dictScanDefrag(dict *d, unsigned long v, dictScanFunction *fn, dictDefragFunctio
 
         /* Emit entries at cursor */
         if (defragfns) {
-            dictDefragBucket(&d->ht_table[htidx0][v & m0], defragfns, privdata);
+            dictDefragBucket(dictBucketRef(d, htidx0, v & m0), defragfns, privdata);
         }
-        de = d->ht_table[htidx0][v & m0];
+        de = dictBucketHead(d, htidx0, v & m0);
         while (de) {
             next = dictGetNext(de);
             fn(privdata, de);
@@ -1548,9 +1715,9 @@ dictScanDefrag(dict *d, unsigned long v, dictScanFunction *fn, dictDefragFunctio
 
         /* Emit entries at cursor */
         if (defragfns) {
-            dictDefragBucket(&d->ht_table[htidx0][v & m0], defragfns, privdata);
+            dictDefragBucket(dictBucketRef(d, htidx0, v & m0), defragfns, privdata);
         }
-        de = d->ht_table[htidx0][v & m0];
+        de = dictBucketHead(d, htidx0, v & m0);
         while (de) {
             next = dictGetNext(de);
             fn(privdata, de);
@@ -1562,9 +1729,9 @@ dictScanDefrag(dict *d, unsigned long v, dictScanFunction *fn, dictDefragFunctio
         do {
             /* Emit entries at cursor */
             if (defragfns) {
-                dictDefragBucket(&d->ht_table[htidx1][v & m1], defragfns, privdata);
+                dictDefragBucket(dictBucketRef(d, htidx1, v & m1), defragfns, privdata);
             }
-            de = d->ht_table[htidx1][v & m1];
+            de = dictBucketHead(d, htidx1, v & m1);
             while (de) {
                 next = dictGetNext(de);
                 fn(privdata, de);
@@ -1658,7 +1825,7 @@ void *dictFindPositionForInsert(dict *d, const void *key, dictEntry **existing)
     idx = hash & DICTHT_SIZE_MASK(d->ht_size_exp[0]);
 
     if (dictIsRehashing(d)) {
-        if ((long)idx >= d->rehashidx && d->ht_table[0][idx]) {
+        if ((long)idx >= d->rehashidx && dictBucketHead(d, 0, idx)) {
             /* If we have a valid hash entry at `idx` in ht0, we perform
              * rehash on the bucket at `idx` (being more CPU cache friendly) */
             dictBucketRehash(d, idx);
@@ -1675,7 +1842,7 @@ void *dictFindPositionForInsert(dict *d, const void *key, dictEntry **existing)
         if (table == 0 && (long)idx < d->rehashidx) continue;
         idx = hash & DICTHT_SIZE_MASK(d->ht_size_exp[table]);
         /* Search if this slot does not already contain the given key */
-        he = d->ht_table[table][idx];
+        he = dictBucketHead(d, table, idx);
         while (he) {
             void *he_key = dictGetKey(he);
             if (key == he_key || dictCompareKeys(d, key, he_key)) {
@@ -1688,9 +1855,23 @@ void *dictFindPositionForInsert(dict *d, const void *key, dictEntry **existing)
     }
 
     /* If we are in the process of rehashing the hash table, the bucket is
-     * always returned in the context of the second (new) hash table. */
-    dictEntry **bucket = &d->ht_table[dictIsRehashing(d) ? 1 : 0][idx];
-    return bucket;
+     * normally returned in the context of the second (new) hash table. But if
+     * that bucket lives in a segment that isn't allocated yet, and the key's
+     * bucket in the old table wasn't rehashed yet, we add the key to the old
+     * table instead: it will be moved along with the rest of its bucket, and
+     * the new table's memory keeps growing only as fast as the rehashing
+     * releases the old one. We don't do that while rehashing is held back
+     * (e.g. during a fork), to avoid growing the old table's chains. */
+    int htidx = dictIsRehashing(d) ? 1 : 0;
+    if (htidx == 1 && dictBucketRef(d, 1, idx) == NULL && dict_can_resize == DICT_RESIZE_ENABLE) {
+        unsigned long idx0 = hash & DICTHT_SIZE_MASK(d->ht_size_exp[0]);
+        if ((long)idx0 >= d->rehashidx) {
+            htidx = 0;
+            idx = idx0;
+        }
+    }
+    dictEntry **bucket = dictBucketRefForInsert(d, htidx, idx);
+    return (void *)((uintptr_t)bucket | htidx);
 }
 
 void dictEmpty(dict *d, void(callback)(dict *)) {
@@ -1751,14 +1932,13 @@ dictStats *dictGetStatsHt(dict *d, int htidx, int full) {
     for (unsigned long i = 0; i < DICTHT_SIZE(d->ht_size_exp[htidx]); i++) {
         dictEntry *he;
 
-        if (d->ht_table[htidx][i] == NULL) {
+        if ((he = dictBucketHead(d, htidx, i)) == NULL) {
             clvector[0]++;
             continue;
         }
         stats->buckets++;
         /* For each hash entry on this slot... */
         unsigned long chainlen = 0;
-        he = d->ht_table[htidx][i];
         while (he) {
             chainlen++;
             he = dictGetNext(he);
@@ -135,8 +135,8 @@ typedef struct {
     dictDefragAllocFunction *defragAlloc;   /* Used for entries etc. */
     dictDefragAllocFunction *defragKey;     /* Defrag-realloc keys (optional) */
     dictDefragAllocFunction *defragVal;     /* Defrag-realloc values (optional) */
-    dictDefragEntryCb *defragEntryStartCb;  /* Callback invoked prior to the start of defrag of dictEntry. */
-    dictDefragEntryCb *defragEntryFinishCb; /* Callback invoked after the defrag of dictEntry is tried. */
+    dictDefragEntryCb *defragEntryStartCb;  /* Invoked before an embedded dictEntry is defragged (optional). */
+    dictDefragEntryCb *defragEntryFinishCb; /* Invoked after an embedded dictEntry defrag is tried (optional). */
 } dictDefragFunctions;
 
 /* This is the initial size of every hash table */
@@ -165,6 +165,7 @@ static inline int dictCompareKeys(dict *d, const void *key1, const void *key2) {
 #define dictIsRehashingPaused(d) ((d)->pauserehash > 0)
 #define dictPauseAutoResize(d) ((d)->pauseAutoResize++)
 #define dictResumeAutoResize(d) ((d)->pauseAutoResize--)
+#define dictIsAutoResizePaused(d) ((d)->pauseAutoResize > 0)
 
 /* If our unsigned long type can store a 64 bit number, use a 64 bit PRNG. */
 #if ULONG_MAX >= 0xffffffffffffffff
@@ -215,6 +216,9 @@ uint64_t dictGetUnsignedIntegerVal(const dictEntry *de);
 double dictGetDoubleVal(const dictEntry *de);
 double *dictGetDoubleValPtr(dictEntry *de);
 size_t dictMemUsage(const dict *d);
+dictEntry **dictGetBucket(dict *d, int htidx, unsigned long idx);
+void dictForEachTableAlloc(dict *d, void (*fn)(void *ptr, size_t size));
+void dictDefragHashTables(dict *d, dictDefragAllocFunction *defragfn);
 size_t dictEntryMemUsage(dictEntry *de);
 dictIterator *dictGetIterator(dict *d);
 dictIterator *dictGetSafeIterator(dict *d);
@@ -237,6 +241,7 @@ int dictRehashMicroseconds(dict *d, uint64_t us);
 void dictSetHashFunctionSeed(uint8_t *seed);
 uint8_t *dictGetHashFunctionSeed(void);
 unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, void *privdata);
+int dictScanCursorPassed(dict *d, unsigned long v, const void *key);
 unsigned long
 dictScanDefrag(dict *d, unsigned long v, dictScanFunction *fn, dictDefragFunctions *defragfns, void *privdata);
 uint64_t dictGetHash(dict *d, const void *key);
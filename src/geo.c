@@ -225,8 +225,13 @@ int geoWithinShape(GeoShape *shape, double score, double *xy, double *distance)
     /* Note that geohashGetDistanceIfInRadiusWGS84() takes arguments in
      * reverse order: longitude first, latitude later. */
     if (shape->type == CIRCULAR_TYPE) {
-        if (!geohashGetDistanceIfInRadiusWGS84(shape->xy[0], shape->xy[1], xy[0], xy[1],
-                                               shape->t.radius * shape->conversion, distance))
+        /* The distance is at least the distance in latitude, which is cheap
+         * to compute, so points north or south of the circle skip the
+         * haversine. The margin keeps rounding from rejecting points right
+         * at the edge. */
+        double radius = shape->t.radius * shape->conversion;
+        if (geohashGetLatDistance(shape->xy[1], xy[1]) > radius * (1 + 1e-12)) return C_ERR;
+        if (!geohashGetDistanceIfInRadiusWGS84(shape->xy[0], shape->xy[1], xy[0], xy[1], radius, distance))
             return C_ERR;
     } else if (shape->type == RECTANGLE_TYPE) {
         if (!geohashGetDistanceIfInRectangle(shape->t.r.width * shape->conversion,
@@ -311,97 +316,21 @@ int geoGetPointsInRange(robj *zobj, double min, double max, GeoShape *shape, geo
     return ga->used - origincount;
 }
 
-/* Compute the sorted set scores min (inclusive), max (exclusive) we should
- * query in order to retrieve all the elements inside the specified area
- * 'hash'. The two scores are returned by reference in *min and *max. */
-void scoresOfGeoHashBox(GeoHashBits hash, GeoHashFix52Bits *min, GeoHashFix52Bits *max) {
-    /* We want to compute the sorted set scores that will include all the
-     * elements inside the specified Geohash 'hash', which has as many
-     * bits as specified by hash.step * 2.
-     *
-     * So if step is, for example, 3, and the hash value in binary
-     * is 101010, since our score is 52 bits we want every element which
-     * is in binary: 101010?????????????????????????????????????????????
-     * Where ? can be 0 or 1.
-     *
-     * To get the min score we just use the initial hash value left
-     * shifted enough to get the 52 bit value. Later we increment the
-     * 6 bit prefix (see the hash.bits++ statement), and get the new
-     * prefix: 101011, which we align again to 52 bits to get the maximum
-     * value (which is excluded from the search). So we get everything
-     * between the two following scores (represented in binary):
-     *
-     * 1010100000000000000000000000000000000000000000000000 (included)
-     * and
-     * 1010110000000000000000000000000000000000000000000000 (excluded).
-     */
-    *min = geohashAlign52Bits(hash);
-    hash.bits++;
-    *max = geohashAlign52Bits(hash);
-}
-
-/* Obtain all members between the min/max of this geohash bounding box.
- * Populate a geoArray of GeoPoints by calling geoGetPointsInRange().
- * Return the number of points added to the array. */
-int membersOfGeoHashBox(robj *zobj, GeoHashBits hash, geoArray *ga, GeoShape *shape, unsigned long limit) {
-    GeoHashFix52Bits min, max;
-
-    scoresOfGeoHashBox(hash, &min, &max);
-    return geoGetPointsInRange(zobj, min, max, shape, ga, limit);
-}
-
-/* Search all eight neighbors + self geohash box */
+/* Search the area covered by the eight neighbors + self geohash box.
+ *
+ * Rather than scanning the 9 boxes whole, the boxes are refined into a tighter
+ * covering of the search shape, see geohashCoverShapeWGS84(). Seeking a range
+ * in a listpack is a linear scan, so listpacks get no extra steps, only the
+ * boxes out of reach are skipped. */
 int membersOfAllNeighbors(robj *zobj, const GeoHashRadius *n, GeoShape *shape, geoArray *ga, unsigned long limit) {
-    GeoHashBits neighbors[9];
-    unsigned int i, count = 0, last_processed = 0;
-    int debugmsg = 0;
-
-    neighbors[0] = n->hash;
-    neighbors[1] = n->neighbors.north;
-    neighbors[2] = n->neighbors.south;
-    neighbors[3] = n->neighbors.east;
-    neighbors[4] = n->neighbors.west;
-    neighbors[5] = n->neighbors.north_east;
-    neighbors[6] = n->neighbors.north_west;
-    neighbors[7] = n->neighbors.south_east;
-    neighbors[8] = n->neighbors.south_west;
-
-    /* For each neighbor (*and* our own hashbox), get all the matching
-     * members and add them to the potential result list. */
-    for (i = 0; i < sizeof(neighbors) / sizeof(*neighbors); i++) {
-        if (HASHISZERO(neighbors[i])) {
-            if (debugmsg) D("neighbors[%d] is zero", i);
-            continue;
-        }
+    GeoHashScoreRange ranges[GEO_COVER_MAX_RANGES];
+    int extra_steps = zobj->encoding == OBJ_ENCODING_SKIPLIST ? GEO_COVER_MAX_EXTRA_STEPS : 0;
+    int i, numranges, count = 0;
 
-        /* Debugging info. */
-        if (debugmsg) {
-            GeoHashRange long_range, lat_range;
-            geohashGetCoordRange(&long_range, &lat_range);
-            GeoHashArea myarea = {{0}};
-            geohashDecode(long_range, lat_range, neighbors[i], &myarea);
-
-            /* Dump center square. */
-            D("neighbors[%d]:\n", i);
-            D("area.longitude.min: %f\n", myarea.longitude.min);
-            D("area.longitude.max: %f\n", myarea.longitude.max);
-            D("area.latitude.min: %f\n", myarea.latitude.min);
-            D("area.latitude.max: %f\n", myarea.latitude.max);
-            D("\n");
-        }
-
-        /* When a huge Radius (in the 5000 km range or more) is used,
-         * adjacent neighbors can be the same, leading to duplicated
-         * elements. Skip every range which is the same as the one
-         * processed previously. */
-        if (last_processed && neighbors[i].bits == neighbors[last_processed].bits &&
-            neighbors[i].step == neighbors[last_processed].step) {
-            if (debugmsg) D("Skipping processing of %d, same as previous\n", i);
-            continue;
-        }
+    numranges = geohashCoverShapeWGS84(n, shape, extra_steps, ranges);
+    for (i = 0; i < numranges; i++) {
         if (ga->used && limit && ga->used >= limit) break;
-        count += membersOfGeoHashBox(zobj, neighbors[i], ga, shape, limit);
-        last_processed = i;
+        count += geoGetPointsInRange(zobj, ranges[i].min, ranges[i].max, shape, ga, limit);
     }
     return count;
 }
@@ -38,6 +38,7 @@
 #include "geohash_helper.h"
 #include "debugmacro.h"
 #include <math.h>
+#include <stdlib.h>
 
 #define D_R (M_PI / 180.0)
 #define R_MAJOR 6378137.0
@@ -218,6 +219,151 @@ GeoHashFix52Bits geohashAlign52Bits(const GeoHashBits hash) {
     return bits;
 }
 
+/* Return the largest difference in longitude, in degrees, between the center
+ * of the shape and a point within the shape. This is computed from the same
+ * distances used to test if a point is within the shape, so that it is exact
+ * on a sphere, unlike the bounding box of geohashBoundingBox(). */
+static double geohashShapeLongitudeDelta(GeoShape *shape) {
+    double lat = fabs(deg_rad(shape->xy[1]));
+    double s;
+
+    if (shape->type == CIRCULAR_TYPE) {
+        /* The widest point of a spherical cap of angular radius 'r' centered at
+         * latitude 'lat' is at asin(sin(r) / cos(lat)), unless it contains a pole. */
+        double r = shape->t.radius * shape->conversion / EARTH_RADIUS_IN_METERS;
+        if (lat + r >= M_PI / 2) return 180;
+        s = sin(r) / cos(lat);
+        if (s >= 1) return 180;
+        return rad_deg(asin(s));
+    } else {
+        /* A point is within the width of the rectangle when its distance from
+         * the center's longitude, along a great circle at the point's own
+         * latitude 'plat', is at most w: cos(plat) * sin(dlong / 2) <= sin(w / 2).
+         * This is the widest at the latitude nearest to a pole. */
+        double w = shape->t.r.width / 2 * shape->conversion / EARTH_RADIUS_IN_METERS / 2;
+        double h = shape->t.r.height / 2 * shape->conversion / EARTH_RADIUS_IN_METERS;
+        if (w >= M_PI / 2 || lat + h >= M_PI / 2) return 180;
+        s = sin(w) / cos(lat + h);
+        if (s >= 1) return 180;
+        return rad_deg(2 * asin(s));
+    }
+}
+
+/* Return the largest difference in latitude, in degrees, between the center
+ * of the shape and a point within the shape. */
+static double geohashShapeLatitudeDelta(GeoShape *shape) {
+    double h = shape->type == CIRCULAR_TYPE ? shape->t.radius : shape->t.r.height / 2;
+    return rad_deg(h * shape->conversion / EARTH_RADIUS_IN_METERS);
+}
+
+/* Return the difference in degrees between 'lon' and the nearest longitude in
+ * [min, max], going around the antimeridian when that is nearer. */
+static double geohashLongitudeGap(double lon, double min, double max) {
+    if (lon >= min && lon <= max) return 0;
+    double east = fmod(min - lon + 720, 360);
+    double west = fmod(lon - max + 720, 360);
+    return east < west ? east : west;
+}
+
+static int geohashCompareScoreRanges(const void *a, const void *b) {
+    const GeoHashScoreRange *r1 = a, *r2 = b;
+    if (r1->min != r2->min) return r1->min < r2->min ? -1 : 1;
+    return 0;
+}
+
+static int geohashCompareScoreRangesByDistance(const void *a, const void *b) {
+    const GeoHashScoreRange *r1 = a, *r2 = b;
+    if (r1->distance != r2->distance) return r1->distance < r2->distance ? -1 : 1;
+    return geohashCompareScoreRanges(a, b);
+}
+
+/* Compute the score ranges to scan in order to find all the points within the
+ * shape, given the 9 areas computed for it by geohashCalculateAreasByShapeWGS84().
+ *
+ * The areas are sized after the search radius, so together they usually cover
+ * many times the surface of the shape. To get a tighter covering, every area
+ * is split into 4^extra_steps boxes (the next geohash steps), and the boxes
+ * that are too far from the center to contain a point within the shape are
+ * dropped. Since the boxes of an area are contiguous in score, the remaining
+ * ones are then merged into as few ranges as possible. This is the
+ * same covering as the 9 areas when 'extra_steps' is 0, minus the areas out of
+ * reach.
+ *
+ * The ranges are stored in 'ranges', which must have room for
+ * GEO_COVER_MAX_RANGES entries, nearest to the center first, so that a search
+ * stopping at the first N points finds points near the center. The number of
+ * ranges is returned. */
+int geohashCoverShapeWGS84(const GeoHashRadius *n, GeoShape *shape, int extra_steps, GeoHashScoreRange *ranges) {
+    GeoHashRange long_range, lat_range;
+    GeoHashBits areas[9];
+    int count = 0, merged = 0;
+
+    geohashGetCoordRange(&long_range, &lat_range);
+    areas[0] = n->hash;
+    areas[1] = n->neighbors.north;
+    areas[2] = n->neighbors.south;
+    areas[3] = n->neighbors.east;
+    areas[4] = n->neighbors.west;
+    areas[5] = n->neighbors.north_east;
+    areas[6] = n->neighbors.north_west;
+    areas[7] = n->neighbors.south_east;
+    areas[8] = n->neighbors.south_west;
+
+    if (extra_steps > GEO_COVER_MAX_EXTRA_STEPS) extra_steps = GEO_COVER_MAX_EXTRA_STEPS;
+    if (n->hash.step + extra_steps > GEO_STEP_MAX) extra_steps = GEO_STEP_MAX - n->hash.step;
+
+    /* A small margin, so that rounding never drops a box with a point
+     * right at the edge of the shape. */
+    double max_long_delta = geohashShapeLongitudeDelta(shape) * (1 + 1e-9) + 1e-9;
+    double max_lat_delta = geohashShapeLatitudeDelta(shape) * (1 + 1e-9) + 1e-9;
+    double longitude = shape->xy[0], latitude = shape->xy[1];
+
+    for (int i = 0; i < 9; i++) {
+        if (HASHISZERO(areas[i])) continue;
+
+        uint64_t boxes = 1ULL << (2 * extra_steps);
+        for (uint64_t j = 0; j < boxes; j++) {
+            GeoHashBits box = {.bits = (areas[i].bits << (2 * extra_steps)) | j,
+                               .step = areas[i].step + extra_steps};
+            GeoHashArea area;
+            geohashDecode(long_range, lat_range, box, &area);
+
+            double lat_gap = 0;
+            if (latitude < area.latitude.min)
+                lat_gap = area.latitude.min - latitude;
+            else if (latitude > area.latitude.max)
+                lat_gap = latitude - area.latitude.max;
+            if (lat_gap > max_lat_delta) continue;
+            if (geohashLongitudeGap(longitude, area.longitude.min, area.longitude.max) > max_long_delta) continue;
+
+            GeoHashScoreRange *r = &ranges[count++];
+            r->min = geohashAlign52Bits(box);
+            box.bits++;
+            r->max = geohashAlign52Bits(box);
+            r->distance = geohashGetDistance(longitude, latitude, (area.longitude.min + area.longitude.max) / 2,
+                                             (area.latitude.min + area.latitude.max) / 2);
+        }
+    }
+    if (count == 0) return 0;
+
+    /* Merge the boxes that are adjacent in score. With a huge radius the
+     * same area can show up more than once, so overlapping ranges are
+     * merged too. */
+    qsort(ranges, count, sizeof(*ranges), geohashCompareScoreRanges);
+    for (int i = 1; i < count; i++) {
+        GeoHashScoreRange *last = &ranges[merged];
+        if (ranges[i].min <= last->max) {
+            if (ranges[i].max > last->max) last->max = ranges[i].max;
+            if (ranges[i].distance < last->distance) last->distance = ranges[i].distance;
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    count = merged + 1;
+    qsort(ranges, count, sizeof(*ranges), geohashCompareScoreRangesByDistance);
+    return count;
+}
+
 /* Calculate distance using simplified haversine great circle distance formula.
  * Given longitude diff is 0 the asin(sqrt(a)) on the haversine is asin(sin(abs(u))).
  * arcsin(sin(x)) equal to x when x ∈[−𝜋/2,𝜋/2]. Given latitude is between [−𝜋/2,𝜋/2]
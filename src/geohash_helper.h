@@ -47,10 +47,26 @@ typedef struct {
     GeoHashNeighbors neighbors;
 } GeoHashRadius;
 
+/* A range of sorted set scores, min inclusive and max exclusive, covering
+ * part of a search area. 'distance' is the distance in meters between the
+ * center of the search and the nearest geohash box in the range. */
+typedef struct {
+    GeoHashFix52Bits min;
+    GeoHashFix52Bits max;
+    double distance;
+} GeoHashScoreRange;
+
+/* Every one of the 9 areas of a GeoHashRadius is split into 4^extra_steps
+ * boxes when computing a covering, see geohashCoverShapeWGS84(). */
+#define GEO_COVER_MAX_EXTRA_STEPS 2
+#define GEO_COVER_MAX_RANGES (9 << (2 * GEO_COVER_MAX_EXTRA_STEPS))
+
 uint8_t geohashEstimateStepsByRadius(double range_meters, double lat);
 int geohashBoundingBox(GeoShape *shape, double *bounds);
 GeoHashRadius geohashCalculateAreasByShapeWGS84(GeoShape *shape);
+int geohashCoverShapeWGS84(const GeoHashRadius *n, GeoShape *shape, int extra_steps, GeoHashScoreRange *ranges);
 GeoHashFix52Bits geohashAlign52Bits(const GeoHashBits hash);
+double geohashGetLatDistance(double lat1d, double lat2d);
 double geohashGetDistance(double lon1d, double lat1d, double lon2d, double lat2d);
 int geohashGetDistanceIfInRadius(double x1, double y1, double x2, double y2, double radius, double *distance);
 int geohashGetDistanceIfInRadiusWGS84(double x1, double y1, double x2, double y2, double radius, double *distance);
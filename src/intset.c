@@ -257,6 +257,67 @@ uint8_t intsetFind(intset *is, int64_t value) {
     return valenc <= intrev32ifbe(is->encoding) && intsetSearch(is, value, NULL);
 }
 
+/* Search for 'value' starting at position '*pos', for callers looking up
+ * values in ascending order (e.g. while iterating another intset), with '*pos'
+ * being where the lookup of the previous value ended. The search gallops
+ * forward, doubling its step until it passes 'value', and then binary searches
+ * the last step, so each lookup costs O(log d) where d is the distance from
+ * the previous one. Intersecting sets of similar sizes this way is as fast as
+ * a linear merge, while a much smaller set gets a binary search per element.
+ *
+ * '*pos' is set to the position of 'value' when found, otherwise to the
+ * position where it can be inserted. Returns 1 when found, 0 otherwise. */
+uint8_t intsetSearchFrom(intset *is, int64_t value, uint32_t *pos) {
+    uint64_t len = intrev32ifbe(is->length);
+    uint64_t lo = *pos, hi = *pos, step = 1;
+
+    while (hi < len && _intsetGet(is, hi) < value) {
+        lo = hi + 1;
+        hi += step;
+        step <<= 1;
+    }
+    if (hi > len) hi = len;
+
+    /* The first element not lower than 'value' is within [lo, hi]. */
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (_intsetGet(is, mid) < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *pos = lo;
+    return lo < len && _intsetGet(is, lo) == value;
+}
+
+/* Return a new intset with the union of 'a' and 'b', merged in linear time. */
+intset *intsetUnion(intset *a, intset *b) {
+    uint32_t alen = intrev32ifbe(a->length), blen = intrev32ifbe(b->length);
+    uint32_t i = 0, j = 0, n = 0;
+    intset *is = intsetNew();
+
+    is->encoding = intrev32ifbe(a->encoding) > intrev32ifbe(b->encoding) ? a->encoding : b->encoding;
+    is = intsetResize(is, alen + blen);
+    while (i < alen || j < blen) {
+        int64_t av = i < alen ? _intsetGet(a, i) : 0;
+        int64_t bv = j < blen ? _intsetGet(b, j) : 0;
+        if (j == blen || (i < alen && av < bv)) {
+            _intsetSet(is, n++, av);
+            i++;
+        } else if (i == alen || bv < av) {
+            _intsetSet(is, n++, bv);
+            j++;
+        } else {
+            _intsetSet(is, n++, av);
+            i++;
+            j++;
+        }
+    }
+    is->length = intrev32ifbe(n);
+    if (n < alen + blen) is = intsetResize(is, n);
+    return is;
+}
+
 /* Return random member */
 int64_t intsetRandom(intset *is) {
     uint32_t len = intrev32ifbe(is->length);
@@ -622,7 +622,7 @@ void kvstoreTryResizeDicts(kvstore *kvs, int limit) {
     for (int i = 0; i < limit; i++) {
         int didx = kvs->resize_cursor;
         dict *d = kvstoreGetDict(kvs, didx);
-        if (d && dictShrinkIfNeeded(d) == DICT_ERR) {
+        if (d && !dictIsAutoResizePaused(d) && dictShrinkIfNeeded(d) == DICT_ERR) {
             dictExpandIfNeeded(d);
         }
         kvs->resize_cursor = (didx + 1) % kvs->num_dicts;
@@ -729,6 +729,24 @@ unsigned int kvstoreDictGetSomeKeys(kvstore *kvs, int didx, dictEntry **des, uns
     return dictGetSomeKeys(d, des, count);
 }
 
+/* Pauses rehashing and automatic resizing of the dict at 'didx', so that its
+ * entries keep their bucket until kvstoreDictResumeRehashing() is called. This
+ * lets a scan that spans many calls tell which entries it already visited, see
+ * dictScanCursorPassed(). The dict must exist. */
+void kvstoreDictPauseRehashing(kvstore *kvs, int didx) {
+    dict *d = kvstoreGetDict(kvs, didx);
+    dictPauseRehashing(d);
+    dictPauseAutoResize(d);
+}
+
+void kvstoreDictResumeRehashing(kvstore *kvs, int didx) {
+    dict *d = kvstoreGetDict(kvs, didx);
+    dictResumeAutoResize(d);
+    dictResumeRehashing(d);
+    /* The dict may have been emptied while paused. */
+    freeDictIfNeeded(kvs, didx);
+}
+
 int kvstoreDictExpand(kvstore *kvs, int didx, unsigned long size) {
     dict *d = kvstoreGetDict(kvs, didx);
     if (!d) return DICT_ERR;
@@ -960,6 +960,112 @@ unsigned char *lpAppendInteger(unsigned char *lp, long long lval) {
     return lpInsertInteger(lp, lval, eofptr, LP_BEFORE, NULL);
 }
 
+/* Insert the 'len' elements in the 'entries' array at the specified position
+ * 'p', with 'p' being a listpack element pointer obtained with lpFirst(),
+ * lpLast(), lpNext(), lpPrev() or lpSeek(). The elements are inserted, in the
+ * order they appear in the array, before or after the element pointed by 'p'
+ * depending on the 'where' argument, that can be LP_BEFORE or LP_AFTER.
+ *
+ * Entries with a non-NULL 'sval' are stored as strings of length 'slen',
+ * the others as the integer 'lval'.
+ *
+ * This is equivalent to calling lpInsert() for every element, but all the
+ * elements are encoded first so that the listpack is reallocated and its
+ * tail moved only once, instead of once per element.
+ *
+ * If 'newp' is not NULL, at the end of a successful call '*newp' will be set
+ * to the address of the last element added.
+ *
+ * Returns NULL on out of memory or when the listpack total length would exceed
+ * the max allowed size of 2^32-1, otherwise the new pointer to the listpack
+ * holding the new elements is returned (and the old pointer passed is no
+ * longer considered valid). */
+unsigned char *lpBatchInsert(unsigned char *lp,
+                             unsigned char *p,
+                             int where,
+                             listpackEntry *entries,
+                             unsigned int len,
+                             unsigned char **newp) {
+    struct lpEncodedEntry {
+        int enctype;
+        uint64_t enclen;
+        unsigned char intenc[LP_MAX_INT_ENCODING_LEN];
+        unsigned char backlen[LP_MAX_BACKLEN_SIZE];
+        unsigned long backlen_size;
+    } buf[8], *enc = buf;
+
+    assert(where == LP_BEFORE || where == LP_AFTER);
+    if (len == 0) return lp;
+    if (len > sizeof(buf) / sizeof(buf[0])) enc = lp_malloc(sizeof(*enc) * len);
+
+    /* As in lpInsert(), inserting after an element is inserting before the
+     * next one (that could be the EOF one). */
+    if (where == LP_AFTER) {
+        p = lpSkip(p);
+        ASSERT_INTEGRITY(lp, p);
+    }
+
+    /* Encode all the elements, see lpInsert() for details. */
+    uint64_t addedlen = 0;
+    for (unsigned int i = 0; i < len; i++) {
+        if (entries[i].sval) {
+            enc[i].enctype = lpEncodeGetType(entries[i].sval, entries[i].slen, enc[i].intenc, &enc[i].enclen);
+        } else {
+            enc[i].enctype = LP_ENCODING_INT;
+            lpEncodeIntegerGetType(entries[i].lval, enc[i].intenc, &enc[i].enclen);
+        }
+        enc[i].backlen_size = lpEncodeBacklen(enc[i].backlen, enc[i].enclen);
+        addedlen += enc[i].enclen + enc[i].backlen_size;
+    }
+
+    uint64_t old_listpack_bytes = lpGetTotalBytes(lp);
+    uint64_t new_listpack_bytes = old_listpack_bytes + addedlen;
+    unsigned long poff = p - lp;
+    unsigned char *newlp = lp;
+    if (new_listpack_bytes <= UINT32_MAX && new_listpack_bytes > lp_malloc_size(lp))
+        newlp = lp_realloc(lp, new_listpack_bytes);
+    if (new_listpack_bytes > UINT32_MAX || newlp == NULL) {
+        if (enc != buf) lp_free(enc);
+        return NULL;
+    }
+    lp = newlp;
+
+    /* Make room for all the elements at once, then store them. */
+    unsigned char *dst = lp + poff;
+    memmove(dst + addedlen, dst, old_listpack_bytes - poff);
+    for (unsigned int i = 0; i < len; i++) {
+        if (newp) *newp = dst;
+        if (enc[i].enctype == LP_ENCODING_INT) {
+            memcpy(dst, enc[i].intenc, enc[i].enclen);
+        } else {
+            lpEncodeString(dst, entries[i].sval, entries[i].slen);
+        }
+        dst += enc[i].enclen;
+        memcpy(dst, enc[i].backlen, enc[i].backlen_size);
+        dst += enc[i].backlen_size;
+    }
+
+    /* Update header. */
+    uint32_t num_elements = lpGetNumElements(lp);
+    if (num_elements != LP_HDR_NUMELE_UNKNOWN) {
+        if ((uint64_t)num_elements + len < LP_HDR_NUMELE_UNKNOWN)
+            lpSetNumElements(lp, num_elements + len);
+        else
+            lpSetNumElements(lp, LP_HDR_NUMELE_UNKNOWN);
+    }
+    lpSetTotalBytes(lp, new_listpack_bytes);
+
+    if (enc != buf) lp_free(enc);
+    return lp;
+}
+
+/* Append the 'len' elements in the 'entries' array at the end of the listpack,
+ * see lpBatchInsert(). */
+unsigned char *lpBatchAppend(unsigned char *lp, listpackEntry *entries, unsigned int len) {
+    unsigned char *eofptr = lp + lpGetTotalBytes(lp) - 1;
+    return lpBatchInsert(lp, eofptr, LP_BEFORE, entries, len, NULL);
+}
+
 /* This is just a wrapper for lpInsert() to directly use a string to replace
  * the current element. The function returns the new listpack as return
  * value, and also updates the current cursor by updating '*p'. */
@@ -64,6 +64,13 @@ unsigned char *lpPrepend(unsigned char *lp, unsigned char *s, uint32_t slen);
 unsigned char *lpPrependInteger(unsigned char *lp, long long lval);
 unsigned char *lpAppend(unsigned char *lp, unsigned char *s, uint32_t slen);
 unsigned char *lpAppendInteger(unsigned char *lp, long long lval);
+unsigned char *lpBatchInsert(unsigned char *lp,
+                             unsigned char *p,
+                             int where,
+                             listpackEntry *entries,
+                             unsigned int len,
+                             unsigned char **newp);
+unsigned char *lpBatchAppend(unsigned char *lp, listpackEntry *entries, unsigned int len);
 unsigned char *lpReplace(unsigned char *lp, unsigned char **p, unsigned char *s, uint32_t slen);
 unsigned char *lpReplaceInteger(unsigned char *lp, unsigned char **p, long long lval);
 unsigned char *lpDelete(unsigned char *lp, unsigned char *p, unsigned char **newp);
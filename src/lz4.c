@@ -0,0 +1,179 @@
+/*
+ * Copyright Valkey Contributors.
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ * LZ4 block format compressor and decompressor, see lz4.h.
+ *
+ * A block is a sequence of:
+ *
+ * <token:1> [literal length:N] <literals> <offset:2> [match length:N]
+ *
+ * The high nibble of the token is the number of literals and the low nibble
+ * the length of the match minus LZ4_MIN_MATCH. A nibble of 15 is followed by
+ * bytes added to it, until one is not 255. The offset is little endian and
+ * tells how far back the match starts in the output. The last sequence only
+ * has the token and the literals. The last LZ4_LAST_LITERALS bytes of the
+ * block are always literals, and no match starts in the last LZ4_MF_LIMIT
+ * bytes: decoders rely on this for their fast paths.
+ */
+
+#include "lz4.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_LOG 12
+
+static inline uint32_t lz4Read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4Hash(uint32_t v) {
+    return (v * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Number of bytes needed to store a length 'len' in a sequence, given that
+ * the first 15 fit in the token. */
+static inline size_t lz4LengthBytes(size_t len) {
+    return len < 15 ? 0 : (len - 15) / 255 + 1;
+}
+
+static inline uint8_t *lz4WriteLength(uint8_t *op, size_t len) {
+    if (len < 15) return op;
+    len -= 15;
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/* Write a sequence made of the literals from 'anchor' to 'ip' followed, if
+ * 'mlen' is not zero, by a match of 'mlen' bytes at 'offset'. Returns the
+ * new output position, or NULL if it does not fit before 'oend'. */
+static uint8_t *
+lz4WriteSequence(uint8_t *op, uint8_t *oend, const uint8_t *anchor, const uint8_t *ip, size_t offset, size_t mlen) {
+    size_t lit = ip - anchor;
+    size_t needed = 1 + lz4LengthBytes(lit) + lit;
+    if (mlen) needed += 2 + lz4LengthBytes(mlen - LZ4_MIN_MATCH);
+    if ((size_t)(oend - op) < needed) return NULL;
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((lit < 15 ? lit : 15) << 4);
+    op = lz4WriteLength(op, lit);
+    memcpy(op, anchor, lit);
+    op += lit;
+    if (mlen) {
+        mlen -= LZ4_MIN_MATCH;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        *token |= mlen < 15 ? mlen : 15;
+        op = lz4WriteLength(op, mlen);
+    }
+    return op;
+}
+
+unsigned int lz4_compress(const void *const in_data, unsigned int in_len, void *out_data, unsigned int out_len) {
+    const uint8_t *base = in_data, *ip = base, *anchor = base, *iend = base + in_len;
+    uint8_t *op = out_data, *oend = op + out_len;
+    uint32_t htab[1 << LZ4_HASH_LOG];
+
+    if (in_len > LZ4_MF_LIMIT) {
+        const uint8_t *mflimit = iend - LZ4_MF_LIMIT;
+        const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+
+        memset(htab, 0, sizeof(htab));
+        while (ip < mflimit) {
+            uint32_t seq = lz4Read32(ip);
+            uint32_t h = lz4Hash(seq);
+            const uint8_t *ref = base + htab[h];
+            htab[h] = ip - base;
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || lz4Read32(ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            /* Extend the match backward over the pending literals, then
+             * forward, leaving the last literals alone. */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t *mend = ip + LZ4_MIN_MATCH, *rend = ref + LZ4_MIN_MATCH;
+            while (mend < matchlimit && *mend == *rend) {
+                mend++;
+                rend++;
+            }
+
+            op = lz4WriteSequence(op, oend, anchor, ip, ip - ref, mend - ip);
+            if (op == NULL) return 0;
+            ip = anchor = mend;
+            /* Index a position inside the match, so that repetitions with
+             * a period shorter than the match are found again. */
+            if (ip < mflimit) htab[lz4Hash(lz4Read32(ip - 2))] = ip - 2 - base;
+        }
+    }
+
+    op = lz4WriteSequence(op, oend, anchor, iend, 0, 0);
+    if (op == NULL) return 0;
+    return op - (uint8_t *)out_data;
+}
+
+/* Read the extra bytes of a length whose nibble was 15. Returns 0 if the
+ * input ends before the length does. */
+static inline int lz4ReadLength(const uint8_t **ip, const uint8_t *iend, size_t *len) {
+    uint8_t b;
+    do {
+        if (*ip >= iend) return 0;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 1;
+}
+
+unsigned int lz4_decompress(const void *const in_data, unsigned int in_len, void *out_data, unsigned int out_len) {
+    const uint8_t *ip = in_data, *iend = ip + in_len;
+    uint8_t *out = out_data, *op = out, *oend = op + out_len;
+
+    if (in_len == 0) return 0;
+    while (1) {
+        if (ip >= iend) return 0;
+        uint8_t token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !lz4ReadLength(&ip, iend, &lit)) return 0;
+        if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit) return 0;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) break; /* The last sequence has no match. */
+
+        if (iend - ip < 2) return 0;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - out)) return 0;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && !lz4ReadLength(&ip, iend, &mlen)) return 0;
+        mlen += LZ4_MIN_MATCH;
+        if ((size_t)(oend - op) < mlen) return 0;
+
+        /* The match may overlap the bytes it produces. */
+        const uint8_t *ref = op - offset;
+        if (offset >= mlen) {
+            memcpy(op, ref, mlen);
+            op += mlen;
+        } else {
+            while (mlen--) *op++ = *ref++;
+        }
+    }
+    return op - out;
+}
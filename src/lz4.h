@@ -0,0 +1,30 @@
+/*
+ * Copyright Valkey Contributors.
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ * Compressor and decompressor for the LZ4 block format, as described in
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ *
+ * Blocks produced here can be decompressed by the reference library
+ * (LZ4_decompress_safe()) and the other way around. Only the block format
+ * is implemented, the frame format is not.
+ */
+
+#ifndef LZ4_H
+#define LZ4_H
+
+/* Compress in_len bytes at in_data into at most out_len bytes at out_data.
+ *
+ * Returns the number of bytes written, or 0 if the result does not fit in
+ * out_len bytes. Like lzf_compress(), callers should pass out_len smaller
+ * than in_len, and store the data uncompressed when 0 is returned. */
+unsigned int lz4_compress(const void *const in_data, unsigned int in_len, void *out_data, unsigned int out_len);
+
+/* Decompress in_len bytes at in_data into at most out_len bytes at out_data.
+ *
+ * Returns the number of bytes written, or 0 if the input is not a valid
+ * LZ4 block or decompresses to more than out_len bytes. */
+unsigned int lz4_decompress(const void *const in_data, unsigned int in_len, void *out_data, unsigned int out_len);
+
+#endif /* LZ4_H */
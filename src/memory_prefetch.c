@@ -80,6 +80,8 @@ typedef struct PrefetchCommandsBatch {
     size_t executed_commands;       /* Number of commands executed in the current batch */
     int *slots;                     /* Array of slots for each key */
     void **keys;                    /* Array of keys to prefetch in the current batch */
+    uint64_t *key_hashes;           /* Dict hash of each key */
+    unsigned char *key_hash_known;  /* Whether the hash was already computed by the I/O thread */
     client **clients;               /* Array of clients in the current batch */
     dict **keys_dicts;              /* Main dict for each key */
     dict **expire_dicts;            /* Expire dict for each key */
@@ -96,6 +98,8 @@ void freePrefetchCommandsBatch(void) {
 
     zfree(batch->clients);
     zfree(batch->keys);
+    zfree(batch->key_hashes);
+    zfree(batch->key_hash_known);
     zfree(batch->keys_dicts);
     zfree(batch->expire_dicts);
     zfree(batch->slots);
@@ -116,6 +120,8 @@ void prefetchCommandsBatchInit(void) {
     batch->max_prefetch_size = max_prefetch_size;
     batch->clients = zcalloc(max_prefetch_size * sizeof(client *));
     batch->keys = zcalloc(max_prefetch_size * sizeof(void *));
+    batch->key_hashes = zcalloc(max_prefetch_size * sizeof(uint64_t));
+    batch->key_hash_known = zcalloc(max_prefetch_size * sizeof(unsigned char));
     batch->keys_dicts = zcalloc(max_prefetch_size * sizeof(dict *));
     batch->expire_dicts = zcalloc(max_prefetch_size * sizeof(dict *));
     batch->slots = zcalloc(max_prefetch_size * sizeof(int));
@@ -133,85 +139,86 @@ void onMaxBatchSizeChange(void) {
 }
 
 /* Prefetch the given pointer and move to the next key in the batch. */
-static void prefetchAndMoveToNextKey(void *addr) {
+static void prefetchAndMoveToNextKey(PrefetchCommandsBatch *b, void *addr) {
     valkey_prefetch(addr);
     /* While the prefetch is in progress, we can continue to the next key */
-    batch->cur_idx = (batch->cur_idx + 1) % batch->key_count;
+    b->cur_idx = (b->cur_idx + 1) % b->key_count;
 }
 
-static void markKeyAsdone(KeyPrefetchInfo *info) {
+static void markKeyAsdone(PrefetchCommandsBatch *b, KeyPrefetchInfo *info) {
     info->state = PREFETCH_DONE;
     server.stat_total_prefetch_entries++;
-    batch->keys_done++;
+    b->keys_done++;
 }
 
 /* Returns the next KeyPrefetchInfo structure that needs to be processed. */
-static KeyPrefetchInfo *getNextPrefetchInfo(void) {
-    size_t start_idx = batch->cur_idx;
+static KeyPrefetchInfo *getNextPrefetchInfo(PrefetchCommandsBatch *b) {
+    size_t start_idx = b->cur_idx;
     do {
-        KeyPrefetchInfo *info = &batch->prefetch_info[batch->cur_idx];
+        KeyPrefetchInfo *info = &b->prefetch_info[b->cur_idx];
         if (info->state != PREFETCH_DONE) return info;
-        batch->cur_idx = (batch->cur_idx + 1) % batch->key_count;
-    } while (batch->cur_idx != start_idx);
+        b->cur_idx = (b->cur_idx + 1) % b->key_count;
+    } while (b->cur_idx != start_idx);
     return NULL;
 }
 
-static void initBatchInfo(dict **dicts) {
-    batch->current_dicts = dicts;
+static void initBatchInfo(PrefetchCommandsBatch *b, dict **dicts) {
+    b->current_dicts = dicts;
 
     /* Initialize the prefetch info */
-    for (size_t i = 0; i < batch->key_count; i++) {
-        KeyPrefetchInfo *info = &batch->prefetch_info[i];
-        if (!batch->current_dicts[i] || dictSize(batch->current_dicts[i]) == 0) {
+    for (size_t i = 0; i < b->key_count; i++) {
+        KeyPrefetchInfo *info = &b->prefetch_info[i];
+        if (!b->current_dicts[i] || dictSize(b->current_dicts[i]) == 0) {
             info->state = PREFETCH_DONE;
-            batch->keys_done++;
+            b->keys_done++;
             continue;
         }
         info->ht_idx = HT_IDX_INVALID;
         info->current_entry = NULL;
         info->state = PREFETCH_BUCKET;
-        info->key_hash = dictHashKey(batch->current_dicts[i], batch->keys[i]);
+        info->key_hash = b->key_hashes[i];
     }
 }
 
 /* Prefetch the bucket of the next hash table index.
  * If no tables are left, move to the PREFETCH_DONE state. */
-static void prefetchBucket(KeyPrefetchInfo *info) {
-    size_t i = batch->cur_idx;
+static void prefetchBucket(PrefetchCommandsBatch *b, KeyPrefetchInfo *info) {
+    size_t i = b->cur_idx;
 
     /* Determine which hash table to use */
     if (info->ht_idx == HT_IDX_INVALID) {
         info->ht_idx = HT_IDX_FIRST;
-    } else if (info->ht_idx == HT_IDX_FIRST && dictIsRehashing(batch->current_dicts[i])) {
+    } else if (info->ht_idx == HT_IDX_FIRST && dictIsRehashing(b->current_dicts[i])) {
         info->ht_idx = HT_IDX_SECOND;
     } else {
         /* No more tables left - mark as done. */
-        markKeyAsdone(info);
+        markKeyAsdone(b, info);
         return;
     }
 
     /* Prefetch the bucket */
-    info->bucket_idx = info->key_hash & DICTHT_SIZE_MASK(batch->current_dicts[i]->ht_size_exp[info->ht_idx]);
-    prefetchAndMoveToNextKey(&batch->current_dicts[i]->ht_table[info->ht_idx][info->bucket_idx]);
+    info->bucket_idx = info->key_hash & DICTHT_SIZE_MASK(b->current_dicts[i]->ht_size_exp[info->ht_idx]);
+    prefetchAndMoveToNextKey(b, dictGetBucket(b->current_dicts[i], info->ht_idx, info->bucket_idx));
     info->current_entry = NULL;
     info->state = PREFETCH_ENTRY;
 }
 
 /* Prefetch the next entry in the bucket and move to the PREFETCH_VALUE state.
  * If no more entries in the bucket, move to the PREFETCH_BUCKET state to look at the next table. */
-static void prefetchEntry(KeyPrefetchInfo *info) {
-    size_t i = batch->cur_idx;
+static void prefetchEntry(PrefetchCommandsBatch *b, KeyPrefetchInfo *info) {
+    size_t i = b->cur_idx;
 
     if (info->current_entry) {
         /* We already found an entry in the bucket - move to the next entry */
         info->current_entry = dictGetNext(info->current_entry);
     } else {
         /* Go to the first entry in the bucket */
-        info->current_entry = batch->current_dicts[i]->ht_table[info->ht_idx][info->bucket_idx];
+        dictEntry **bucket = dictGetBucket(b->current_dicts[i], info->ht_idx, info->bucket_idx);
+        info->current_entry = bucket ? *bucket : NULL;
     }
 
     if (info->current_entry) {
-        prefetchAndMoveToNextKey(info->current_entry);
+        prefetchAndMoveToNextKey(b, info->current_entry);
         info->state = PREFETCH_VALUE;
     } else {
         /* No entry found in the bucket - try the bucket in the next table */
@@ -221,22 +228,22 @@ static void prefetchEntry(KeyPrefetchInfo *info) {
 
 /* Prefetch the entry's value. If the value is found, move to the PREFETCH_VALUE_DATA state.
  * If the value is not found, move to the PREFETCH_ENTRY state to look at the next entry in the bucket. */
-static void prefetchValue(KeyPrefetchInfo *info) {
-    size_t i = batch->cur_idx;
+static void prefetchValue(PrefetchCommandsBatch *b, KeyPrefetchInfo *info) {
+    size_t i = b->cur_idx;
     void *value = dictGetVal(info->current_entry);
 
-    if (dictGetNext(info->current_entry) == NULL && !dictIsRehashing(batch->current_dicts[i])) {
+    if (dictGetNext(info->current_entry) == NULL && !dictIsRehashing(b->current_dicts[i])) {
         /* If this is the last element, we assume a hit and don't compare the keys */
-        prefetchAndMoveToNextKey(value);
+        prefetchAndMoveToNextKey(b, value);
         info->state = PREFETCH_VALUE_DATA;
         return;
     }
 
     void *current_entry_key = dictGetKey(info->current_entry);
-    if (batch->keys[i] == current_entry_key ||
-        dictCompareKeys(batch->current_dicts[i], batch->keys[i], current_entry_key)) {
+    if (b->keys[i] == current_entry_key ||
+        dictCompareKeys(b->current_dicts[i], b->keys[i], current_entry_key)) {
         /* If the key is found, prefetch the value */
-        prefetchAndMoveToNextKey(value);
+        prefetchAndMoveToNextKey(b, value);
         info->state = PREFETCH_VALUE_DATA;
     } else {
         /* Move to the next entry */
@@ -245,12 +252,12 @@ static void prefetchValue(KeyPrefetchInfo *info) {
 }
 
 /* Prefetch the value data if available. */
-static void prefetchValueData(KeyPrefetchInfo *info, GetValueDataFunc get_val_data_func) {
+static void prefetchValueData(PrefetchCommandsBatch *b, KeyPrefetchInfo *info, GetValueDataFunc get_val_data_func) {
     if (get_val_data_func) {
         void *value_data = get_val_data_func(dictGetVal(info->current_entry));
-        if (value_data) prefetchAndMoveToNextKey(value_data);
+        if (value_data) prefetchAndMoveToNextKey(b, value_data);
     }
-    markKeyAsdone(info);
+    markKeyAsdone(b, info);
 }
 
 /* Prefetch dictionary data for an array of keys.
@@ -270,19 +277,20 @@ static void prefetchValueData(KeyPrefetchInfo *info, GetValueDataFunc get_val_da
  * for each key. Instead of waiting for data to be read from memory, it prefetches
  * the data and then moves on to execute the next prefetch for another key.
  *
+ * b - The batch holding the keys to prefetch and their hashes.
  * dicts - An array of dictionaries to prefetch data from.
  * get_val_data_func - A callback function that dictPrefetch can invoke
  * to bring the key's value data closer to the L1 cache as well.
  */
-static void dictPrefetch(dict **dicts, GetValueDataFunc get_val_data_func) {
-    initBatchInfo(dicts);
+static void dictPrefetch(PrefetchCommandsBatch *b, dict **dicts, GetValueDataFunc get_val_data_func) {
+    initBatchInfo(b, dicts);
     KeyPrefetchInfo *info;
-    while ((info = getNextPrefetchInfo())) {
+    while ((info = getNextPrefetchInfo(b))) {
         switch (info->state) {
-        case PREFETCH_BUCKET: prefetchBucket(info); break;
-        case PREFETCH_ENTRY: prefetchEntry(info); break;
-        case PREFETCH_VALUE: prefetchValue(info); break;
-        case PREFETCH_VALUE_DATA: prefetchValueData(info, get_val_data_func); break;
+        case PREFETCH_BUCKET: prefetchBucket(b, info); break;
+        case PREFETCH_ENTRY: prefetchEntry(b, info); break;
+        case PREFETCH_VALUE: prefetchValue(b, info); break;
+        case PREFETCH_VALUE_DATA: prefetchValueData(b, info, get_val_data_func); break;
         default: serverPanic("Unknown prefetch state %d", info->state);
         }
     }
@@ -294,6 +302,14 @@ static void *getObjectValuePtr(const void *val) {
     return (o->type == OBJ_STRING && o->encoding == OBJ_ENCODING_RAW) ? o->ptr : NULL;
 }
 
+/* Helper function to get the data pointer of an object of any type, when
+ * the data is a separate allocation. */
+static void *getObjectDataPtr(const void *val) {
+    robj *o = (robj *)val;
+    if (o->encoding == OBJ_ENCODING_INT || o->encoding == OBJ_ENCODING_EMBSTR) return NULL;
+    return o->ptr;
+}
+
 static void resetCommandsBatch(void) {
     batch->cur_idx = 0;
     batch->keys_done = 0;
@@ -334,11 +350,17 @@ static void prefetchCommands(void) {
 
     /* Prefetch dict keys for all commands. Prefetching is beneficial only if there are more than one key. */
     if (batch->key_count > 1) {
+        /* The main and expires dicts share the same hash function, so hash each
+         * key once, unless the I/O thread already did it. */
+        for (size_t i = 0; i < batch->key_count; i++) {
+            if (!batch->key_hash_known[i]) batch->key_hashes[i] = dictSdsHash(batch->keys[i]);
+        }
+
         server.stat_total_prefetch_batches++;
         /* Prefetch keys from the main dict */
-        dictPrefetch(batch->keys_dicts, getObjectValuePtr);
+        dictPrefetch(batch, batch->keys_dicts, getObjectValuePtr);
         /* Prefetch keys from the expires dict - no value data to prefetch */
-        dictPrefetch(batch->expire_dicts, NULL);
+        dictPrefetch(batch, batch->expire_dicts, NULL);
     }
 }
 
@@ -387,6 +409,8 @@ int addCommandToBatchAndProcessIfFull(client *c) {
         int num_keys = getKeysFromCommand(c->io_parsed_cmd, c->argv, c->argc, &result);
         for (int i = 0; i < num_keys && batch->key_count < batch->max_prefetch_size; i++) {
             batch->keys[batch->key_count] = c->argv[result.keys[i].pos];
+            batch->key_hashes[batch->key_count] = c->io_key_hash;
+            batch->key_hash_known[batch->key_count] = (i == 0);
             batch->slots[batch->key_count] = c->slot > 0 ? c->slot : 0;
             batch->keys_dicts[batch->key_count] = kvstoreGetDict(c->db->keys, batch->slots[batch->key_count]);
             batch->expire_dicts[batch->key_count] = kvstoreGetDict(c->db->expires, batch->slots[batch->key_count]);
@@ -416,3 +440,42 @@ void removeClientFromPendingCommandsBatch(client *c) {
         }
     }
 }
+
+/* Prefetch the given keys of 'db' from the main and expires dictionaries,
+ * along with their values and the values' data, the same way it is done for
+ * the keys of a batch of commands.
+ *
+ * This is for commands that look up many keys they compute themselves, like
+ * SORT with BY or GET patterns, so that they can do so in batches: prefetch
+ * a batch of keys, then look them up while they are in the cache. The keys
+ * must stay valid until the function returns. */
+void prefetchKeys(serverDb *db, sds *keys, size_t count) {
+    void *batch_keys[PREFETCH_KEYS_MAX_BATCH];
+    uint64_t key_hashes[PREFETCH_KEYS_MAX_BATCH];
+    dict *keys_dicts[PREFETCH_KEYS_MAX_BATCH];
+    dict *expire_dicts[PREFETCH_KEYS_MAX_BATCH];
+    KeyPrefetchInfo prefetch_info[PREFETCH_KEYS_MAX_BATCH];
+
+    while (count > 1) {
+        PrefetchCommandsBatch b = {0};
+        b.keys = batch_keys;
+        b.key_hashes = key_hashes;
+        b.keys_dicts = keys_dicts;
+        b.expire_dicts = expire_dicts;
+        b.prefetch_info = prefetch_info;
+        b.key_count = count < PREFETCH_KEYS_MAX_BATCH ? count : PREFETCH_KEYS_MAX_BATCH;
+        for (size_t i = 0; i < b.key_count; i++) {
+            int slot = server.cluster_enabled ? getKeySlot(keys[i]) : 0;
+            batch_keys[i] = keys[i];
+            key_hashes[i] = dictSdsHash(keys[i]);
+            keys_dicts[i] = kvstoreGetDict(db->keys, slot);
+            expire_dicts[i] = kvstoreGetDict(db->expires, slot);
+        }
+
+        server.stat_total_prefetch_batches++;
+        dictPrefetch(&b, keys_dicts, getObjectDataPtr);
+        dictPrefetch(&b, expire_dicts, NULL);
+        keys += b.key_count;
+        count -= b.key_count;
+    }
+}
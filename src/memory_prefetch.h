@@ -1,11 +1,19 @@
 #ifndef MEMORY_PREFETCH_H
 #define MEMORY_PREFETCH_H
 
+#include "fmacros.h"
+#include "sds.h"
+
 struct client;
+struct serverDb;
+
+/* The largest number of keys prefetchKeys() prefetches at once. */
+#define PREFETCH_KEYS_MAX_BATCH 128
 
 void prefetchCommandsBatchInit(void);
 void processClientsCommandsBatch(void);
 int addCommandToBatchAndProcessIfFull(struct client *c);
 void removeClientFromPendingCommandsBatch(struct client *c);
+void prefetchKeys(struct serverDb *db, sds *keys, size_t count);
 
 #endif /* MEMORY_PREFETCH_H */
@@ -44,6 +44,7 @@
 
 static void setProtocolError(const char *errstr, client *c);
 static void pauseClientsByClient(mstime_t end, int isPauseClientAll);
+static void drainReplyGenerator(client *c);
 int postponeClientRead(client *c);
 char *getClientSockname(client *c);
 
@@ -154,6 +155,9 @@ client *createClient(connection *conn) {
     c->buf_peak_last_reset_time = server.unixtime;
     c->ref_repl_buf_node = NULL;
     c->ref_block_pos = 0;
+    c->repl_frame = NULL;
+    c->repl_frame_pos = 0;
+    c->reply_gen = NULL;
     c->qb_pos = 0;
     c->querybuf = NULL;
     c->querybuf_peak = 0;
@@ -1085,6 +1089,8 @@ void addReplyAttributeLen(client *c, long length) {
 void addReplyPushLen(client *c, long length) {
     serverAssert(c->resp >= 3);
     serverAssertWithInfo(c, NULL, c->flag.pushing);
+    /* A push can't be interleaved with the elements of a reply in progress. */
+    if (c->reply_gen) drainReplyGenerator(c);
     addReplyAggregateLen(c, length, '>');
 }
 
@@ -1353,6 +1359,9 @@ int clientHasPendingReplies(client *c) {
         serverAssert(c->bufpos == 0 && listLength(c->reply) == 0);
         if (c->ref_repl_buf_node == NULL) return 0;
 
+        /* A compressed frame that is only partially sent. */
+        if (c->repl_frame) return 1;
+
         /* If the last replication buffer block content is totally sent,
          * we have nothing to send. */
         listNode *ln = listLast(server.repl_buffer_blocks);
@@ -1365,6 +1374,157 @@ int clientHasPendingReplies(client *c) {
     }
 }
 
+/* -----------------------------------------------------------------------------
+ * Incremental replies
+ *
+ * Commands that can reply with huge collections, like LRANGE or HGETALL, don't
+ * have to serialize the whole reply into the output buffers at once. After the
+ * reply header, they can attach a reply generator to the client, that emits
+ * the elements a batch at a time, only when the part of the reply waiting in
+ * the output buffers drained below REPLY_GENERATOR_BUFFER_BYTES. Until the
+ * reply is complete the client doesn't process other commands, like when it
+ * is blocked.
+ *
+ * The elements are read from the value after the command returned, but the
+ * reply must be the one the command would have emitted at once. So before the
+ * key is modified, deleted or moved, the rest of the reply is emitted right
+ * away, and active defrag skips the key, so that the generator can keep
+ * iterating over the value until then.
+ * -------------------------------------------------------------------------- */
+
+/* Size the output buffers are refilled to while a reply is generated. */
+#define REPLY_GENERATOR_BUFFER_BYTES (NET_MAX_WRITES_PER_EVENT * 2)
+
+/* Number of elements a generator emits between checks of the buffers size. */
+#define REPLY_GENERATOR_BATCH 32
+
+/* Returns true if the reply of 'count' elements the current command of 'c' is
+ * about to emit should be emitted incrementally, see addReplyGenerator(). */
+int replyGeneratorAllowed(client *c, long count) {
+#ifdef LOG_REQ_RES
+    /* The reply of a command is logged as soon as the command returns. */
+    UNUSED(c);
+    UNUSED(count);
+    return 0;
+#else
+    if (server.incremental_reply_min_elements == 0 || (unsigned long)count < server.incremental_reply_min_elements)
+        return 0;
+    /* Nobody but the client itself can wait for the reply: not inside
+     * MULTI/EXEC, scripts or modules. */
+    if (!c->conn || c->flag.fake || c->flag.deny_blocking || server.execution_nesting > 1) return 0;
+    if (getClientType(c) != CLIENT_TYPE_NORMAL || c->flag.monitor) return 0;
+    if (c->flag.reply_off || c->flag.reply_skip) return 0;
+    return 1;
+#endif
+}
+
+static size_t replyGeneratorPendingBytes(client *c) {
+    return c->bufpos + c->reply_bytes;
+}
+
+/* Emits the incremental reply of 'c' until the output buffers hold at least
+ * REPLY_GENERATOR_BUFFER_BYTES. Returns 1 once the reply is complete. */
+static int fillReplyGenerator(client *c) {
+    replyGenerator *gen = c->reply_gen;
+
+    while (replyGeneratorPendingBytes(c) < REPLY_GENERATOR_BUFFER_BYTES) {
+        if (gen->proc(c, gen, REPLY_GENERATOR_BATCH)) return 1;
+    }
+    return 0;
+}
+
+/* Continues the reply of the current command of 'c' incrementally. 'proc'
+ * emits the elements of 'obj', the value of 'key', starting from 'state'.
+ * The caller already emitted the reply header, and must not modify the value
+ * after calling this function. 'free_state', if not NULL, is called to free
+ * 'state' once the reply is complete. */
+void addReplyGenerator(client *c, robj *key, robj *obj, replyGeneratorProc *proc, void *state, void (*free_state)(void *)) {
+    replyGenerator *gen = zmalloc(sizeof(*gen));
+
+    serverAssert(c->reply_gen == NULL);
+    gen->client = c;
+    gen->db = c->db;
+    gen->key = sdsdup(key->ptr);
+    gen->obj = obj;
+    gen->proc = proc;
+    gen->state = state;
+    gen->free_state = free_state;
+    listAddNodeTail(server.reply_generators, gen);
+    gen->node = listLast(server.reply_generators);
+    c->reply_gen = gen;
+
+    /* The first batch goes out with the usual write of the command reply. */
+    if (fillReplyGenerator(c)) releaseReplyGenerator(c);
+}
+
+void releaseReplyGenerator(client *c) {
+    replyGenerator *gen = c->reply_gen;
+
+    if (gen == NULL) return;
+    listDelNode(server.reply_generators, gen->node);
+    if (gen->free_state) gen->free_state(gen->state);
+    sdsfree(gen->key);
+    zfree(gen);
+    c->reply_gen = NULL;
+}
+
+/* The reply is complete: process the commands the client sent meanwhile. */
+static void finishReplyGenerator(client *c) {
+    releaseReplyGenerator(c);
+    queueClientForReprocessing(c);
+}
+
+/* Called after writing to the socket of 'c', to refill the output buffers
+ * with the next elements of the reply in progress, if any. */
+void continueReplyGenerator(client *c) {
+    if (replyGeneratorPendingBytes(c) >= REPLY_GENERATOR_BUFFER_BYTES) return;
+    if (fillReplyGenerator(c)) finishReplyGenerator(c);
+}
+
+/* Emits the whole rest of the reply in progress of 'c' at once. */
+static void drainReplyGenerator(client *c) {
+    replyGenerator *gen = c->reply_gen;
+
+    /* Don't bother emitting a reply that will never be sent. */
+    if (!c->flag.close_asap) {
+        while (!gen->proc(c, gen, LONG_MAX));
+    }
+    finishReplyGenerator(c);
+}
+
+/* Called before the key 'key' of 'db' is modified, deleted or moved, to
+ * complete the replies being generated from its value. */
+void replyGeneratorsKeyWillChange(serverDb *db, sds key) {
+    listIter li;
+    listNode *ln;
+
+    listRewind(server.reply_generators, &li);
+    while ((ln = listNext(&li))) {
+        replyGenerator *gen = listNodeValue(ln);
+        if (gen->db == db && sdscmp(gen->key, key) == 0) drainReplyGenerator(gen->client);
+    }
+}
+
+/* Like replyGeneratorsKeyWillChange(), for all the keys at once. */
+void drainAllReplyGenerators(void) {
+    while (listLength(server.reply_generators)) {
+        replyGenerator *gen = listNodeValue(listFirst(server.reply_generators));
+        drainReplyGenerator(gen->client);
+    }
+}
+
+int keyHasReplyGenerator(serverDb *db, sds key) {
+    listIter li;
+    listNode *ln;
+
+    listRewind(server.reply_generators, &li);
+    while ((ln = listNext(&li))) {
+        replyGenerator *gen = listNodeValue(ln);
+        if (gen->db == db && sdscmp(gen->key, key) == 0) return 1;
+    }
+    return 0;
+}
+
 void clientAcceptHandler(connection *conn) {
     client *c = connGetPrivateData(conn);
 
@@ -1740,6 +1900,9 @@ void freeClient(client *c) {
     if (c->flag.blocked) unblockClient(c, 1);
     dictRelease(c->bstate.keys);
 
+    /* Stop the incremental reply in progress, if any. */
+    releaseReplyGenerator(c);
+
     /* UNWATCH all the keys */
     unwatchAllKeys(c);
     listRelease(c->watched_keys);
@@ -2007,6 +2170,28 @@ void writeToReplica(client *c) {
     serverAssert(inMainThread());
     int nwritten = 0;
     serverAssert(c->bufpos == 0 && listLength(c->reply) == 0);
+    if (c->flag.repl_compressed) {
+        /* Send the stream as LZF frames, see replicationNextFrame(). */
+        while (clientHasPendingReplies(c)) {
+            if (c->repl_frame == NULL) {
+                c->repl_frame = replicationNextFrame(c);
+                c->repl_frame_pos = 0;
+            }
+            size_t framelen = sdslen(c->repl_frame);
+            nwritten = connWrite(c->conn, c->repl_frame + c->repl_frame_pos, framelen - c->repl_frame_pos);
+            if (nwritten <= 0) {
+                c->write_flags |= WRITE_FLAGS_WRITE_ERROR;
+                return;
+            }
+            c->nwritten += nwritten;
+            c->repl_frame_pos += nwritten;
+            if (c->repl_frame_pos == framelen) {
+                sdsfree(c->repl_frame);
+                c->repl_frame = NULL;
+            }
+        }
+        return;
+    }
     while (clientHasPendingReplies(c)) {
         replBufBlock *o = listNodeValue(c->ref_repl_buf_node);
         serverAssert(o->used >= c->ref_block_pos);
@@ -2242,6 +2427,7 @@ int postWriteToClient(client *c) {
          * We just rely on data / pings received for timeout detection. */
         if (!c->flag.primary) c->last_interaction = server.unixtime;
     }
+    if (c->reply_gen) continueReplyGenerator(c);
     if (!clientHasPendingReplies(c)) {
         c->sentlen = 0;
         if (connHasWriteHandler(c->conn)) {
@@ -2329,8 +2515,17 @@ int handleReadResult(client *c) {
     c->last_interaction = server.unixtime;
     c->net_input_bytes += c->nread;
     if (c->flag.primary) {
-        c->read_reploff += c->nread;
         server.stat_net_repl_input_bytes += c->nread;
+        if (c->flag.repl_compressed) {
+            long long inflated = replicationInflateQueryBuf(c);
+            if (inflated == -1) {
+                freeClientAsync(c);
+                return C_ERR;
+            }
+            c->read_reploff += inflated;
+        } else {
+            c->read_reploff += c->nread;
+        }
     } else {
         server.stat_net_input_bytes += c->nread;
     }
@@ -3085,6 +3280,9 @@ int canParseCommand(client *c) {
     /* Don't parse a command if the client is in the middle of something. */
     if (c->flag.blocked || c->flag.unblocked) return 0;
 
+    /* The reply of the previous command is still being generated. */
+    if (c->reply_gen) return 0;
+
     /* Don't process more buffers from clients that have already pending
      * commands to execute in c->argv. */
     if (c->flag.pending_command) return 0;
@@ -4910,14 +5108,29 @@ void ioThreadReadQueryFromClient(void *data) {
         c->io_parsed_cmd = NULL;
     }
 
-    /* Offload slot calculations to the I/O thread to reduce main-thread load. */
-    if (c->io_parsed_cmd && server.cluster_enabled) {
+    /* Offload key calculations to the I/O thread to reduce main-thread load. */
+    if (c->io_parsed_cmd) {
         getKeysResult result;
         initGetKeysResult(&result);
         int numkeys = getKeysFromCommand(c->io_parsed_cmd, c->argv, c->argc, &result);
-        if (numkeys) {
-            robj *first_key = c->argv[result.keys[0].pos];
-            c->slot = keyHashSlot(first_key->ptr, sdslen(first_key->ptr));
+
+        /* The dict hash of the first key, used to prefetch it from the keyspace. */
+        if (numkeys) c->io_key_hash = dictSdsHash(c->argv[result.keys[0].pos]->ptr);
+
+        /* The slot is only set when all the keys hash to it, so that the main
+         * thread can route the command without extracting the keys again. */
+        if (server.cluster_enabled) {
+            int slot = -1;
+            for (int j = 0; j < numkeys; j++) {
+                robj *key = c->argv[result.keys[j].pos];
+                int keyslot = keyHashSlot(key->ptr, sdslen(key->ptr));
+                if (slot != -1 && keyslot != slot) {
+                    slot = -1;
+                    break;
+                }
+                slot = keyslot;
+            }
+            c->slot = slot;
         }
         getKeysFreeResult(&result);
     }
@@ -36,7 +36,7 @@
 #include "config.h"
 #include "listpack.h"
 #include "util.h" /* for ll2string */
-#include "lzf.h"
+#include "compression.h"
 #include "serverassert.h"
 
 /* Optimization levels for size-based filling.
@@ -47,6 +47,14 @@ static const size_t optimization_level[] = {4096, 8192, 16384, 32768, 65536};
 /* This is for test suite development purposes only, 0 means disabled. */
 static size_t packed_threshold = 0;
 
+/* The COMPRESSION_CODEC_* used to compress nodes from now on. Nodes already
+ * compressed keep their codec until they are decompressed. */
+static int compression_codec = COMPRESSION_CODEC_LZF;
+
+void quicklistSetCompressionCodec(int codec) {
+    compression_codec = codec;
+}
+
 /* set threshold for PLAIN nodes for test suit, the real limit is based on `fill` */
 int quicklistSetPackedThreshold(size_t sz) {
     /* Don't allow threshold to be set above or even slightly below 4GB */
@@ -99,6 +107,16 @@ void _quicklistBookmarkDelete(quicklist *ql, quicklistBookmark *bm);
 static quicklistNode *_quicklistSplitNode(quicklistNode *node, int offset, int after);
 static quicklistNode *_quicklistMergeNodes(quicklist *quicklist, quicklistNode *center);
 
+/* Positional index forward declarations */
+static void quicklistIndexNodeInserted(quicklist *ql, quicklistNode *node);
+static void quicklistIndexNodeDeleted(quicklist *ql, quicklistNode *node);
+static void quicklistIndexHeadCountChanged(quicklist *ql, long delta);
+static int quicklistIndexSeek(quicklist *ql,
+                              unsigned long long pos,
+                              unsigned long long walk,
+                              quicklistNode **node,
+                              unsigned long long *before);
+
 /* Simple way to give quicklistEntry structs default values with one call. */
 #define initEntry(e)                 \
     do {                             \
@@ -127,6 +145,7 @@ quicklist *quicklistCreate(void) {
     quicklist->head = quicklist->tail = NULL;
     quicklist->len = 0;
     quicklist->count = 0;
+    quicklist->index = NULL;
     quicklist->compress = 0;
     quicklist->fill = -2;
     quicklist->bookmark_count = 0;
@@ -167,7 +186,7 @@ quicklist *quicklistNew(int fill, int compress) {
 
 static quicklistNode *quicklistCreateNode(void) {
     quicklistNode *node;
-    node = zmalloc(sizeof(*node));
+    node = zmalloc_cached(sizeof(*node));
     node->entry = NULL;
     node->count = 0;
     node->sz = 0;
@@ -176,6 +195,7 @@ static quicklistNode *quicklistCreateNode(void) {
     node->container = QUICKLIST_NODE_CONTAINER_PACKED;
     node->recompress = 0;
     node->dont_compress = 0;
+    node->indexed = 0;
     return node;
 }
 
@@ -189,6 +209,7 @@ void quicklistRelease(quicklist *quicklist) {
     unsigned long len;
     quicklistNode *current, *next;
 
+    quicklistIndexClear(quicklist);
     current = quicklist->head;
     len = quicklist->len;
     while (len--) {
@@ -197,7 +218,7 @@ void quicklistRelease(quicklist *quicklist) {
         zfree(current->entry);
         quicklist->count -= current->count;
 
-        zfree(current);
+        zfree_cached(current, sizeof(*current));
 
         quicklist->len--;
         current = next;
@@ -224,16 +245,17 @@ static int __quicklistCompressNode(quicklistNode *node) {
     quicklistLZF *lzf = zmalloc(sizeof(*lzf) + node->sz);
 
     /* Cancel if compression fails or doesn't compress small enough */
-    if (((lzf->sz = lzf_compress(node->entry, node->sz, lzf->compressed, node->sz)) == 0) ||
+    if (((lzf->sz = compressionCompress(compression_codec, node->entry, node->sz, lzf->compressed, node->sz)) == 0) ||
         lzf->sz + MIN_COMPRESS_IMPROVE >= node->sz) {
-        /* lzf_compress aborts/rejects compression if value not compressible. */
+        /* The codec aborts/rejects compression if value not compressible. */
         zfree(lzf);
         return 0;
     }
     lzf = zrealloc(lzf, sizeof(*lzf) + lzf->sz);
     zfree(node->entry);
     node->entry = (unsigned char *)lzf;
-    node->encoding = QUICKLIST_NODE_ENCODING_LZF;
+    node->encoding =
+        compression_codec == COMPRESSION_CODEC_LZ4 ? QUICKLIST_NODE_ENCODING_LZ4 : QUICKLIST_NODE_ENCODING_LZF;
     return 1;
 }
 
@@ -253,7 +275,7 @@ static int __quicklistDecompressNode(quicklistNode *node) {
 
     void *decompressed = zmalloc(node->sz);
     quicklistLZF *lzf = (quicklistLZF *)node->entry;
-    if (lzf_decompress(lzf->compressed, lzf->sz, decompressed, node->sz) == 0) {
+    if (compressionDecompress(quicklistNodeCodec(node), lzf->compressed, lzf->sz, decompressed, node->sz) == 0) {
         /* Someone requested decompress, but we can't decompress.  Not good. */
         zfree(decompressed);
         return 0;
@@ -267,7 +289,7 @@ static int __quicklistDecompressNode(quicklistNode *node) {
 /* Decompress only compressed nodes. */
 #define quicklistDecompressNode(_node)                                     \
     do {                                                                   \
-        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_LZF) { \
+        if ((_node) && quicklistNodeIsCompressed(_node)) {                 \
             __quicklistDecompressNode((_node));                            \
         }                                                                  \
     } while (0)
@@ -275,21 +297,32 @@ static int __quicklistDecompressNode(quicklistNode *node) {
 /* Force node to not be immediately re-compressible */
 #define quicklistDecompressNodeForUse(_node)                               \
     do {                                                                   \
-        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_LZF) { \
+        if ((_node) && quicklistNodeIsCompressed(_node)) {                 \
             __quicklistDecompressNode((_node));                            \
             (_node)->recompress = 1;                                       \
         }                                                                  \
     } while (0)
 
-/* Extract the raw LZF data from this quicklistNode.
- * Pointer to LZF data is assigned to '*data'.
- * Return value is the length of compressed LZF data. */
-size_t quicklistGetLzf(const quicklistNode *node, void **data) {
+/* Extract the raw compressed data from this quicklistNode, in the codec
+ * given by quicklistNodeCodec().
+ * Pointer to compressed data is assigned to '*data'.
+ * Return value is the length of compressed data. */
+size_t quicklistGetCompressed(const quicklistNode *node, void **data) {
     quicklistLZF *lzf = (quicklistLZF *)node->entry;
     *data = lzf->compressed;
     return lzf->sz;
 }
 
+/* Return a copy of the uncompressed content of a compressed node, of
+ * node->sz bytes, without changing the node. The caller must free it. */
+unsigned char *quicklistGetDecompressed(const quicklistNode *node) {
+    quicklistLZF *lzf = (quicklistLZF *)node->entry;
+    unsigned char *buf = zmalloc(node->sz);
+    size_t len = compressionDecompress(quicklistNodeCodec(node), lzf->compressed, lzf->sz, buf, node->sz);
+    assert(len == node->sz);
+    return buf;
+}
+
 #define quicklistAllowsCompression(_ql) ((_ql)->compress != 0)
 
 /* Force 'quicklist' to meet compression guidelines set by compress depth.
@@ -415,6 +448,7 @@ static void __quicklistInsertNode(quicklist *quicklist, quicklistNode *old_node,
 
     /* Update len first, so in __quicklistCompress we know exactly len */
     quicklist->len++;
+    quicklistIndexNodeInserted(quicklist, new_node);
 
     if (old_node) quicklistCompress(quicklist, old_node);
 
@@ -549,6 +583,7 @@ int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
 
     if (unlikely(isLargeElement(sz, quicklist->fill))) {
         __quicklistInsertPlainNode(quicklist, quicklist->head, value, sz, 0);
+        quicklistIndexHeadCountChanged(quicklist, 1);
         return 1;
     }
 
@@ -564,6 +599,7 @@ int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
     }
     quicklist->count++;
     quicklist->head->count++;
+    quicklistIndexHeadCountChanged(quicklist, 1);
     return (orig_head != quicklist->head);
 }
 
@@ -632,6 +668,8 @@ void quicklistAppendPlainNode(quicklist *quicklist, unsigned char *data, size_t
     } while (0)
 
 static void __quicklistDelNode(quicklist *quicklist, quicklistNode *node) {
+    quicklistIndexNodeDeleted(quicklist, node);
+
     /* Update the bookmark if any */
     quicklistBookmark *bm = _quicklistBookmarkFindByNode(quicklist, node);
     if (bm) {
@@ -660,7 +698,7 @@ static void __quicklistDelNode(quicklist *quicklist, quicklistNode *node) {
     __quicklistCompress(quicklist, NULL);
 
     zfree(node->entry);
-    zfree(node);
+    zfree_cached(node, sizeof(*node));
 }
 
 /* Delete one entry from list given the node for the entry and a pointer
@@ -674,12 +712,16 @@ static void __quicklistDelNode(quicklist *quicklist, quicklistNode *node) {
 static int quicklistDelIndex(quicklist *quicklist, quicklistNode *node, unsigned char **p) {
     int gone = 0;
 
+    /* Deleting from a node in the middle shifts the nodes after it. */
+    if (node != quicklist->head && node != quicklist->tail) quicklistIndexClear(quicklist);
+
     if (unlikely(QL_NODE_IS_PLAIN(node))) {
         __quicklistDelNode(quicklist, node);
         return 1;
     }
     node->entry = lpDelete(node->entry, *p, p);
     node->count--;
+    if (node == quicklist->head) quicklistIndexHeadCountChanged(quicklist, -1);
     if (node->count == 0) {
         gone = 1;
         __quicklistDelNode(quicklist, node);
@@ -736,6 +778,7 @@ void quicklistReplaceEntry(quicklistIter *iter, quicklistEntry *entry, void *dat
         /* quicklistNext() and quicklistGetIteratorEntryAtIdx() provide an uncompressed node */
         quicklistCompress(quicklist, entry->node);
     } else if (QL_NODE_IS_PLAIN(entry->node)) {
+        quicklistIndexClear(quicklist);
         if (isLargeElement(sz, quicklist->fill)) {
             zfree(entry->node->entry);
             entry->node->entry = zmalloc(sz);
@@ -748,6 +791,7 @@ void quicklistReplaceEntry(quicklistIter *iter, quicklistEntry *entry, void *dat
         }
     } else { /* The node is full or data is a large element */
         quicklistNode *split_node = NULL, *new_node;
+        quicklistIndexClear(quicklist);
         node->dont_compress = 1; /* Prevent compression in __quicklistInsertNode() */
 
         /* If the entry is not at the tail, split the node at the entry's offset. */
@@ -960,6 +1004,8 @@ static void _quicklistInsert(quicklistIter *iter, quicklistEntry *entry, void *v
     quicklistNode *node = entry->node;
     quicklistNode *new_node = NULL;
 
+    quicklistIndexClear(quicklist);
+
     if (!node) {
         /* we have no reference node, so let's create only node in the list */
         D("No node given!");
@@ -1116,6 +1162,7 @@ int quicklistDelRange(quicklist *quicklist, const long start, const long count)
     quicklistNode *node = iter->current;
     long offset = iter->offset;
     quicklistReleaseIterator(iter);
+    quicklistIndexClear(quicklist);
 
     /* iterate over next nodes until everything is deleted. */
     while (extent) {
@@ -1225,14 +1272,19 @@ quicklistIter *quicklistGetIteratorAtIdx(quicklist *quicklist, const int directi
         seek_index = quicklist->count - 1 - index;
     }
 
-    n = seek_forward ? quicklist->head : quicklist->tail;
-    while (likely(n)) {
-        if ((accum + n->count) > seek_index) {
-            break;
-        } else {
-            D("Skipping over (%p) %u at accum %lld", (void *)n, n->count, accum);
-            accum += n->count;
-            n = seek_forward ? n->next : n->prev;
+    if (quicklistIndexSeek(quicklist, forward ? index : quicklist->count - 1 - index, seek_index, &n, &accum)) {
+        /* The index seeks from the head. */
+        seek_forward = 1;
+    } else {
+        n = seek_forward ? quicklist->head : quicklist->tail;
+        while (likely(n)) {
+            if ((accum + n->count) > seek_index) {
+                break;
+            } else {
+                D("Skipping over (%p) %u at accum %lld", (void *)n, n->count, accum);
+                accum += n->count;
+                n = seek_forward ? n->next : n->prev;
+            }
         }
     }
 
@@ -1383,7 +1435,7 @@ quicklist *quicklistDup(quicklist *orig) {
     for (quicklistNode *current = orig->head; current; current = current->next) {
         quicklistNode *node = quicklistCreateNode();
 
-        if (current->encoding == QUICKLIST_NODE_ENCODING_LZF) {
+        if (quicklistNodeIsCompressed(current)) {
             quicklistLZF *lzf = (quicklistLZF *)current->entry;
             size_t lzf_sz = sizeof(*lzf) + lzf->sz;
             node->entry = zmalloc(lzf_sz);
@@ -1422,6 +1474,7 @@ quicklistIter *quicklistGetIteratorEntryAtIdx(quicklist *quicklist, const long l
 }
 
 static void quicklistRotatePlain(quicklist *quicklist) {
+    quicklistIndexClear(quicklist);
     quicklistNode *new_head = quicklist->tail;
     quicklistNode *new_tail = quicklist->tail->prev;
     quicklist->head->prev = new_head;
@@ -1515,7 +1568,7 @@ int quicklistPopCustom(quicklist *quicklist,
     }
 
     /* The head and tail should never be compressed */
-    assert(node->encoding != QUICKLIST_NODE_ENCODING_LZF);
+    assert(!quicklistNodeIsCompressed(node));
 
     if (unlikely(QL_NODE_IS_PLAIN(node))) {
         if (data) *data = saver(node->entry, node->sz);
@@ -1566,8 +1619,8 @@ int quicklistPop(quicklist *quicklist, int where, unsigned char **data, size_t *
 /* Wrapper to allow argument-based switching between HEAD/TAIL pop */
 void quicklistPush(quicklist *quicklist, void *value, const size_t sz, int where) {
     /* The head and tail should never be compressed (we don't attempt to decompress them) */
-    if (quicklist->head) assert(quicklist->head->encoding != QUICKLIST_NODE_ENCODING_LZF);
-    if (quicklist->tail) assert(quicklist->tail->encoding != QUICKLIST_NODE_ENCODING_LZF);
+    if (quicklist->head) assert(!quicklistNodeIsCompressed(quicklist->head));
+    if (quicklist->tail) assert(!quicklistNodeIsCompressed(quicklist->tail));
 
     if (where == QUICKLIST_HEAD) {
         quicklistPushHead(quicklist, value, sz);
@@ -1588,10 +1641,14 @@ void quicklistRepr(unsigned char *ql, int full) {
     quicklistNode *node = quicklist->head;
 
     while (node != NULL) {
+        const char *encoding = "RAW";
+        if (node->encoding == QUICKLIST_NODE_ENCODING_LZF)
+            encoding = "LZF";
+        else if (node->encoding == QUICKLIST_NODE_ENCODING_LZ4)
+            encoding = "LZ4";
         printf("{quicklist node(%d)\n", i++);
         printf("{container : %s, encoding: %s, size: %zu, count: %d, recompress: %d, attempted_compress: %d}\n",
-               QL_NODE_IS_PLAIN(node) ? "PLAIN" : "PACKED",
-               (node->encoding == QUICKLIST_NODE_ENCODING_RAW) ? "RAW" : "LZF", node->sz, node->count, node->recompress,
+               QL_NODE_IS_PLAIN(node) ? "PLAIN" : "PACKED", encoding, node->sz, node->count, node->recompress,
                node->attempted_compress);
 
         if (full) {
@@ -1611,6 +1668,190 @@ void quicklistRepr(unsigned char *ql, int full) {
     }
 }
 
+/* Positional index.
+ *
+ * Seeking to an element by index walks the nodes from the closest end of the
+ * list, which gets slow in the middle of long lists. So the first deep seek
+ * into a long list builds an index sampling one node every
+ * QUICKLIST_INDEX_STRIDE nodes, together with the number of elements before
+ * it: seeking then takes a binary search followed by a short walk.
+ *
+ * Pushing and popping keep the index up to date. Elements added or removed at
+ * the head move all the samples at once through 'shift', and nodes added at
+ * either end get sampled as the list grows. Any other change to the nodes
+ * discards the index, which is rebuilt by the next deep seek. */
+#define QUICKLIST_INDEX_STRIDE 16
+#define QUICKLIST_INDEX_MIN_NODES 64 /* Don't index shallower seeks */
+#define QUICKLIST_INDEX_MIN_RATIO 8  /* Nor seeks shallower than len / ratio nodes */
+
+typedef struct quicklistIndexEntry {
+    quicklistNode *node;
+    long long before; /* Number of elements before 'node', minus 'shift' */
+} quicklistIndexEntry;
+
+struct quicklistIndex {
+    quicklistIndexEntry *entries; /* Samples are entries[start] to entries[start + len - 1] */
+    unsigned long start;
+    unsigned long len;
+    unsigned long cap;
+    long long shift;
+    unsigned long head_nodes; /* Nodes added before the first sample */
+    unsigned long tail_nodes; /* Nodes added after the last sample */
+};
+
+/* Discard the index, if any. */
+void quicklistIndexClear(quicklist *ql) {
+    quicklistIndex *idx = ql->index;
+    if (!idx) return;
+    for (unsigned long i = 0; i < idx->len; i++) idx->entries[idx->start + i].node->indexed = 0;
+    zfree(idx->entries);
+    zfree(idx);
+    ql->index = NULL;
+}
+
+static void quicklistIndexBuild(quicklist *ql) {
+    quicklistIndex *idx = zmalloc(sizeof(*idx));
+    unsigned long long before = 0;
+    unsigned long pos = 0;
+
+    idx->cap = ql->len / QUICKLIST_INDEX_STRIDE + 1;
+    idx->entries = zmalloc(sizeof(quicklistIndexEntry) * idx->cap);
+    idx->start = idx->len = 0;
+    for (quicklistNode *node = ql->head; node; node = node->next, pos++) {
+        if (pos % QUICKLIST_INDEX_STRIDE == 0) {
+            idx->entries[idx->len].node = node;
+            idx->entries[idx->len].before = before;
+            idx->len++;
+            node->indexed = 1;
+        }
+        before += node->count;
+    }
+    idx->shift = 0;
+    idx->head_nodes = 0;
+    idx->tail_nodes = (ql->len - 1) % QUICKLIST_INDEX_STRIDE;
+    ql->index = idx;
+}
+
+/* Sample the new head or tail 'node', with 'before' elements before it. */
+static void quicklistIndexAdd(quicklist *ql, quicklistNode *node, int at_head, unsigned long long before) {
+    quicklistIndex *idx = ql->index;
+    if (at_head ? idx->start == 0 : idx->start + idx->len == idx->cap) {
+        /* Out of room at this end, recenter the samples in a larger array. */
+        unsigned long cap = idx->len * 2 + QUICKLIST_INDEX_STRIDE;
+        quicklistIndexEntry *entries = zmalloc(sizeof(quicklistIndexEntry) * cap);
+        unsigned long start = (cap - idx->len) / 2;
+        memcpy(entries + start, idx->entries + idx->start, sizeof(quicklistIndexEntry) * idx->len);
+        zfree(idx->entries);
+        idx->entries = entries;
+        idx->start = start;
+        idx->cap = cap;
+    }
+    quicklistIndexEntry *e = at_head ? &idx->entries[--idx->start] : &idx->entries[idx->start + idx->len];
+    idx->len++;
+    e->node = node;
+    e->before = (long long)before - idx->shift;
+    node->indexed = 1;
+}
+
+/* Called when 'node' was just linked into the list. Elements are accounted for
+ * separately, 'ql->count' doesn't include the ones in 'node' yet. */
+static void quicklistIndexNodeInserted(quicklist *ql, quicklistNode *node) {
+    quicklistIndex *idx = ql->index;
+    if (!idx) return;
+    if (node == ql->head) {
+        if (++idx->head_nodes == QUICKLIST_INDEX_STRIDE) {
+            quicklistIndexAdd(ql, node, 1, 0);
+            idx->head_nodes = 0;
+        }
+    } else if (node == ql->tail) {
+        if (++idx->tail_nodes == QUICKLIST_INDEX_STRIDE) {
+            quicklistIndexAdd(ql, node, 0, ql->count);
+            idx->tail_nodes = 0;
+        }
+    } else {
+        quicklistIndexClear(ql);
+    }
+}
+
+/* Called when 'node' is about to be unlinked from the list, together with the
+ * elements it still holds. */
+static void quicklistIndexNodeDeleted(quicklist *ql, quicklistNode *node) {
+    quicklistIndex *idx = ql->index;
+    if (!idx) return;
+    if (node == ql->head) {
+        idx->shift -= node->count;
+        if (node->indexed) {
+            idx->start++;
+            idx->len--;
+            idx->head_nodes = QUICKLIST_INDEX_STRIDE - 1;
+        } else if (idx->head_nodes) {
+            idx->head_nodes--;
+        }
+    } else if (node == ql->tail) {
+        if (node->indexed) {
+            idx->len--;
+            idx->tail_nodes = QUICKLIST_INDEX_STRIDE - 1;
+        } else if (idx->tail_nodes) {
+            idx->tail_nodes--;
+        }
+    } else {
+        quicklistIndexClear(ql);
+        return;
+    }
+    node->indexed = 0;
+    if (idx->len == 0) quicklistIndexClear(ql);
+}
+
+/* Called when 'delta' elements were added to (or removed from) the head node. */
+static void quicklistIndexHeadCountChanged(quicklist *ql, long delta) {
+    quicklistIndex *idx = ql->index;
+    if (!idx) return;
+    idx->shift += delta;
+    /* A sampled head still has no elements before it. */
+    if (ql->head->indexed) idx->entries[idx->start].before -= delta;
+}
+
+/* Find the node holding the element at position 'pos' counting from the head,
+ * and the number of elements before it, using the index. 'walk' is the number
+ * of elements the caller would otherwise walk over: the index is only built
+ * when that is expected to be a long walk.
+ *
+ * Returns 1 and populates 'node' and 'before' on success, or 0 if there's no
+ * index and it isn't worth building one. */
+static int quicklistIndexSeek(quicklist *ql,
+                              unsigned long long pos,
+                              unsigned long long walk,
+                              quicklistNode **node,
+                              unsigned long long *before) {
+    if (!ql->index) {
+        unsigned long long walk_nodes = walk * ql->len / ql->count;
+        if (walk_nodes < QUICKLIST_INDEX_MIN_NODES || walk_nodes < ql->len / QUICKLIST_INDEX_MIN_RATIO) return 0;
+        quicklistIndexBuild(ql);
+    }
+
+    /* Binary search the last sample at or before 'pos'. */
+    quicklistIndex *idx = ql->index;
+    quicklistIndexEntry *samples = idx->entries + idx->start;
+    unsigned long lo = 0, hi = idx->len;
+    while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (samples[mid].before + idx->shift <= (long long)pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    quicklistNode *n = lo ? samples[lo - 1].node : ql->head;
+    unsigned long long accum = lo ? (unsigned long long)(samples[lo - 1].before + idx->shift) : 0;
+    while (accum + n->count <= pos) {
+        accum += n->count;
+        n = n->next;
+    }
+    *node = n;
+    *before = accum;
+    return 1;
+}
+
 /* Create or update a bookmark in the list which will be updated to the next node
  * automatically when the one referenced gets deleted.
  * Returns 1 on success (creation of new bookmark or override of an existing one).
@@ -29,6 +29,7 @@
  */
 
 #include <stdint.h> // for UINTPTR_MAX
+#include "compression.h"
 
 #ifndef __QUICKLIST_H__
 #define __QUICKLIST_H__
@@ -38,33 +39,36 @@
 /* quicklistNode is a 32 byte struct describing a listpack for a quicklist.
  * We use bit fields keep the quicklistNode at 32 bytes.
  * count: 16 bits, max 65536 (max lp bytes is 65k, so max count actually < 32k).
- * encoding: 2 bits, RAW=1, LZF=2.
+ * encoding: 2 bits, RAW=1, LZF=2, LZ4=3.
  * container: 2 bits, PLAIN=1 (a single item as char array), PACKED=2 (listpack with multiple items).
  * recompress: 1 bit, bool, true if node is temporary decompressed for usage.
  * attempted_compress: 1 bit, boolean, used for verifying during testing.
  * dont_compress: 1 bit, boolean, used for preventing compression of entry.
- * extra: 9 bits, free for future use; pads out the remainder of 32 bits */
+ * indexed: 1 bit, boolean, true if the node is sampled by the quicklist index.
+ * extra: 8 bits, free for future use; pads out the remainder of 32 bits */
 typedef struct quicklistNode {
     struct quicklistNode *prev;
     struct quicklistNode *next;
     unsigned char *entry;
     size_t sz;                           /* entry size in bytes */
     unsigned int count : 16;             /* count of items in listpack */
-    unsigned int encoding : 2;           /* RAW==1 or LZF==2 */
+    unsigned int encoding : 2;           /* RAW==1, LZF==2 or LZ4==3 */
     unsigned int container : 2;          /* PLAIN==1 or PACKED==2 */
     unsigned int recompress : 1;         /* was this node previous compressed? */
     unsigned int attempted_compress : 1; /* node can't compress; too small */
     unsigned int dont_compress : 1;      /* prevent compression of entry that will be used later */
-    unsigned int extra : 9;              /* more bits to steal for future usage */
+    unsigned int indexed : 1;            /* node is sampled by quicklist->index */
+    unsigned int extra : 8;              /* more bits to steal for future usage */
 } quicklistNode;
 
 /* quicklistLZF is a 8+N byte struct holding 'sz' followed by 'compressed'.
  * 'sz' is byte length of 'compressed' field.
- * 'compressed' is LZF data with total (compressed) length 'sz'
+ * 'compressed' is LZF or LZ4 data (see quicklistNode->encoding) with total
+ * (compressed) length 'sz'
  * NOTE: uncompressed length is stored in quicklistNode->sz.
  * When quicklistNode->entry is compressed, node->entry points to a quicklistLZF */
 typedef struct quicklistLZF {
-    size_t sz; /* LZF size in bytes*/
+    size_t sz; /* Compressed size in bytes*/
     char compressed[];
 } quicklistLZF;
 
@@ -96,9 +100,13 @@ typedef struct quicklistBookmark {
 #error unknown arch bits count
 #endif
 
-/* quicklist is a 40 byte struct (on 64-bit systems) describing a quicklist.
+typedef struct quicklistIndex quicklistIndex;
+
+/* quicklist is a 48 byte struct (on 64-bit systems) describing a quicklist.
  * 'count' is the number of total entries.
  * 'len' is the number of quicklist nodes.
+ * 'index' is an optional positional index of the nodes, built on demand by
+ *         seeks into long lists, see quicklistGetIteratorAtIdx().
  * 'compress' is: 0 if compression disabled, otherwise it's the number
  *                of quicklistNodes to leave uncompressed at ends of quicklist.
  * 'fill' is the user-requested (or default) fill factor.
@@ -109,6 +117,7 @@ typedef struct quicklist {
     quicklistNode *tail;
     unsigned long count;                  /* total count of all entries in all listpacks */
     unsigned long len;                    /* number of quicklistNodes */
+    quicklistIndex *index;                /* positional index of the nodes, or NULL */
     signed int fill : QL_FILL_BITS;       /* fill factor for individual nodes */
     unsigned int compress : QL_COMP_BITS; /* depth of end nodes not to compress;0=off */
     unsigned int bookmark_count : QL_BM_BITS;
@@ -139,6 +148,7 @@ typedef struct quicklistEntry {
 /* quicklist node encodings */
 #define QUICKLIST_NODE_ENCODING_RAW 1
 #define QUICKLIST_NODE_ENCODING_LZF 2
+#define QUICKLIST_NODE_ENCODING_LZ4 3
 
 /* quicklist compression disable */
 #define QUICKLIST_NOCOMPRESS 0
@@ -149,7 +159,11 @@ typedef struct quicklistEntry {
 
 #define QL_NODE_IS_PLAIN(node) ((node)->container == QUICKLIST_NODE_CONTAINER_PLAIN)
 
-#define quicklistNodeIsCompressed(node) ((node)->encoding == QUICKLIST_NODE_ENCODING_LZF)
+#define quicklistNodeIsCompressed(node) ((node)->encoding != QUICKLIST_NODE_ENCODING_RAW)
+
+/* The COMPRESSION_CODEC_* of a compressed node. */
+#define quicklistNodeCodec(node) \
+    ((node)->encoding == QUICKLIST_NODE_ENCODING_LZ4 ? COMPRESSION_CODEC_LZ4 : COMPRESSION_CODEC_LZF)
 
 /* Prototypes */
 quicklist *quicklistCreate(void);
@@ -186,7 +200,8 @@ int quicklistPopCustom(quicklist *quicklist,
 int quicklistPop(quicklist *quicklist, int where, unsigned char **data, size_t *sz, long long *slong);
 unsigned long quicklistCount(const quicklist *ql);
 int quicklistCompare(quicklistEntry *entry, unsigned char *p2, const size_t p2_len);
-size_t quicklistGetLzf(const quicklistNode *node, void **data);
+size_t quicklistGetCompressed(const quicklistNode *node, void **data);
+unsigned char *quicklistGetDecompressed(const quicklistNode *node);
 void quicklistNodeLimit(int fill, size_t *size, unsigned int *count);
 int quicklistNodeExceedsLimit(int fill, size_t new_sz, unsigned int new_count);
 void quicklistRepr(unsigned char *ql, int full);
@@ -196,7 +211,9 @@ int quicklistBookmarkCreate(quicklist **ql_ref, const char *name, quicklistNode
 int quicklistBookmarkDelete(quicklist *ql, const char *name);
 quicklistNode *quicklistBookmarkFind(quicklist *ql, const char *name);
 void quicklistBookmarksClear(quicklist *ql);
+void quicklistIndexClear(quicklist *ql);
 int quicklistSetPackedThreshold(size_t sz);
+void quicklistSetCompressionCodec(int codec);
 
 /* Directions for iterators */
 #define AL_START_HEAD 0
@@ -411,6 +411,47 @@ raxNode *raxCompressNode(raxNode *n, unsigned char *s, size_t len, raxNode **chi
     return n;
 }
 
+/* Nodes with up to this number of children are searched with an inline
+ * loop, bigger ones with memchr(). */
+#define RAX_CHILD_SCAN_INLINE_MAX 16
+
+/* Return the index of the child of the non compressed node 'n' that is
+ * reached with the character 'c', or n->size if there is no such child.
+ * For small nodes a linear scan is the fastest option, much better than,
+ * in theory more sounding, approaches like a binary search. Dense nodes, up
+ * to 256 children, are searched with memchr(), that compares many children
+ * at once using the vector instructions of the CPU. */
+static inline size_t raxFindChild(raxNode *n, unsigned char c) {
+    unsigned char *v = n->data;
+    size_t j;
+
+    if (n->size > RAX_CHILD_SCAN_INLINE_MAX) {
+        unsigned char *p = memchr(v, c, n->size);
+        return p ? (size_t)(p - v) : n->size;
+    }
+    for (j = 0; j < n->size; j++) {
+        if (v[j] == c) break;
+    }
+    return j;
+}
+
+/* Return the length of the common prefix of 'a' and 'b', comparing at most
+ * 'len' bytes. Compressed nodes are compared one word at a time, and only
+ * the word with the first mismatch byte by byte. */
+static inline size_t raxCommonPrefixLen(const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t j = 0;
+
+    while (j + sizeof(uint64_t) <= len) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + j, sizeof(wa));
+        memcpy(&wb, b + j, sizeof(wb));
+        if (wa != wb) break;
+        j += sizeof(uint64_t);
+    }
+    while (j < len && a[j] == b[j]) j++;
+    return j;
+}
+
 /* Low level function that walks the tree looking for the string
  * 's' of 'len' bytes. The function returns the number of characters
  * of the key that was possible to process: if the returned integer
@@ -452,17 +493,12 @@ raxLowWalk(rax *rax, unsigned char *s, size_t len, raxNode **stopnode, raxNode *
         unsigned char *v = h->data;
 
         if (h->iscompr) {
-            for (j = 0; j < h->size && i < len; j++, i++) {
-                if (v[j] != s[i]) break;
-            }
+            size_t maxlen = len - i < h->size ? len - i : h->size;
+            j = raxCommonPrefixLen(v, s + i, maxlen);
+            i += j;
             if (j != h->size) break;
         } else {
-            /* Even when h->size is large, linear scan provides good
-             * performances compared to other approaches that are in theory
-             * more sounding, like performing a binary search. */
-            for (j = 0; j < h->size; j++) {
-                if (v[j] == s[i]) break;
-            }
+            j = raxFindChild(h, s[i]);
             if (j == h->size) break;
             i++;
         }
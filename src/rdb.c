@@ -28,7 +28,6 @@
  */
 
 #include "server.h"
-#include "lzf.h" /* LZF compression library */
 #include "zipmap.h"
 #include "endianconv.h"
 #include "fpconv_dtoa.h"
@@ -364,12 +363,20 @@ int rdbTryIntegerEncoding(char *s, size_t len, unsigned char *enc) {
     }
 }
 
-ssize_t rdbSaveLzfBlob(rio *rdb, void *data, size_t compress_len, size_t original_len) {
+/* Whether the reader of 'rdb' can decode LZ4 strings. A NULL 'rdb' is used
+ * to compute the length of what would be saved, see rdbSavedObjectLen(). */
+static int rdbCanUseLz4(rio *rdb) {
+    return rdb == NULL || !(rdb->flags & RIO_FLAG_LZF_ONLY);
+}
+
+/* Save a string compressed with 'codec', that must be one of the codecs the
+ * reader of 'rdb' can decode. */
+ssize_t rdbSaveCompressedBlob(rio *rdb, int codec, void *data, size_t compress_len, size_t original_len) {
     unsigned char byte;
     ssize_t n, nwritten = 0;
 
     /* Data compressed! Let's save it on disk */
-    byte = (RDB_ENCVAL << 6) | RDB_ENC_LZF;
+    byte = (RDB_ENCVAL << 6) | (codec == COMPRESSION_CODEC_LZ4 ? RDB_ENC_LZ4 : RDB_ENC_LZF);
     if ((n = rdbWriteRaw(rdb, &byte, 1)) == -1) goto writeerr;
     nwritten += n;
 
@@ -388,10 +395,11 @@ writeerr:
     return -1;
 }
 
-ssize_t rdbSaveLzfStringObject(rio *rdb, unsigned char *s, size_t len) {
+ssize_t rdbSaveCompressedStringObject(rio *rdb, unsigned char *s, size_t len) {
     size_t comprlen, outlen;
     void *out;
     static void *buffer = NULL;
+    int codec = rdbCanUseLz4(rdb) ? server.rdb_compression_codec : COMPRESSION_CODEC_LZF;
 
     /* We require at least four bytes compression for this to be worth it */
     if (len <= 4) return 0;
@@ -402,16 +410,16 @@ ssize_t rdbSaveLzfStringObject(rio *rdb, unsigned char *s, size_t len) {
     } else {
         if ((out = zmalloc(outlen + 1)) == NULL) return 0;
     }
-    comprlen = lzf_compress(s, len, out, outlen);
-    ssize_t nwritten = comprlen ? rdbSaveLzfBlob(rdb, out, comprlen, len) : 0;
+    comprlen = compressionCompress(codec, s, len, out, outlen);
+    ssize_t nwritten = comprlen ? rdbSaveCompressedBlob(rdb, codec, out, comprlen, len) : 0;
     if (out != buffer) zfree(out);
     return nwritten;
 }
 
-/* Load an LZF compressed string in RDB format. The returned value
+/* Load a string compressed with 'codec' in RDB format. The returned value
  * changes according to 'flags'. For more info check the
  * rdbGenericLoadStringObject() function. */
-void *rdbLoadLzfStringObject(rio *rdb, int flags, size_t *lenptr) {
+void *rdbLoadCompressedStringObject(rio *rdb, int codec, int flags, size_t *lenptr) {
     int plain = flags & RDB_LOAD_PLAIN;
     int sds = flags & RDB_LOAD_SDS;
     uint64_t len, clen;
@@ -421,7 +429,7 @@ void *rdbLoadLzfStringObject(rio *rdb, int flags, size_t *lenptr) {
     if ((clen = rdbLoadLen(rdb, NULL)) == RDB_LENERR) return NULL;
     if ((len = rdbLoadLen(rdb, NULL)) == RDB_LENERR) return NULL;
     if ((c = ztrymalloc(clen)) == NULL) {
-        serverLog(isRestoreContext() ? LL_VERBOSE : LL_WARNING, "rdbLoadLzfStringObject failed allocating %llu bytes",
+        serverLog(isRestoreContext() ? LL_VERBOSE : LL_WARNING, "rdbLoadCompressedStringObject failed allocating %llu bytes",
                   (unsigned long long)clen);
         goto err;
     }
@@ -433,7 +441,7 @@ void *rdbLoadLzfStringObject(rio *rdb, int flags, size_t *lenptr) {
         val = sdstrynewlen(SDS_NOINIT, len);
     }
     if (!val) {
-        serverLog(isRestoreContext() ? LL_VERBOSE : LL_WARNING, "rdbLoadLzfStringObject failed allocating %llu bytes",
+        serverLog(isRestoreContext() ? LL_VERBOSE : LL_WARNING, "rdbLoadCompressedStringObject failed allocating %llu bytes",
                   (unsigned long long)len);
         goto err;
     }
@@ -442,8 +450,8 @@ void *rdbLoadLzfStringObject(rio *rdb, int flags, size_t *lenptr) {
 
     /* Load the compressed representation and uncompress it to target. */
     if (rioRead(rdb, c, clen) == 0) goto err;
-    if (lzf_decompress(c, clen, val, len) != len) {
-        rdbReportCorruptRDB("Invalid LZF compressed string");
+    if (compressionDecompress(codec, c, clen, val, len) != len) {
+        rdbReportCorruptRDB("Invalid %s compressed string", codec == COMPRESSION_CODEC_LZ4 ? "LZ4" : "LZF");
         goto err;
     }
     zfree(c);
@@ -477,10 +485,10 @@ ssize_t rdbSaveRawString(rio *rdb, unsigned char *s, size_t len) {
         }
     }
 
-    /* Try LZF compression - under 20 bytes it's unable to compress even
+    /* Try compression - under 20 bytes it's unable to compress even
      * aaaaaaaaaaaaaaaaaa so skip it */
     if (server.rdb_compression && len > 20) {
-        n = rdbSaveLzfStringObject(rdb, s, len);
+        n = rdbSaveCompressedStringObject(rdb, s, len);
         if (n == -1) return -1;
         if (n > 0) return n;
         /* Return value of 0 means data can't be compressed, save the old way */
@@ -554,7 +562,8 @@ void *rdbGenericLoadStringObject(rio *rdb, int flags, size_t *lenptr) {
         case RDB_ENC_INT8:
         case RDB_ENC_INT16:
         case RDB_ENC_INT32: return rdbLoadIntegerObject(rdb, len, flags, lenptr);
-        case RDB_ENC_LZF: return rdbLoadLzfStringObject(rdb, flags, lenptr);
+        case RDB_ENC_LZF: return rdbLoadCompressedStringObject(rdb, COMPRESSION_CODEC_LZF, flags, lenptr);
+        case RDB_ENC_LZ4: return rdbLoadCompressedStringObject(rdb, COMPRESSION_CODEC_LZ4, flags, lenptr);
         default: rdbReportCorruptRDB("Unknown RDB string encoding type %llu", len); return NULL;
         }
     }
@@ -850,10 +859,20 @@ ssize_t rdbSaveObject(rio *rdb, robj *o, robj *key, int dbid) {
                 if ((n = rdbSaveLen(rdb, node->container)) == -1) return -1;
                 nwritten += n;
 
-                if (quicklistNodeIsCompressed(node)) {
+                if (quicklistNodeIsCompressed(node) &&
+                    (quicklistNodeCodec(node) == COMPRESSION_CODEC_LZF || rdbCanUseLz4(rdb))) {
                     void *data;
-                    size_t compress_len = quicklistGetLzf(node, &data);
-                    if ((n = rdbSaveLzfBlob(rdb, data, compress_len, node->sz)) == -1) return -1;
+                    size_t compress_len = quicklistGetCompressed(node, &data);
+                    if ((n = rdbSaveCompressedBlob(rdb, quicklistNodeCodec(node), data, compress_len, node->sz)) == -1)
+                        return -1;
+                    nwritten += n;
+                } else if (quicklistNodeIsCompressed(node)) {
+                    /* The reader can't decode the codec of the node: save
+                     * it as a plain string, compressed again if possible. */
+                    unsigned char *raw = quicklistGetDecompressed(node);
+                    n = rdbSaveRawString(rdb, raw, node->sz);
+                    zfree(raw);
+                    if (n == -1) return -1;
                     nwritten += n;
                 } else {
                     if ((n = rdbSaveRawString(rdb, node->entry, node->sz)) == -1) return -1;
@@ -1320,7 +1339,118 @@ werr:
     return -1;
 }
 
-ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter) {
+/* The sections collected while saving an RDB with rdb-slot-index enabled,
+ * see RDB_SLOT_INDEX_AUX. */
+typedef struct rdbSlotIndex {
+    rdbSlotIndexEntry *entries;
+    size_t count, alloc;
+    uint64_t start_cksum; /* RDB checksum right before the open section. */
+    int open;             /* True if the last entry is still being written. */
+} rdbSlotIndex;
+
+static void rdbSlotIndexCloseSection(rdbSlotIndex *idx, rio *rdb) {
+    if (!idx->open) return;
+    rdbSlotIndexEntry *e = &idx->entries[idx->count - 1];
+    e->length = rdb->processed_bytes - e->offset;
+    if (rdb->update_cksum) e->crc = crc64_suffix(idx->start_cksum, rdb->cksum, e->length);
+    idx->open = 0;
+}
+
+static void rdbSlotIndexOpenSection(rdbSlotIndex *idx, rio *rdb, int dbid, int slot) {
+    rdbSlotIndexCloseSection(idx, rdb);
+    if (idx->count == idx->alloc) {
+        idx->alloc = idx->alloc ? idx->alloc * 2 : 16;
+        idx->entries = zrealloc(idx->entries, sizeof(rdbSlotIndexEntry) * idx->alloc);
+    }
+    rdbSlotIndexEntry *e = &idx->entries[idx->count++];
+    e->dbid = dbid;
+    e->slot = slot;
+    e->offset = rdb->processed_bytes;
+    e->length = 0;
+    e->keys = 0;
+    e->crc = 0;
+    idx->start_cksum = rdb->cksum;
+    idx->open = 1;
+}
+
+static unsigned char *rdbSlotIndexPutU64(unsigned char *p, uint64_t v) {
+    memrev64ifbe(&v);
+    memcpy(p, &v, 8);
+    return p + 8;
+}
+
+static const unsigned char *rdbSlotIndexGetU64(const unsigned char *p, uint64_t *v) {
+    memcpy(v, p, 8);
+    memrev64ifbe(v);
+    return p + 8;
+}
+
+/* Saves the index as the "slot-index" AUX field. The value is written as a
+ * raw string, never compressed, so that it can be found from the end of the
+ * file. */
+static ssize_t rdbSaveSlotIndex(rio *rdb, rdbSlotIndex *idx) {
+    size_t len = idx->count * RDB_SLOT_INDEX_ENTRY_LEN + RDB_SLOT_INDEX_TRAILER_LEN;
+    unsigned char *buf = zmalloc(len), *p = buf;
+    ssize_t ret = -1;
+
+    for (size_t j = 0; j < idx->count; j++) {
+        rdbSlotIndexEntry *e = &idx->entries[j];
+        uint32_t dbid = e->dbid, slot = e->slot;
+        memrev32ifbe(&dbid);
+        memrev32ifbe(&slot);
+        memcpy(p, &dbid, 4);
+        memcpy(p + 4, &slot, 4);
+        p += 8;
+        p = rdbSlotIndexPutU64(p, e->offset);
+        p = rdbSlotIndexPutU64(p, e->length);
+        p = rdbSlotIndexPutU64(p, e->keys);
+        p = rdbSlotIndexPutU64(p, e->crc);
+    }
+    p = rdbSlotIndexPutU64(p, idx->count);
+    memcpy(p, RDB_SLOT_INDEX_MAGIC, 8);
+
+    if (rdbSaveType(rdb, RDB_OPCODE_AUX) == -1) goto done;
+    if (rdbSaveRawString(rdb, (unsigned char *)RDB_SLOT_INDEX_AUX, strlen(RDB_SLOT_INDEX_AUX)) == -1) goto done;
+    if (rdbSaveLen(rdb, len) == -1) goto done;
+    if (rdbWriteRaw(rdb, buf, len) == -1) goto done;
+    ret = len;
+done:
+    zfree(buf);
+    return ret;
+}
+
+/* Parses the value of a "slot-index" AUX field. On success C_OK is returned
+ * and '*entries' is set to an array of '*count' entries the caller should
+ * free with zfree(), or to NULL if the index is empty. */
+int rdbSlotIndexDecode(const unsigned char *buf, size_t len, rdbSlotIndexEntry **entries, size_t *count) {
+    uint64_t n;
+
+    if (len < RDB_SLOT_INDEX_TRAILER_LEN) return C_ERR;
+    if (memcmp(buf + len - 8, RDB_SLOT_INDEX_MAGIC, 8)) return C_ERR;
+    rdbSlotIndexGetU64(buf + len - RDB_SLOT_INDEX_TRAILER_LEN, &n);
+    if (n != (len - RDB_SLOT_INDEX_TRAILER_LEN) / RDB_SLOT_INDEX_ENTRY_LEN ||
+        (len - RDB_SLOT_INDEX_TRAILER_LEN) % RDB_SLOT_INDEX_ENTRY_LEN)
+        return C_ERR;
+
+    *entries = n ? zmalloc(sizeof(rdbSlotIndexEntry) * n) : NULL;
+    *count = n;
+    for (uint64_t j = 0; j < n; j++) {
+        rdbSlotIndexEntry *e = &(*entries)[j];
+        const unsigned char *p = buf + j * RDB_SLOT_INDEX_ENTRY_LEN;
+        memcpy(&e->dbid, p, 4);
+        memcpy(&e->slot, p + 4, 4);
+        memrev32ifbe(&e->dbid);
+        memrev32ifbe(&e->slot);
+        p += 8;
+        p = rdbSlotIndexGetU64(p, &e->offset);
+        p = rdbSlotIndexGetU64(p, &e->length);
+        p = rdbSlotIndexGetU64(p, &e->keys);
+        rdbSlotIndexGetU64(p, &e->crc);
+    }
+    return C_OK;
+}
+
+ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter, rdbSlotIndex *index) {
     dictEntry *de;
     ssize_t written = 0;
     ssize_t res;
@@ -1352,17 +1482,21 @@ ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter) {
     /* Iterate this DB writing every entry */
     while ((de = kvstoreIteratorNext(kvs_it)) != NULL) {
         int curr_slot = kvstoreIteratorGetCurrentDictIndex(kvs_it);
-        /* Save slot info. */
-        if (server.cluster_enabled && curr_slot != last_slot) {
-            sds slot_info = sdscatprintf(sdsempty(), "%i,%lu,%lu", curr_slot, kvstoreDictSize(db->keys, curr_slot),
-                                         kvstoreDictSize(db->expires, curr_slot));
-            if ((res = rdbSaveAuxFieldStrStr(rdb, "slot-info", slot_info)) < 0) {
+        if (curr_slot != last_slot) {
+            if (index) rdbSlotIndexOpenSection(index, rdb, dbid, curr_slot);
+            /* Save slot info. */
+            if (server.cluster_enabled) {
+                sds slot_info = sdscatprintf(sdsempty(), "%i,%lu,%lu", curr_slot,
+                                             kvstoreDictSize(db->keys, curr_slot),
+                                             kvstoreDictSize(db->expires, curr_slot));
+                if ((res = rdbSaveAuxFieldStrStr(rdb, "slot-info", slot_info)) < 0) {
+                    sdsfree(slot_info);
+                    goto werr;
+                }
+                written += res;
                 sdsfree(slot_info);
-                goto werr;
             }
-            written += res;
             last_slot = curr_slot;
-            sdsfree(slot_info);
         }
         sds keystr = dictGetKey(de);
         robj key, *o = dictGetVal(de);
@@ -1373,6 +1507,7 @@ ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter) {
         expire = getExpire(db, &key);
         if ((res = rdbSaveKeyValuePair(rdb, &key, o, expire, dbid)) < 0) goto werr;
         written += res;
+        if (index) index->entries[index->count - 1].keys++;
 
         /* In fork child process, we can try to release memory back to the
          * OS and possibly avoid or decrease COW. We give the dismiss
@@ -1392,6 +1527,7 @@ ssize_t rdbSaveDb(rio *rdb, int dbid, int rdbflags, long *key_counter) {
         }
     }
     kvstoreIteratorRelease(kvs_it);
+    if (index) rdbSlotIndexCloseSection(index, rdb);
     return written;
 
 werr:
@@ -1399,6 +1535,44 @@ werr:
     return -1;
 }
 
+/* Writes everything that precedes the databases in an RDB file: the magic,
+ * the AUX fields, the modules "before" AUX data and the functions. */
+static int rdbSaveRioHeader(int req, rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
+    char magic[10];
+
+    if (server.rdb_checksum) rdb->update_cksum = rioGenericUpdateChecksum;
+    if (rdbflags & RDBFLAGS_LZF_ONLY) rdb->flags |= RIO_FLAG_LZF_ONLY;
+    snprintf(magic, sizeof(magic), "REDIS%04d", RDB_VERSION);
+    if (rdbWriteRaw(rdb, magic, 9) == -1) return C_ERR;
+    if (rdbSaveInfoAuxFields(rdb, rdbflags, rsi) == -1) return C_ERR;
+    if (!(req & REPLICA_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, VALKEYMODULE_AUX_BEFORE_RDB) == -1)
+        return C_ERR;
+
+    /* save functions */
+    if (!(req & REPLICA_REQ_RDB_EXCLUDE_FUNCTIONS) && rdbSaveFunctions(rdb) == -1) return C_ERR;
+    return C_OK;
+}
+
+/* Writes everything that follows the databases in an RDB file: the modules
+ * "after" AUX data, the slot index if any, the EOF opcode and the checksum. */
+static int rdbSaveRioFooter(int req, rio *rdb, rdbSlotIndex *index) {
+    uint64_t cksum;
+
+    if (!(req & REPLICA_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, VALKEYMODULE_AUX_AFTER_RDB) == -1)
+        return C_ERR;
+    if (index && rdbSaveSlotIndex(rdb, index) == -1) return C_ERR;
+
+    /* EOF opcode */
+    if (rdbSaveType(rdb, RDB_OPCODE_EOF) == -1) return C_ERR;
+
+    /* CRC64 checksum. It will be zero if checksum computation is disabled, the
+     * loading code skips the check in this case. */
+    cksum = rdb->cksum;
+    memrev64ifbe(&cksum);
+    if (rioWrite(rdb, &cksum, 8) == 0) return C_ERR;
+    return C_OK;
+}
+
 /* Produces a dump of the database in RDB format sending it to the specified
  * I/O channel. On success C_OK is returned, otherwise C_ERR
  * is returned and part of the output, or all the output, can be
@@ -1408,41 +1582,31 @@ werr:
  * integer pointed by 'error' is set to the value of errno just after the I/O
  * error. */
 int rdbSaveRio(int req, rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
-    char magic[10];
-    uint64_t cksum;
     long key_counter = 0;
     int j;
+    rdbSlotIndex index = {0}, *idx = NULL;
 
-    if (server.rdb_checksum) rdb->update_cksum = rioGenericUpdateChecksum;
-    snprintf(magic, sizeof(magic), "REDIS%04d", RDB_VERSION);
-    if (rdbWriteRaw(rdb, magic, 9) == -1) goto werr;
-    if (rdbSaveInfoAuxFields(rdb, rdbflags, rsi) == -1) goto werr;
-    if (!(req & REPLICA_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, VALKEYMODULE_AUX_BEFORE_RDB) == -1) goto werr;
+    /* The offsets of the index are only meaningful in a file of its own. */
+    if (server.rdb_slot_index && !(req & REPLICA_REQ_RDB_EXCLUDE_DATA) &&
+        !(rdbflags & (RDBFLAGS_AOF_PREAMBLE | RDBFLAGS_REPLICATION)))
+        idx = &index;
 
-    /* save functions */
-    if (!(req & REPLICA_REQ_RDB_EXCLUDE_FUNCTIONS) && rdbSaveFunctions(rdb) == -1) goto werr;
+    if (rdbSaveRioHeader(req, rdb, rdbflags, rsi) == C_ERR) goto werr;
 
     /* save all databases, skip this if we're in functions-only mode */
     if (!(req & REPLICA_REQ_RDB_EXCLUDE_DATA)) {
         for (j = 0; j < server.dbnum; j++) {
-            if (rdbSaveDb(rdb, j, rdbflags, &key_counter) == -1) goto werr;
+            if (rdbSaveDb(rdb, j, rdbflags, &key_counter, idx) == -1) goto werr;
         }
     }
 
-    if (!(req & REPLICA_REQ_RDB_EXCLUDE_DATA) && rdbSaveModulesAux(rdb, VALKEYMODULE_AUX_AFTER_RDB) == -1) goto werr;
-
-    /* EOF opcode */
-    if (rdbSaveType(rdb, RDB_OPCODE_EOF) == -1) goto werr;
-
-    /* CRC64 checksum. It will be zero if checksum computation is disabled, the
-     * loading code skips the check in this case. */
-    cksum = rdb->cksum;
-    memrev64ifbe(&cksum);
-    if (rioWrite(rdb, &cksum, 8) == 0) goto werr;
+    if (rdbSaveRioFooter(req, rdb, idx) == C_ERR) goto werr;
+    zfree(index.entries);
     return C_OK;
 
 werr:
     if (error) *error = errno;
+    zfree(index.entries);
     return C_ERR;
 }
 
@@ -1455,7 +1619,7 @@ werr:
  * While the suffix is the 40 bytes hex string we announced in the prefix.
  * This way processes receiving the payload can understand when it ends
  * without doing any processing of the content. */
-int rdbSaveRioWithEOFMark(int req, rio *rdb, int *error, rdbSaveInfo *rsi) {
+int rdbSaveRioWithEOFMark(int req, rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
     char eofmark[RDB_EOF_MARK_SIZE];
 
     startSaving(RDBFLAGS_REPLICATION);
@@ -1464,7 +1628,7 @@ int rdbSaveRioWithEOFMark(int req, rio *rdb, int *error, rdbSaveInfo *rsi) {
     if (rioWrite(rdb, "$EOF:", 5) == 0) goto werr;
     if (rioWrite(rdb, eofmark, RDB_EOF_MARK_SIZE) == 0) goto werr;
     if (rioWrite(rdb, "\r\n", 2) == 0) goto werr;
-    if (rdbSaveRio(req, rdb, error, RDBFLAGS_REPLICATION, rsi) == C_ERR) goto werr;
+    if (rdbSaveRio(req, rdb, error, RDBFLAGS_REPLICATION | rdbflags, rsi) == C_ERR) goto werr;
     if (rioWrite(rdb, eofmark, RDB_EOF_MARK_SIZE) == 0) goto werr;
     stopSaving(1);
     return C_OK;
@@ -1561,6 +1725,8 @@ int rdbSave(int req, char *filename, rdbSaveInfo *rsi, int rdbflags) {
 
     startSaving(rdbflags);
     snprintf(tmpfile, 256, "temp-%d.rdb", (int)getpid());
+    /* Replicas can no longer resume a transfer of the file we replace. */
+    server.repl_sync_rdb.offset = -1;
 
     if (rdbSaveInternal(req, tmpfile, rsi, rdbflags) != C_OK) {
         stopSaving(0);
@@ -1594,15 +1760,296 @@ int rdbSave(int req, char *filename, rdbSaveInfo *rsi, int rdbflags) {
     return C_OK;
 }
 
+/*-----------------------------------------------------------------------------
+ * Forkless BGSAVE
+ *
+ * When bgsave-forkless is enabled, BGSAVE doesn't fork. Instead the keyspace
+ * is scanned incrementally by the main thread, in small time slices that are
+ * interleaved with the processing of clients, and written to a temp file.
+ *
+ * The snapshot is still a point-in-time one, like with fork(): the copy on
+ * write happens at the key level instead of the page level. Before a key that
+ * the scan didn't reach yet gets modified or deleted, its current value is
+ * written to the file first, and the key is remembered so that the scan skips
+ * it later. Keys created after the start of the snapshot are remembered the
+ * same way, so they are never saved.
+ *
+ * Telling whether the scan already reached a key relies on the position of
+ * the key in the keyspace: DBs and dicts are scanned in order, and the dict
+ * being scanned has its rehashing and resizing paused, so the dictScan()
+ * cursor tells which of its buckets were already visited.
+ *----------------------------------------------------------------------------*/
+
+/* Time spent by the main thread saving keys at every run of the timer. */
+#define RDB_FORKLESS_SAVE_SLICE_US 1000
+
+struct rdbForklessSave {
+    FILE *fp;
+    rio rdb;
+    char tmpfile[256];
+    long long timer_id;   /* Time event that drives the scan. */
+    int error;            /* errno of the first failed write, or 0. */
+    int selected_db;      /* DB of the last SELECTDB opcode written, or -1. */
+    int dbid;             /* DB being scanned. */
+    int didx;             /* Dict index being scanned inside the DB. */
+    int pinned;           /* True if the dict at 'didx' is paused for the scan. */
+    unsigned long cursor; /* dictScan() cursor inside the pinned dict. */
+    dict **touched;       /* Per DB sets of keys the scan must skip, because they
+                           * were already saved or they were created after the
+                           * snapshot started. */
+};
+
+/* Returns 1 if the scan already went past the position of 'key' in the
+ * keyspace, so whatever happens to the key can't affect the snapshot. */
+static int rdbForklessSaveKeyScanned(struct rdbForklessSave *fs, int dbid, int didx, sds key) {
+    if (dbid != fs->dbid) return dbid < fs->dbid;
+    if (didx != fs->didx) return didx < fs->didx;
+    if (!fs->pinned) return 0;
+    return dictScanCursorPassed(kvstoreGetDict(server.db[dbid].keys, didx), fs->cursor, key);
+}
+
+static void rdbForklessSaveKey(struct rdbForklessSave *fs, serverDb *db, sds keystr, robj *o) {
+    robj key;
+
+    if (fs->error) return;
+    if (fs->selected_db != db->id) {
+        if (rdbSaveType(&fs->rdb, RDB_OPCODE_SELECTDB) == -1 || rdbSaveLen(&fs->rdb, db->id) == -1) goto werr;
+        fs->selected_db = db->id;
+    }
+    initStaticStringObject(key, keystr);
+    if (rdbSaveKeyValuePair(&fs->rdb, &key, o, getExpire(db, &key), db->id) == -1) goto werr;
+    return;
+
+werr:
+    fs->error = errno ? errno : EIO;
+}
+
+/* Called before the key at 'key' is created, modified or deleted while a
+ * forkless BGSAVE is in progress. If the scan didn't reach the key yet, its
+ * current value (if any) is saved right away and the scan will skip it. */
+void rdbForklessSaveKeyWillChange(serverDb *db, sds key, int dict_index) {
+    struct rdbForklessSave *fs = server.rdb_forkless;
+
+    if (rdbForklessSaveKeyScanned(fs, db->id, dict_index, key)) return;
+    if (fs->touched[db->id] == NULL) fs->touched[db->id] = dictCreate(&setDictType);
+    if (dictFind(fs->touched[db->id], key)) return;
+    dictAdd(fs->touched[db->id], sdsdup(key), NULL);
+
+    dictEntry *de = kvstoreDictFind(db->keys, dict_index, key);
+    if (de) rdbForklessSaveKey(fs, db, dictGetKey(de), dictGetVal(de));
+}
+
+static void rdbForklessSaveScanCallback(void *privdata, const dictEntry *de) {
+    struct rdbForklessSave *fs = privdata;
+    serverDb *db = server.db + fs->dbid;
+    sds key = dictGetKey(de);
+
+    /* Keys found in the touched set were saved before being modified, or
+     * didn't exist when the snapshot started. Either way we are done with
+     * them, as the scan never visits the same bucket twice. */
+    if (fs->touched[fs->dbid] && dictDelete(fs->touched[fs->dbid], key) == DICT_OK) return;
+    rdbForklessSaveKey(fs, db, key, dictGetVal(de));
+}
+
+static void rdbForklessSaveUnpin(struct rdbForklessSave *fs) {
+    if (!fs->pinned) return;
+    kvstoreDictResumeRehashing(server.db[fs->dbid].keys, fs->didx);
+    fs->pinned = 0;
+}
+
+/* Scans the keyspace for up to 'us' microseconds. Returns 1 once every DB
+ * was scanned, 0 otherwise. */
+static int rdbForklessSaveScan(struct rdbForklessSave *fs, uint64_t us) {
+    monotime timer;
+    elapsedStart(&timer);
+
+    while (fs->dbid < server.dbnum) {
+        kvstore *keys = server.db[fs->dbid].keys;
+
+        if (fs->didx == kvstoreNumDicts(keys)) {
+            fs->dbid++;
+            fs->didx = 0;
+            continue;
+        }
+
+        dict *d = kvstoreGetDict(keys, fs->didx);
+        if (!fs->pinned) {
+            if (!d || dictSize(d) == 0) {
+                /* Nothing here belongs to the snapshot: every key the dict
+                 * had at the start was deleted, and was saved at that time. */
+                fs->didx++;
+                continue;
+            }
+            if (dictIsRehashing(d)) {
+                /* Positions in the dict are only stable with a single table. */
+                dictRehashMicroseconds(d, us);
+            } else {
+                kvstoreDictPauseRehashing(keys, fs->didx);
+                fs->pinned = 1;
+                fs->cursor = 0;
+            }
+        }
+
+        if (fs->pinned) {
+            fs->cursor = dictScan(d, fs->cursor, rdbForklessSaveScanCallback, fs);
+            if (fs->cursor == 0) {
+                rdbForklessSaveUnpin(fs);
+                fs->didx++;
+            }
+        }
+        if (fs->error || elapsedUs(timer) >= us) return 0;
+    }
+    return 1;
+}
+
+static void rdbForklessSaveRelease(struct rdbForklessSave *fs) {
+    rdbForklessSaveUnpin(fs);
+    if (fs->timer_id != AE_DELETED_EVENT_ID) aeDeleteTimeEvent(server.el, fs->timer_id);
+    if (fs->fp) fclose(fs->fp);
+    for (int j = 0; j < server.dbnum; j++) {
+        if (fs->touched[j]) dictRelease(fs->touched[j]);
+    }
+    zfree(fs->touched);
+    zfree(fs);
+    server.rdb_forkless = NULL;
+    server.rdb_save_time_last = time(NULL) - server.rdb_save_time_start;
+    server.rdb_save_time_start = -1;
+}
+
+/* Writes the end of the RDB, flushes the file and moves it in place. */
+static int rdbForklessSaveComplete(struct rdbForklessSave *fs) {
+    char *err_op;
+
+    if (rdbSaveRioFooter(REPLICA_REQ_NONE, &fs->rdb, NULL) == C_ERR) {
+        err_op = "rdbSaveRio";
+        goto werr;
+    }
+    if (fflush(fs->fp)) {
+        err_op = "fflush";
+        goto werr;
+    }
+    if (fsync(fileno(fs->fp))) {
+        err_op = "fsync";
+        goto werr;
+    }
+    if (reclaimFilePageCache(fileno(fs->fp), 0, 0) == -1) {
+        serverLog(LL_NOTICE, "Unable to reclaim cache after saving RDB: %s", strerror(errno));
+    }
+    int retval = fclose(fs->fp);
+    fs->fp = NULL;
+    if (retval) {
+        err_op = "fclose";
+        goto werr;
+    }
+    if (rename(fs->tmpfile, server.rdb_filename) == -1) {
+        err_op = "rename";
+        goto werr;
+    }
+    if (fsyncFileDir(server.rdb_filename) != 0) {
+        err_op = "fsync dir";
+        goto werr;
+    }
+    return C_OK;
+
+werr:
+    serverLog(LL_WARNING, "Write error while saving DB to the disk(%s): %s", err_op, strerror(errno));
+    return C_ERR;
+}
+
+static long long rdbForklessSaveTimeProc(struct aeEventLoop *eventLoop, long long id, void *clientData) {
+    UNUSED(eventLoop);
+    UNUSED(id);
+    struct rdbForklessSave *fs = clientData;
+
+    if (!rdbForklessSaveScan(fs, RDB_FORKLESS_SAVE_SLICE_US) && !fs->error) return 0; /* keep scanning */
+
+    if (fs->error) {
+        errno = fs->error;
+        serverLog(LL_WARNING, "Write error while saving DB to the disk(rdbSaveRio): %s", strerror(errno));
+    }
+    if (!fs->error && rdbForklessSaveComplete(fs) == C_OK) {
+        serverLog(LL_NOTICE, "Background saving terminated with success");
+        server.dirty = server.dirty - server.dirty_before_bgsave;
+        server.lastsave = time(NULL);
+        server.lastbgsave_status = C_OK;
+    } else {
+        serverLog(LL_WARNING, "Background saving error");
+        server.lastbgsave_status = C_ERR;
+        unlink(fs->tmpfile);
+    }
+    fs->timer_id = AE_DELETED_EVENT_ID;
+    rdbForklessSaveRelease(fs);
+    /* Start the BGSAVE the replicas may be waiting for. */
+    replicationStartPendingFork();
+    return AE_NOMORE;
+}
+
+/* Starts a forkless BGSAVE to 'server.rdb_filename'. */
+static int rdbForklessSaveStart(rdbSaveInfo *rsi) {
+    struct rdbForklessSave *fs = zcalloc(sizeof(*fs));
+
+    snprintf(fs->tmpfile, sizeof(fs->tmpfile), "temp-forkless-%d.rdb", (int)getpid());
+    fs->fp = fopen(fs->tmpfile, "w");
+    if (!fs->fp) {
+        serverLog(LL_WARNING, "Failed opening the temp RDB file %s for saving: %s", fs->tmpfile, strerror(errno));
+        zfree(fs);
+        return C_ERR;
+    }
+    rioInitWithFile(&fs->rdb, fs->fp);
+    if (server.rdb_save_incremental_fsync) {
+        rioSetAutoSync(&fs->rdb, REDIS_AUTOSYNC_BYTES);
+        rioSetReclaimCache(&fs->rdb, 1);
+    }
+    if (rdbSaveRioHeader(REPLICA_REQ_NONE, &fs->rdb, RDBFLAGS_NONE, rsi) == C_ERR) {
+        serverLog(LL_WARNING, "Write error while saving DB to the disk(rdbSaveRio): %s", strerror(errno));
+        fclose(fs->fp);
+        unlink(fs->tmpfile);
+        zfree(fs);
+        return C_ERR;
+    }
+    /* Keys are saved in scan order, interleaved with the ones about to be
+     * modified, so the keys of a slot don't form a single section. */
+    if (server.rdb_slot_index)
+        serverLog(LL_NOTICE, "Forkless BGSAVE does not support rdb-slot-index, the RDB file will have no slot index.");
+    fs->selected_db = -1;
+    fs->touched = zcalloc(sizeof(dict *) * server.dbnum);
+    fs->timer_id = aeCreateTimeEvent(server.el, 0, rdbForklessSaveTimeProc, fs, NULL);
+    server.rdb_forkless = fs;
+    return C_OK;
+}
+
+/* Stops a forkless BGSAVE in progress, if any, without flagging an error.
+ * Used when the dataset is going to be replaced or the server shuts down,
+ * similarly to killRDBChild(). */
+void rdbForklessSaveAbort(void) {
+    struct rdbForklessSave *fs = server.rdb_forkless;
+    if (!fs) return;
+    serverLog(LL_NOTICE, "Forkless background saving aborted");
+    unlink(fs->tmpfile);
+    rdbForklessSaveRelease(fs);
+}
+
 int rdbSaveBackground(int req, char *filename, rdbSaveInfo *rsi, int rdbflags) {
     pid_t childpid;
 
     if (hasActiveChildProcess()) return C_ERR;
+    if (server.rdb_forkless) return C_ERR;
     server.stat_rdb_saves++;
+    server.repl_sync_rdb.offset = -1;
 
     server.dirty_before_bgsave = server.dirty;
     server.lastbgsave_try = time(NULL);
 
+    if (server.bgsave_forkless && !(rdbflags & RDBFLAGS_REPLICATION)) {
+        if (rdbForklessSaveStart(rsi) == C_ERR) {
+            server.lastbgsave_status = C_ERR;
+            return C_ERR;
+        }
+        serverLog(LL_NOTICE, "Background saving started without fork");
+        server.rdb_save_time_start = time(NULL);
+        return C_OK;
+    }
+
     if ((childpid = serverFork(CHILD_TYPE_RDB)) == 0) {
         int retval;
 
@@ -2115,7 +2562,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
             if (sdslen(field) > server.hash_max_listpack_value || sdslen(value) > server.hash_max_listpack_value ||
                 !lpSafeToAdd(o->ptr, sdslen(field) + sdslen(value))) {
                 hashTypeConvert(o, OBJ_ENCODING_HT);
-                ret = dictAdd((dict *)o->ptr, field, value);
+                ret = hashTypeDictAdd((dict *)o->ptr, field, value);
                 if (ret == DICT_ERR) {
                     rdbReportCorruptRDB("Duplicate hash fields detected");
                     if (dupSearchDict) dictRelease(dupSearchDict);
@@ -2165,7 +2612,7 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
             }
 
             /* Add pair to hash table */
-            ret = dictAdd((dict *)o->ptr, field, value);
+            ret = hashTypeDictAdd((dict *)o->ptr, field, value);
             if (ret == DICT_ERR) {
                 rdbReportCorruptRDB("Duplicate hash fields detected");
                 sdsfree(value);
@@ -2736,10 +3183,10 @@ robj *rdbLoadObject(int rdbtype, rio *rdb, sds key, int dbid, int *error) {
                     streamNACK *nack = result;
 
                     /* Set the NACK consumer, that was left to NULL when
-                     * loading the global PEL. Then set the same shared
-                     * NACK structure also in the consumer-specific PEL. */
+                     * loading the global PEL. Then add the ID also to the
+                     * consumer-specific PEL. */
                     nack->consumer = consumer;
-                    if (!raxTryInsert(consumer->pel, rawid, sizeof(rawid), nack, NULL)) {
+                    if (!raxTryInsert(consumer->pel, rawid, sizeof(rawid), NULL, NULL)) {
                         rdbReportCorruptRDB("Duplicated consumer PEL entry "
                                             " loading a stream consumer "
                                             "group");
@@ -3132,6 +3579,8 @@ int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadin
                 if (isbase) serverLog(LL_NOTICE, "RDB is base AOF");
             } else if (!strcasecmp(auxkey->ptr, "redis-bits")) {
                 /* Just ignored. */
+            } else if (!strcasecmp(auxkey->ptr, RDB_SLOT_INDEX_AUX)) {
+                /* Only useful to readers that seek in the file. */
             } else if (!strcasecmp(auxkey->ptr, "slot-info")) {
                 int slot_id;
                 unsigned long slot_size, expires_slot_size;
@@ -3510,7 +3959,7 @@ void killRDBChild(void) {
 
 /* Spawn an RDB child that writes the RDB to the sockets of the replicas
  * that are currently in REPLICA_STATE_WAIT_BGSAVE_START state. */
-int rdbSaveToReplicasSockets(int req, rdbSaveInfo *rsi) {
+int rdbSaveToReplicasSockets(int req, int rdbflags, rdbSaveInfo *rsi) {
     listNode *ln;
     listIter li;
     pid_t childpid;
@@ -3599,7 +4048,7 @@ int rdbSaveToReplicasSockets(int req, rdbSaveInfo *rsi) {
         }
         serverSetCpuAffinity(server.bgsave_cpulist);
 
-        retval = rdbSaveRioWithEOFMark(req, &rdb, NULL, rsi);
+        retval = rdbSaveRioWithEOFMark(req, &rdb, NULL, rdbflags, rsi);
         if (retval == C_OK && rioFlush(&rdb) == 0) retval = C_ERR;
 
         if (retval == C_OK) {
@@ -3670,7 +4119,7 @@ int rdbSaveToReplicasSockets(int req, rdbSaveInfo *rsi) {
 }
 
 void saveCommand(client *c) {
-    if (server.child_type == CHILD_TYPE_RDB) {
+    if (server.child_type == CHILD_TYPE_RDB || server.rdb_forkless) {
         addReplyError(c, "Background save already in progress");
         return;
     }
@@ -3702,6 +4151,10 @@ void bgsaveCommand(client *c) {
                 serverLog(LL_NOTICE, "Background saving will be aborted due to user request");
                 killRDBChild();
                 addReplyStatus(c, "Background saving cancelled");
+            } else if (server.rdb_forkless) {
+                serverLog(LL_NOTICE, "Background saving will be aborted due to user request");
+                rdbForklessSaveAbort();
+                addReplyStatus(c, "Background saving cancelled");
             } else if (server.rdb_bgsave_scheduled == 1) {
                 serverLog(LL_NOTICE, "Scheduled background saving will be cancelled due to user request");
                 server.rdb_bgsave_scheduled = 0;
@@ -3719,7 +4172,7 @@ void bgsaveCommand(client *c) {
     rdbSaveInfo rsi, *rsiptr;
     rsiptr = rdbPopulateSaveInfo(&rsi);
 
-    if (server.child_type == CHILD_TYPE_RDB) {
+    if (server.child_type == CHILD_TYPE_RDB || server.rdb_forkless) {
         addReplyError(c, "Background save already in progress");
     } else if (hasActiveChildProcess() || server.in_exec) {
         if (schedule || server.in_exec) {
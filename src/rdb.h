@@ -68,6 +68,7 @@
 #define RDB_ENC_INT16 1 /* 16 bit signed integer */
 #define RDB_ENC_INT32 2 /* 32 bit signed integer */
 #define RDB_ENC_LZF 3   /* string compressed with FASTLZ */
+#define RDB_ENC_LZ4 4   /* string compressed with LZ4 */
 
 /* Map object types to RDB object types. Macros starting with OBJ_ are for
  * memory storage and may change. Instead RDB types must be fixed because
@@ -133,6 +134,39 @@
 #define RDBFLAGS_ALLOW_DUP (1 << 2)    /* Allow duplicated keys when loading.*/
 #define RDBFLAGS_FEED_REPL (1 << 3)    /* Feed replication stream when loading.*/
 #define RDBFLAGS_KEEP_CACHE (1 << 4)   /* Don't reclaim cache after rdb file is generated */
+#define RDBFLAGS_LZF_ONLY (1 << 5)     /* Save for a replica that can't load LZ4 strings. */
+
+/* The "slot-index" AUX field, saved last before the EOF opcode when
+ * rdb-slot-index is enabled, lists the sections of the file holding the keys
+ * of each (DB, slot) pair, so that a reader can seek to the keys it needs.
+ * Its value is not compressed, and is laid out as:
+ *
+ * <entry>...<entry> <count:8> "SLOTIDX1"
+ *
+ * Each entry is RDB_SLOT_INDEX_ENTRY_LEN bytes: <dbid:4> <slot:4> <offset:8>
+ * <length:8> <keys:8> <crc64:8>, all little endian. The section at 'offset'
+ * starts with the "slot-info" AUX field of the slot in cluster mode, or with
+ * the first key of the DB otherwise, and 'crc64' (zero when rdbchecksum is
+ * disabled) covers its 'length' bytes. Since the EOF opcode and the checksum
+ * follow, the trailer of the index starts RDB_SLOT_INDEX_TRAILER_END_OFFSET
+ * bytes before the end of the file.
+ *
+ * Forkless saves (bgsave-forkless) don't write the index. */
+#define RDB_SLOT_INDEX_AUX "slot-index"
+#define RDB_SLOT_INDEX_MAGIC "SLOTIDX1"
+#define RDB_SLOT_INDEX_ENTRY_LEN 40
+#define RDB_SLOT_INDEX_TRAILER_LEN 16
+/* Trailer, EOF opcode and 8 bytes checksum. */
+#define RDB_SLOT_INDEX_TRAILER_END_OFFSET (RDB_SLOT_INDEX_TRAILER_LEN + 1 + 8)
+
+typedef struct rdbSlotIndexEntry {
+    uint32_t dbid;
+    uint32_t slot;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t keys;
+    uint64_t crc;
+} rdbSlotIndexEntry;
 
 /* When rdbLoadObject() returns NULL, the err flag is
  * set to hold the type of error that occurred */
@@ -152,7 +186,9 @@ int rdbSaveObjectType(rio *rdb, robj *o);
 int rdbLoadObjectType(rio *rdb);
 int rdbLoad(char *filename, rdbSaveInfo *rsi, int rdbflags);
 int rdbSaveBackground(int req, char *filename, rdbSaveInfo *rsi, int rdbflags);
-int rdbSaveToReplicasSockets(int req, rdbSaveInfo *rsi);
+int rdbSaveToReplicasSockets(int req, int rdbflags, rdbSaveInfo *rsi);
+void rdbForklessSaveKeyWillChange(serverDb *db, sds key, int dict_index);
+void rdbForklessSaveAbort(void);
 void rdbRemoveTempFile(pid_t childpid, int from_signal);
 int rdbSaveToFile(const char *filename);
 int rdbSave(int req, char *filename, rdbSaveInfo *rsi, int rdbflags);
@@ -175,6 +211,7 @@ int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi);
 int rdbLoadRioWithLoadingCtx(rio *rdb, int rdbflags, rdbSaveInfo *rsi, rdbLoadingCtx *rdb_loading_ctx);
 int rdbFunctionLoad(rio *rdb, int ver, functionsLibCtx *lib_ctx, int rdbflags, sds *err);
 int rdbSaveRio(int req, rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi);
+int rdbSlotIndexDecode(const unsigned char *buf, size_t len, rdbSlotIndexEntry **entries, size_t *count);
 ssize_t rdbSaveFunctions(rio *rdb);
 rdbSaveInfo *rdbPopulateSaveInfo(rdbSaveInfo *rsi);
 
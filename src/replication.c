@@ -51,7 +51,9 @@ void replicationResurrectProvisionalPrimary(void);
 void replicationSendAck(void);
 int replicaPutOnline(client *replica);
 void replicaStartCommandStream(client *replica);
+void sendBulkToReplica(connection *conn);
 int cancelReplicationHandshake(int reconnect);
+void replicationDiscardResumableTransfer(void);
 void replicationSteadyStateInit(void);
 void dualChannelSetupMainConnForPsync(connection *conn);
 void dualChannelSyncHandleRdbLoadCompletion(void);
@@ -279,10 +281,18 @@ void removeReplicaFromPsyncWait(client *replica_main_client) {
     raxRemove(server.replicas_waiting_psync, (unsigned char *)&id, sizeof(id), NULL);
 }
 
+/* Free method of the replication buffer blocks list. It may be called by
+ * a bio thread, see freeReplicationBacklogRefMemAsync(). */
+static void freeReplBufBlock(void *ptr) {
+    replBufBlock *o = ptr;
+    sdsfree(o->frame);
+    zfree(o);
+}
+
 void resetReplicationBuffer(void) {
     server.repl_buffer_mem = 0;
     server.repl_buffer_blocks = listCreate();
-    listSetFreeMethod(server.repl_buffer_blocks, (void (*)(void *))zfree);
+    listSetFreeMethod(server.repl_buffer_blocks, freeReplBufBlock);
 }
 
 int canFeedReplicaReplBuffer(client *replica) {
@@ -379,6 +389,7 @@ void incrementalTrimReplicationBacklog(size_t max_blocks) {
         /* Delete the first node from global replication buffer. */
         serverAssert(fo->refcount == 0 && fo->used == fo->size);
         server.repl_buffer_mem -= (fo->size + sizeof(listNode) + sizeof(replBufBlock));
+        if (fo->frame) server.repl_buffer_mem -= sdsAllocSize(fo->frame);
         listDelNode(server.repl_buffer_blocks, first);
     }
 
@@ -404,6 +415,162 @@ void freeReplicaReferencedReplBuffer(client *replica) {
     }
     replica->ref_repl_buf_node = NULL;
     replica->ref_block_pos = 0;
+    sdsfree(replica->repl_frame);
+    replica->repl_frame = NULL;
+}
+
+/* ------------------------ Compressed replication stream --------------------
+ * A primary with repl-compression enabled sends the replication stream to
+ * the replicas that announced "capa lzf" as a sequence of frames:
+ *
+ * <type:1> <raw length:4> <payload length:4> <payload>
+ *
+ * Lengths are little endian. The payload of a REPL_FRAME_LZF or
+ * REPL_FRAME_LZ4 frame is the compressed form of the raw data, while data
+ * that does not compress is sent as is in a REPL_FRAME_RAW frame. LZ4 frames,
+ * used when repl-compression-codec is lz4, are only sent to the replicas that
+ * also announced "capa lz4". The replication offsets keep counting the bytes
+ * of the uncompressed stream.
+ *
+ * Full blocks of the replication buffer are compressed once, and the frame
+ * is cached in the block for all the replicas (and the partial syncs) that
+ * will send it later. Replicas that are in sync send the tail of the buffer
+ * as it grows, and compress it on their own.
+ * -------------------------------------------------------------------------- */
+
+#define REPL_FRAME_HDR_LEN 9
+#define REPL_FRAME_RAW 'R'
+#define REPL_FRAME_LZF 'L'
+#define REPL_FRAME_LZ4 '4'
+#define REPL_FRAME_MAX_LEN (1024 * 1024)
+#define REPL_FRAME_MIN_COMPRESS_LEN 64
+
+static sds replicationCreateFrame(const char *buf, size_t len, int codec) {
+    sds frame = sdsnewlen(SDS_NOINIT, REPL_FRAME_HDR_LEN + len);
+    uint32_t rawlen = len, paylen = 0;
+
+    /* Give up compressing if it doesn't save at least one byte. */
+    if (len >= REPL_FRAME_MIN_COMPRESS_LEN)
+        paylen = compressionCompress(codec, buf, len, frame + REPL_FRAME_HDR_LEN, len - 1);
+    if (paylen == 0) {
+        frame[0] = REPL_FRAME_RAW;
+        memcpy(frame + REPL_FRAME_HDR_LEN, buf, len);
+        paylen = len;
+    } else {
+        frame[0] = codec == COMPRESSION_CODEC_LZ4 ? REPL_FRAME_LZ4 : REPL_FRAME_LZF;
+    }
+    sdssetlen(frame, REPL_FRAME_HDR_LEN + paylen);
+    memrev32ifbe(&rawlen);
+    memrev32ifbe(&paylen);
+    memcpy(frame + 1, &rawlen, 4);
+    memcpy(frame + 5, &paylen, 4);
+    return frame;
+}
+
+/* Whether the stream to this replica, that is about to be told how the
+ * synchronization will happen, should be compressed. */
+static int replicationShouldCompress(client *replica) {
+    return server.repl_compression && (replica->replica_capa & REPLICA_CAPA_LZF) &&
+           !(replica->replica_capa & REPLICA_CAPA_DUAL_CHANNEL) && !replica->flag.repl_rdbonly;
+}
+
+/* The codec to compress the frames sent to the replica with. */
+static int replicationFrameCodec(client *replica) {
+    return (replica->replica_capa & REPLICA_CAPA_LZ4) ? server.repl_compression_codec : COMPRESSION_CODEC_LZF;
+}
+
+/* Return the next frame of the replication stream to send to the replica,
+ * and move its position in the replication buffer past the data the frame
+ * holds. Must be called only if the replica has pending data. */
+sds replicationNextFrame(client *replica) {
+    listNode *ln = replica->ref_repl_buf_node;
+    replBufBlock *o = listNodeValue(ln);
+    sds frame;
+
+    if (replica->ref_block_pos == o->used) {
+        listNode *next = listNextNode(ln);
+        serverAssert(next != NULL);
+        o->refcount--;
+        o = listNodeValue(next);
+        o->refcount++;
+        replica->ref_repl_buf_node = next;
+        replica->ref_block_pos = 0;
+        incrementalTrimReplicationBacklog(REPL_BACKLOG_TRIM_BLOCKS_PER_CALL);
+    }
+
+    int codec = replicationFrameCodec(replica);
+    size_t len = o->used - replica->ref_block_pos;
+    if (replica->ref_block_pos == 0 && o->used == o->size && len <= REPL_FRAME_MAX_LEN &&
+        (o->frame == NULL || o->frame[0] != REPL_FRAME_LZ4 || codec == COMPRESSION_CODEC_LZ4)) {
+        /* The block is full and won't change anymore. A cached LZ4 frame
+         * can't be sent to replicas without LZ4 support: they take the
+         * path below. */
+        if (o->frame == NULL) {
+            o->frame = replicationCreateFrame(o->buf, o->used, codec);
+            server.repl_buffer_mem += sdsAllocSize(o->frame);
+        }
+        frame = sdsdup(o->frame);
+    } else {
+        if (len > REPL_FRAME_MAX_LEN) len = REPL_FRAME_MAX_LEN;
+        frame = replicationCreateFrame(o->buf + replica->ref_block_pos, len, codec);
+    }
+    replica->ref_block_pos += len;
+    return frame;
+}
+
+/* Called after reading from a primary that sends compressed frames: replace the
+ * c->nread bytes just appended to the query buffer with the content of the
+ * frames they complete. The tail of an incomplete frame is kept in
+ * c->repl_frame for the next read.
+ *
+ * Returns the number of bytes appended to the query buffer, or -1 if the
+ * primary sent a corrupted frame. */
+long long replicationInflateQueryBuf(client *c) {
+    size_t qblen = sdslen(c->querybuf) - c->nread;
+    long long inflated = 0;
+    size_t pos = 0, avail;
+
+    if (c->repl_frame) {
+        c->repl_frame = sdscatlen(c->repl_frame, c->querybuf + qblen, c->nread);
+    } else {
+        c->repl_frame = sdsnewlen(c->querybuf + qblen, c->nread);
+    }
+    sdssetlen(c->querybuf, qblen);
+    c->querybuf[qblen] = '\0';
+
+    avail = sdslen(c->repl_frame);
+    while (avail - pos >= REPL_FRAME_HDR_LEN) {
+        unsigned char *p = (unsigned char *)c->repl_frame + pos;
+        uint32_t rawlen, paylen;
+        memcpy(&rawlen, p + 1, 4);
+        memcpy(&paylen, p + 5, 4);
+        memrev32ifbe(&rawlen);
+        memrev32ifbe(&paylen);
+        if (avail - pos - REPL_FRAME_HDR_LEN < paylen) break;
+
+        c->querybuf = sdsMakeRoomFor(c->querybuf, rawlen);
+        char *dst = c->querybuf + sdslen(c->querybuf);
+        int codec = p[0] == REPL_FRAME_LZ4 ? COMPRESSION_CODEC_LZ4 : COMPRESSION_CODEC_LZF;
+        if (p[0] == REPL_FRAME_RAW && paylen == rawlen) {
+            memcpy(dst, p + REPL_FRAME_HDR_LEN, rawlen);
+        } else if ((p[0] != REPL_FRAME_LZF && p[0] != REPL_FRAME_LZ4) ||
+                   compressionDecompress(codec, p + REPL_FRAME_HDR_LEN, paylen, dst, rawlen) != rawlen) {
+            serverLog(LL_WARNING, "Corrupted frame in the compressed replication stream from primary.");
+            return -1;
+        }
+        sdsIncrLen(c->querybuf, rawlen);
+        inflated += rawlen;
+        pos += REPL_FRAME_HDR_LEN + paylen;
+    }
+
+    if (pos == avail) {
+        sdsfree(c->repl_frame);
+        c->repl_frame = NULL;
+    } else {
+        sdsrange(c->repl_frame, pos, -1);
+    }
+    if (c->querybuf_peak < sdslen(c->querybuf)) c->querybuf_peak = sdslen(c->querybuf);
+    return inflated;
 }
 
 /* Replication: Primary side.
@@ -457,6 +624,7 @@ void feedReplicationBuffer(char *s, size_t len) {
             size_t copy = (tail->size >= len) ? len : tail->size;
             tail->used = copy;
             tail->refcount = 0;
+            tail->frame = NULL;
             tail->repl_offset = server.primary_repl_offset + 1;
             tail->id = repl_block_id++;
             memcpy(tail->buf, s, copy);
@@ -522,9 +690,11 @@ void feedReplicationBuffer(char *s, size_t len) {
  * This function is used if the instance is a primary: we use the commands
  * received by our clients in order to create the replication stream.
  * Instead if the instance is a replica and has sub-replicas attached, we use
- * replicationFeedStreamFromPrimaryStream() */
-void replicationFeedReplicas(int dictid, robj **argv, int argc) {
-    int j, len;
+ * replicationFeedStreamFromPrimaryStream()
+ *
+ * This part feeds the SELECT command if needed, and returns 0 if the
+ * command itself should not be written to the replication buffer. */
+static int replicationFeedReplicasPrepare(int dictid) {
     char llstr[LONG_STR_SIZE];
 
     /* In case we propagate a command that doesn't touch keys (PING, REPLCONF) we
@@ -536,7 +706,7 @@ void replicationFeedReplicas(int dictid, robj **argv, int argc) {
      * propagate *identical* replication stream. In this way this replica can
      * advertise the same replication ID as the primary (since it shares the
      * primary replication history and has the same backlog and offsets). */
-    if (server.primary_host != NULL) return;
+    if (server.primary_host != NULL) return 0;
 
     /* If there aren't replicas, and there is no backlog buffer to populate,
      * we can return ASAP. */
@@ -545,7 +715,7 @@ void replicationFeedReplicas(int dictid, robj **argv, int argc) {
          * even when there's no replication active. This code will not be reached if AOF
          * is also disabled. */
         server.primary_repl_offset += 1;
-        return;
+        return 0;
     }
 
     /* We can't have replicas attached and no backlog. */
@@ -581,6 +751,13 @@ void replicationFeedReplicas(int dictid, robj **argv, int argc) {
 
         server.replicas_eldb = dictid;
     }
+    return 1;
+}
+
+void replicationFeedReplicas(int dictid, robj **argv, int argc) {
+    int j, len;
+
+    if (!replicationFeedReplicasPrepare(dictid)) return;
 
     /* Write the command to the replication buffer if any. */
     char aux[LONG_STR_SIZE + 3];
@@ -608,6 +785,12 @@ void replicationFeedReplicas(int dictid, robj **argv, int argc) {
     }
 }
 
+/* Like replicationFeedReplicas(), for a command already in RESP format. */
+void replicationFeedReplicasEncoded(int dictid, const char *cmd, size_t len) {
+    if (!replicationFeedReplicasPrepare(dictid)) return;
+    feedReplicationBuffer((char *)cmd, len);
+}
+
 /* This is a debugging function that gets called when we detect something
  * wrong with the replication protocol: the goal is to peek into the
  * replication backlog and show a few final bytes to make simpler to
@@ -814,7 +997,9 @@ int replicationSetupReplicaForFullResync(client *replica, long long offset) {
     /* Don't send this reply to replicas that approached us with
      * the old SYNC command. */
     if (!(replica->flag.pre_psync)) {
-        buflen = snprintf(buf, sizeof(buf), "+FULLRESYNC %s %lld\r\n", server.replid, offset);
+        replica->flag.repl_compressed = replicationShouldCompress(replica);
+        buflen = snprintf(buf, sizeof(buf), "+FULLRESYNC %s %lld%s\r\n", server.replid, offset,
+                          replica->flag.repl_compressed ? " lzf" : "");
         if (connWrite(replica->conn, buf, buflen) != buflen) {
             freeClientAsync(replica);
             return C_ERR;
@@ -901,7 +1086,8 @@ int primaryTryPartialResynchronization(client *c, long long psync_offset) {
      * new commands at this stage. But we are sure the socket send buffer is
      * empty so this write will never fail actually. */
     if (c->replica_capa & REPLICA_CAPA_PSYNC2) {
-        buflen = snprintf(buf, sizeof(buf), "+CONTINUE %s\r\n", server.replid);
+        c->flag.repl_compressed = replicationShouldCompress(c);
+        buflen = snprintf(buf, sizeof(buf), "+CONTINUE %s%s\r\n", server.replid, c->flag.repl_compressed ? " lzf" : "");
     } else {
         buflen = snprintf(buf, sizeof(buf), "+CONTINUE\r\n");
     }
@@ -933,6 +1119,94 @@ need_full_resync:
     return C_ERR;
 }
 
+/* This function handles the RESUME option of the PSYNC command, sent by a
+ * replica whose transfer of the RDB file on disk was interrupted:
+ *
+ * PSYNC <psync-replid> <psync-offset> RESUME <replid> <offset> <received>
+ *
+ * It is only considered when a partial resynchronization is not possible.
+ * <replid> and <offset> are the ones of the +FULLRESYNC reply that started
+ * the transfer, and <received> is the number of bytes of the file the
+ * replica already has. If the RDB file on disk is still that snapshot and
+ * the backlog still holds the stream from its offset, we reply with:
+ *
+ * +RESUMESYNC <replid> <offset>
+ *
+ * and send the usual "$<length>\r\n" preamble followed by the part of the
+ * file the replica is missing, and then the backlog.
+ *
+ * On success return C_OK, otherwise C_ERR is returned and we proceed
+ * with the usual full resync. */
+int primaryTryResumeTransfer(client *c) {
+    char *replid = c->argv[4]->ptr;
+    long long offset, received;
+    struct valkey_stat st;
+    char buf[128];
+    int buflen, fd;
+
+    if (getLongLongFromObject(c->argv[5], &offset) != C_OK || getLongLongFromObject(c->argv[6], &received) != C_OK)
+        return C_ERR;
+
+    /* With diskless sync the replica would get a new snapshot streamed
+     * anyway, there is no file we are supposed to keep on disk for it. */
+    if (server.repl_diskless_sync) {
+        serverLog(LL_NOTICE, "Unable to resume the RDB transfer to replica %s: diskless sync is enabled.",
+                  replicationGetReplicaName(c));
+        return C_ERR;
+    }
+
+    if (server.repl_sync_rdb.offset == -1 || offset != server.repl_sync_rdb.offset ||
+        strcasecmp(replid, server.repl_sync_rdb.replid) || received <= 0 || received >= server.repl_sync_rdb.size) {
+        serverLog(LL_NOTICE, "Unable to resume the RDB transfer to replica %s: the snapshot is gone.",
+                  replicationGetReplicaName(c));
+        return C_ERR;
+    }
+
+    /* The replica needs the stream that followed the snapshot, and its own
+     * requirements must match the ones of a regular disk-based sync. */
+    if (!server.repl_backlog || offset + 1 < server.repl_backlog->offset ||
+        offset + 1 > server.repl_backlog->offset + server.repl_backlog->histlen || c->flag.repl_rdbonly ||
+        c->replica_req != REPLICA_REQ_NONE) {
+        serverLog(LL_NOTICE, "Unable to resume the RDB transfer to replica %s for lack of backlog.",
+                  replicationGetReplicaName(c));
+        return C_ERR;
+    }
+
+    if ((fd = open(server.rdb_filename, O_RDONLY)) == -1) return C_ERR;
+    if (valkey_fstat(fd, &st) == -1 || st.st_size != server.repl_sync_rdb.size) {
+        close(fd);
+        return C_ERR;
+    }
+
+    waitForClientIO(c);
+    c->flag.replica = 1;
+    c->psync_initial_offset = offset;
+    c->repl_state = REPLICA_STATE_SEND_BULK;
+    c->repldbfd = fd;
+    c->repldboff = received;
+    c->repldbsize = st.st_size;
+    c->replpreamble = sdscatprintf(sdsempty(), "$%lld\r\n", (unsigned long long)c->repldbsize);
+    listAddNodeTail(server.replicas, c);
+
+    c->flag.repl_compressed = replicationShouldCompress(c);
+    buflen = snprintf(buf, sizeof(buf), "+RESUMESYNC %s %lld%s\r\n", replid, offset,
+                      c->flag.repl_compressed ? " lzf" : "");
+    if (connWrite(c->conn, buf, buflen) != buflen) {
+        freeClientAsync(c);
+        return C_OK;
+    }
+    /* The backlog is only sent once the rest of the file is transferred,
+     * see replicaStartCommandStream(). */
+    addReplyReplicationBacklog(c, offset + 1);
+    if (connSetWriteHandler(c->conn, sendBulkToReplica) == C_ERR) {
+        freeClientAsync(c);
+        return C_OK;
+    }
+    serverLog(LL_NOTICE, "Resuming the RDB transfer to replica %s at byte %lld of %lld.", replicationGetReplicaName(c),
+              received, (long long)st.st_size);
+    return C_OK;
+}
+
 /* Start a BGSAVE for replication goals, which is, selecting the disk or
  * socket target depending on the configuration, and making sure that
  * the script cache is flushed before to start.
@@ -968,16 +1242,20 @@ int startBgsaveForReplication(int mincapa, int req) {
               socket_target ? "replicas sockets" : "disk",
               (req & REPLICA_REQ_RDB_CHANNEL) ? "dual-channel" : "normal sync");
 
+    /* Save the strings with LZF if any of the replicas can't load LZ4. */
+    int rdbflags = (mincapa & REPLICA_CAPA_LZ4) ? RDBFLAGS_NONE : RDBFLAGS_LZF_ONLY;
+
     rdbSaveInfo rsi, *rsiptr;
     rsiptr = rdbPopulateSaveInfo(&rsi);
     /* Only do rdbSave* when rsiptr is not NULL,
      * otherwise replica will miss repl-stream-db. */
     if (rsiptr) {
         if (socket_target)
-            retval = rdbSaveToReplicasSockets(req, rsiptr);
+            retval = rdbSaveToReplicasSockets(req, rdbflags, rsiptr);
         else {
             /* Keep the page cache since it'll get used soon */
-            retval = rdbSaveBackground(req, server.rdb_filename, rsiptr, RDBFLAGS_REPLICATION | RDBFLAGS_KEEP_CACHE);
+            retval = rdbSaveBackground(req, server.rdb_filename, rsiptr,
+                                       RDBFLAGS_REPLICATION | RDBFLAGS_KEEP_CACHE | rdbflags);
         }
         if (server.debug_pause_after_fork) debugPauseProcess();
     } else {
@@ -1120,6 +1398,10 @@ void syncCommand(client *c) {
              * resync on purpose when they are not able to partially
              * resync. */
             if (primary_replid[0] != '?') server.stat_sync_partial_err++;
+            if (c->argc == 7 && !strcasecmp(c->argv[3]->ptr, "resume") && primaryTryResumeTransfer(c) == C_OK) {
+                server.stat_sync_resume_ok++;
+                return;
+            }
             if (c->replica_capa & REPLICA_CAPA_DUAL_CHANNEL) {
                 dualChannelServerLog(LL_NOTICE,
                                      "Replica %s is capable of dual channel synchronization, and partial sync "
@@ -1219,7 +1501,11 @@ void syncCommand(client *c) {
         } else {
             /* We don't have a BGSAVE in progress, let's start one. Diskless
              * or disk-based mode is determined by replica's capacity. */
-            if (!hasActiveChildProcess()) {
+            if (server.rdb_forkless) {
+                /* The replica is served by replicationCron() once the
+                 * forkless BGSAVE is done. */
+                serverLog(LL_NOTICE, "Forkless BGSAVE in progress. BGSAVE for replication delayed");
+            } else if (!hasActiveChildProcess()) {
                 startBgsaveForReplication(c->replica_capa, c->replica_req);
             } else {
                 serverLog(LL_NOTICE, "No BGSAVE in progress, but another BG operation is active. "
@@ -1249,6 +1535,9 @@ void syncCommand(client *c) {
  * eof: supports EOF-style RDB transfer for diskless replication.
  * psync2: supports PSYNC v2, so understands +CONTINUE <new repl ID>.
  * dual-channel: supports full sync using rdb channel.
+ * lzf: understands the replication stream sent as LZF frames.
+ * lz4: understands LZ4 frames in the replication stream and LZ4 strings in
+ *      the RDB.
  *
  * - ack <offset> [fack <aofofs>]
  * Replica informs the primary the amount of replication stream that it
@@ -1314,7 +1603,10 @@ void replconfCommand(client *c) {
                 /* If dual-channel is disable on this primary, treat this command as unrecognized
                  * replconf option. */
                 c->replica_capa |= REPLICA_CAPA_DUAL_CHANNEL;
-            }
+            } else if (!strcasecmp(c->argv[j + 1]->ptr, "lzf"))
+                c->replica_capa |= REPLICA_CAPA_LZF;
+            else if (!strcasecmp(c->argv[j + 1]->ptr, "lz4"))
+                c->replica_capa |= REPLICA_CAPA_LZ4;
         } else if (!strcasecmp(c->argv[j]->ptr, "ack")) {
             /* REPLCONF ACK is used by replica to inform the primary the amount
              * of replication stream that it processed so far. It is an
@@ -1514,6 +1806,7 @@ void removeRDBUsedToSyncReplicas(void) {
                 serverLog(LL_NOTICE, "Removing the RDB file used to feed replicas "
                                      "in a persistence-less instance");
                 bg_unlink(server.rdb_filename);
+                server.repl_sync_rdb.offset = -1;
             }
         }
     }
@@ -1802,6 +2095,12 @@ void updateReplicasWaitingBgsave(int bgsaveerr, int type) {
                     close(repldbfd);
                     continue;
                 }
+                /* Remember which snapshot the file holds, so that replicas
+                 * whose transfer gets interrupted can resume it later. */
+                memcpy(server.repl_sync_rdb.replid, server.replid, sizeof(server.replid));
+                server.repl_sync_rdb.offset = replica->psync_initial_offset;
+                server.repl_sync_rdb.size = buf.st_size;
+
                 replica->repldbfd = repldbfd;
                 replica->repldboff = 0;
                 replica->repldbsize = buf.st_size;
@@ -1911,6 +2210,7 @@ void replicationCreatePrimaryClientWithHandler(connection *conn, int dbid, Conne
      * connection. */
     server.primary->flag.primary = 1;
     server.primary->flag.authenticated = 1;
+    server.primary->flag.repl_compressed = server.repl_stream_compressed;
 
     /* Allocate a private query buffer for the primary client instead of using the shared query buffer.
      * This is done because the primary's query buffer data needs to be preserved for my sub-replicas to use. */
@@ -1972,6 +2272,14 @@ static int useDisklessLoad(void) {
     return enabled;
 }
 
+/* Interrupted transfers are only resumed when the replica loads the RDB from
+ * a file on disk. With diskless load there is no partial file to continue,
+ * and dual channel replication gets its snapshot from a different channel
+ * that is not covered by the RESUME option of PSYNC. */
+static int replicationCanResumeTransfer(void) {
+    return server.repl_transfer_resume && !server.dual_channel_replication && !useDisklessLoad();
+}
+
 /* Helper function for readSyncBulkPayload() to initialize tempDb
  * before socket-loading the new db from primary. The tempDb may be populated
  * by swapMainDbWithTempDb or freed by disklessLoadDiscardTempDb later. */
@@ -2335,6 +2643,7 @@ void readSyncBulkPayload(connection *conn) {
 
         /* Rename rdb like renaming rewrite aof asynchronously. */
         int old_rdb_fd = open(server.rdb_filename, O_RDONLY | O_NONBLOCK);
+        server.repl_sync_rdb.offset = -1;
         if (rename(server.repl_transfer_tmpfile, server.rdb_filename) == -1) {
             serverLog(LL_WARNING,
                       "Failed trying to rename the temp DB into %s in "
@@ -2628,8 +2937,8 @@ static int dualChannelReplHandleHandshake(connection *conn, sds *err) {
     }
     /* Send replica listening port to primary for clarification */
     sds portstr = getReplicaPortString();
-    *err = sendCommand(conn, "REPLCONF", "capa", "eof", "rdb-only", "1", "rdb-channel", "1", "listening-port", portstr,
-                       NULL);
+    *err = sendCommand(conn, "REPLCONF", "capa", "eof", "capa", "lz4", "rdb-only", "1", "rdb-channel", "1",
+                       "listening-port", portstr, NULL);
     sdsfree(portstr);
     if (*err) {
         dualChannelServerLog(LL_WARNING, "Sending command to primary in dual channel replication handshake: %s", *err);
@@ -3029,6 +3338,8 @@ void dualChannelSyncHandleRdbLoadCompletion(void) {
  * PSYNC_FULLRESYNC: If PSYNC is supported but a full resync is needed.
  *                   In this case the primary replid and global replication
  *                   offset is saved.
+ * PSYNC_RESUME: Like PSYNC_FULLRESYNC, but the primary agreed to send only
+ *               the part of the RDB file server.repl_resume is missing.
  * PSYNC_NOT_SUPPORTED: If the server does not understand PSYNC at all and
  *                      the caller should fall back to SYNC.
  * PSYNC_WRITE_ERROR: There was an error writing the command to the socket.
@@ -3051,9 +3362,11 @@ void dualChannelSyncHandleRdbLoadCompletion(void) {
 #define PSYNC_NOT_SUPPORTED 4
 #define PSYNC_TRY_LATER 5
 #define PSYNC_FULLRESYNC_DUAL_CHANNEL 6
+#define PSYNC_RESUME 7
 int replicaTryPartialResynchronization(connection *conn, int read_reply) {
     char *psync_replid;
     char psync_offset[32];
+    int resume = 0;
     sds reply;
 
     /* Writing half */
@@ -3064,6 +3377,7 @@ int replicaTryPartialResynchronization(connection *conn, int read_reply) {
          * right value, so that this information will be propagated to the
          * client structure representing the primary into server.primary. */
         server.primary_initial_offset = -1;
+        server.repl_stream_compressed = 0;
 
         if (server.repl_rdb_channel_state != REPL_DUAL_CHANNEL_STATE_NONE) {
             /* While in dual channel replication, we should use our prepared repl id and offset. */
@@ -3081,12 +3395,31 @@ int replicaTryPartialResynchronization(connection *conn, int read_reply) {
             psync_replid = "?";
             memcpy(psync_offset, "-1", 3);
         }
+        /* If a full resync is needed, we may still get away with the rest
+         * of an interrupted transfer. */
+        if (server.repl_resume.tmpfile && server.repl_rdb_channel_state == REPL_DUAL_CHANNEL_STATE_NONE) {
+            resume = replicationCanResumeTransfer();
+            if (!resume) {
+                serverLog(LL_NOTICE, "Discarding the interrupted RDB transfer: it can only be resumed by a "
+                                     "disk-based sync.");
+                replicationDiscardResumableTransfer();
+            }
+        }
 
         /* Issue the PSYNC command, if this is a primary with a failover in
          * progress then send the failover argument to the replica to cause it
          * to become a primary */
         if (server.failover_state == FAILOVER_IN_PROGRESS) {
             reply = sendCommand(conn, "PSYNC", psync_replid, psync_offset, "FAILOVER", NULL);
+        } else if (resume) {
+            /* Ask the primary to send only the part of the RDB we miss. */
+            char resume_offset[32], resume_read[32];
+            snprintf(resume_offset, sizeof(resume_offset), "%lld", server.repl_resume.offset);
+            snprintf(resume_read, sizeof(resume_read), "%lld", (long long)server.repl_resume.read);
+            serverLog(LL_NOTICE, "Trying to resume the RDB transfer (request %s:%s, %s bytes received).",
+                      server.repl_resume.replid, resume_offset, resume_read);
+            reply = sendCommand(conn, "PSYNC", psync_replid, psync_offset, "RESUME", server.repl_resume.replid,
+                                resume_offset, resume_read, NULL);
         } else {
             reply = sendCommand(conn, "PSYNC", psync_replid, psync_offset, NULL);
         }
@@ -3118,11 +3451,17 @@ int replicaTryPartialResynchronization(connection *conn, int read_reply) {
 
     connSetReadHandler(conn, NULL);
 
-    if (!strncmp(reply, "+FULLRESYNC", 11)) {
+    /* The primary appends "lzf" to the reply if it will send us the
+     * replication stream compressed. */
+    server.repl_stream_compressed = sdslen(reply) > 4 && !strcmp(reply + sdslen(reply) - 4, " lzf");
+
+    if (!strncmp(reply, "+FULLRESYNC", 11) || !strncmp(reply, "+RESUMESYNC", 11)) {
         char *replid = NULL, *offset = NULL;
 
         /* FULL RESYNC, parse the reply in order to extract the replid
-         * and the replication offset. */
+         * and the replication offset. +RESUMESYNC has the same format, and
+         * echoes the replid and offset of the transfer we asked to resume. */
+        resume = reply[1] == 'R';
         replid = strchr(reply, ' ');
         if (replid) {
             replid++;
@@ -3140,10 +3479,19 @@ int replicaTryPartialResynchronization(connection *conn, int read_reply) {
             memcpy(server.primary_replid, replid, offset - replid - 1);
             server.primary_replid[CONFIG_RUN_ID_SIZE] = '\0';
             server.primary_initial_offset = strtoll(offset, NULL, 10);
-            serverLog(LL_NOTICE, "Full resync from primary: %s:%lld", server.primary_replid,
-                      server.primary_initial_offset);
+            serverLog(LL_NOTICE, "%s from primary: %s:%lld", resume ? "Resumed full resync" : "Full resync",
+                      server.primary_replid, server.primary_initial_offset);
         }
         sdsfree(reply);
+        if (resume) {
+            if (server.repl_resume.tmpfile && server.primary_initial_offset == server.repl_resume.offset &&
+                !strcmp(server.primary_replid, server.repl_resume.replid))
+                return PSYNC_RESUME;
+            /* The primary won't send us the part of the file we miss. */
+            serverLog(LL_WARNING, "Primary resumed a transfer we did not ask for.");
+            replicationDiscardResumableTransfer();
+            return PSYNC_TRY_LATER;
+        }
         return PSYNC_FULLRESYNC;
     }
 
@@ -3163,7 +3511,9 @@ int replicaTryPartialResynchronization(connection *conn, int read_reply) {
          * disconnection. */
         char *start = reply + 10;
         char *end = reply + 9;
-        while (end[0] != '\r' && end[0] != '\n' && end[0] != '\0') end++;
+        /* The ID may be followed by " lzf", see primaryTryPartialResynchronization(). */
+        if (end[0] == ' ') end++;
+        while (end[0] != '\r' && end[0] != '\n' && end[0] != ' ' && end[0] != '\0') end++;
         if (end - start == CONFIG_RUN_ID_SIZE) {
             char new[CONFIG_RUN_ID_SIZE + 1];
             memcpy(new, start, CONFIG_RUN_ID_SIZE);
@@ -3246,6 +3596,7 @@ sds getTryPsyncString(int result) {
     case PSYNC_NOT_SUPPORTED: return sdsnew("PSYNC_NOT_SUPPORTED");
     case PSYNC_TRY_LATER: return sdsnew("PSYNC_TRY_LATER");
     case PSYNC_FULLRESYNC_DUAL_CHANNEL: return sdsnew("PSYNC_FULLRESYNC_DUAL_CHANNEL");
+    case PSYNC_RESUME: return sdsnew("PSYNC_RESUME");
     default: return sdsnew("Unknown result");
     }
 }
@@ -3419,6 +3770,7 @@ void dualChannelSetupMainConnForPsync(connection *conn) {
 void syncWithPrimary(connection *conn) {
     char tmpfile[256], *err = NULL;
     int psync_result;
+    off_t resumed = 0;
 
     /* If this event fired after the user turned the instance into a primary
      * with REPLICAOF NO ONE we must just return ASAP. */
@@ -3513,11 +3865,13 @@ void syncWithPrimary(connection *conn) {
          *
          * EOF: supports EOF-style RDB transfer for diskless replication.
          * PSYNC2: supports PSYNC v2, so understands +CONTINUE <new repl ID>.
+         * LZF: understands the replication stream sent as LZF frames. The
+         * compression is not used together with dual channel replication.
+         * LZ4: understands LZ4 frames and LZ4 strings in the RDB.
          *
          * The primary will ignore capabilities it does not understand. */
-        err = sendCommand(conn, "REPLCONF", "capa", "eof", "capa", "psync2",
-                          server.dual_channel_replication ? "capa" : NULL,
-                          server.dual_channel_replication ? "dual-channel" : NULL, NULL);
+        err = sendCommand(conn, "REPLCONF", "capa", "eof", "capa", "psync2", "capa",
+                          server.dual_channel_replication ? "dual-channel" : "lzf", "capa", "lz4", NULL);
         if (err) goto write_error;
 
         /* Inform the primary of our (replica) version. */
@@ -3662,6 +4016,9 @@ void syncWithPrimary(connection *conn) {
      * primary and so forth. */
     if (psync_result == PSYNC_TRY_LATER) goto error;
 
+    /* Any other outcome means the interrupted transfer won't be resumed. */
+    if (psync_result != PSYNC_RESUME) replicationDiscardResumableTransfer();
+
     /* Note: if PSYNC does not return WAIT_REPLY, it will take care of
      * uninstalling the read handler from the file descriptor. */
 
@@ -3685,8 +4042,24 @@ void syncWithPrimary(connection *conn) {
         }
     }
 
+    /* Reopen the partially received file, the primary sends the rest. */
+    if (psync_result == PSYNC_RESUME) {
+        int dfd = open(server.repl_resume.tmpfile, O_WRONLY);
+        if (dfd == -1 || ftruncate(dfd, server.repl_resume.read) == -1 || lseek(dfd, 0, SEEK_END) == -1) {
+            serverLog(LL_WARNING, "Reopening the temp file needed to resume PRIMARY <-> REPLICA synchronization: %s",
+                      strerror(errno));
+            if (dfd != -1) close(dfd);
+            replicationDiscardResumableTransfer();
+            goto error;
+        }
+        server.repl_transfer_tmpfile = server.repl_resume.tmpfile;
+        server.repl_transfer_fd = dfd;
+        server.repl_resume.tmpfile = NULL;
+        resumed = server.repl_resume.read;
+    }
+
     /* Prepare a suitable temp file for bulk transfer */
-    if (!useDisklessLoad()) {
+    if (!useDisklessLoad() && psync_result != PSYNC_RESUME) {
         int dfd = -1, maxtries = 5;
         while (maxtries--) {
             snprintf(tmpfile, 256, "temp-%d.%ld.rdb", (int)server.unixtime, (long int)getpid());
@@ -3738,8 +4111,8 @@ void syncWithPrimary(connection *conn) {
 
     server.repl_state = REPL_STATE_TRANSFER;
     server.repl_transfer_size = -1;
-    server.repl_transfer_read = 0;
-    server.repl_transfer_last_fsync_off = 0;
+    server.repl_transfer_read = resumed;
+    server.repl_transfer_last_fsync_off = resumed;
     server.repl_transfer_lastio = server.unixtime;
     return;
 
@@ -3801,13 +4174,35 @@ void replicationAbortSyncTransfer(void) {
     undoConnectWithPrimary();
     if (server.repl_transfer_fd != -1) {
         close(server.repl_transfer_fd);
-        bg_unlink(server.repl_transfer_tmpfile);
-        zfree(server.repl_transfer_tmpfile);
+        /* Only transfers of a known size, started by +FULLRESYNC, can be
+         * resumed: streamed RDBs are produced on the fly by the primary. */
+        if (replicationCanResumeTransfer() && server.primary_initial_offset != -1 && server.repl_transfer_read > 0 &&
+            server.repl_transfer_read < server.repl_transfer_size) {
+            replicationDiscardResumableTransfer();
+            server.repl_resume.tmpfile = server.repl_transfer_tmpfile;
+            memcpy(server.repl_resume.replid, server.primary_replid, sizeof(server.primary_replid));
+            server.repl_resume.offset = server.primary_initial_offset;
+            server.repl_resume.read = server.repl_transfer_read;
+            serverLog(LL_NOTICE, "Keeping the %lld bytes of RDB received so far to resume the transfer.",
+                      (long long)server.repl_transfer_read);
+        } else {
+            bg_unlink(server.repl_transfer_tmpfile);
+            zfree(server.repl_transfer_tmpfile);
+        }
         server.repl_transfer_tmpfile = NULL;
         server.repl_transfer_fd = -1;
     }
 }
 
+/* Remove the partially received RDB file kept by replicationAbortSyncTransfer()
+ * once we know the transfer can't be resumed anymore. */
+void replicationDiscardResumableTransfer(void) {
+    if (!server.repl_resume.tmpfile) return;
+    bg_unlink(server.repl_resume.tmpfile);
+    zfree(server.repl_resume.tmpfile);
+    server.repl_resume.tmpfile = NULL;
+}
+
 /* This function aborts a non blocking replication attempt if there is one
  * in progress, by canceling the non-blocking connect attempt or
  * the initial bulk transfer.
@@ -3911,6 +4306,7 @@ void replicationUnsetPrimary(void) {
     if (server.primary) freeClient(server.primary);
     replicationDiscardCachedPrimary();
     cancelReplicationHandshake(0);
+    replicationDiscardResumableTransfer();
     /* When a replica is turned into a primary, the current replication ID
      * (that was inherited from the primary at synchronization time) is
      * used as secondary ID up to the current offset, and a new replication
@@ -4147,6 +4543,8 @@ void replicationCachePrimary(client *c) {
     server.primary->qb_pos = 0;
     server.primary->repl_applied = 0;
     server.primary->read_reploff = server.primary->reploff;
+    sdsfree(c->repl_frame);
+    c->repl_frame = NULL;
     if (c->flag.multi) discardTransaction(c);
     listEmpty(c->reply);
     c->sentlen = 0;
@@ -4246,6 +4644,7 @@ void replicationResurrectCachedPrimary(connection *conn) {
     server.primary = server.cached_primary;
     server.cached_primary = NULL;
     server.primary->conn = conn;
+    server.primary->flag.repl_compressed = server.repl_stream_compressed;
 
     establishPrimaryConnection();
     /* Re-add to the list of clients. */
@@ -4772,7 +5171,7 @@ int shouldStartChildReplication(int *mincapa_out, int *req_out) {
      * In case of diskless replication, we make sure to wait the specified
      * number of seconds (according to configuration) so that other replicas
      * have the time to arrive before we start streaming. */
-    if (!hasActiveChildProcess()) {
+    if (!hasActiveChildProcess() && !server.rdb_forkless) {
         time_t idle, max_idle = 0;
         int replicas_waiting = 0;
         int mincapa;
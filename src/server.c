@@ -599,6 +599,44 @@ dictType hashDictType = {
     NULL,              /* allow to expand */
 };
 
+/* Hash type hash table whose field names are embedded in the dict entries,
+ * saving an allocation and a pointer per field, see hashTypeCreateDict(). */
+dictType hashEmbeddedDictType = {
+    dictSdsHash,       /* hash function */
+    NULL,              /* key dup */
+    dictSdsKeyCompare, /* key compare */
+    NULL,              /* key is embedded in the dictEntry and freed internally */
+    dictSdsDestructor, /* val destructor */
+    NULL,              /* allow to expand */
+    .embedKey = dictSdsEmbedKey,
+    .embedded_entry = 1,
+};
+
+static void dictHashFieldDestructor(void *val) {
+    hashFieldRelease(val);
+}
+
+/* Hash type hash table whose field names may be shared with other hashes
+ * through server.hash_interned_fields, see hashTypeCreateDict(). */
+dictType hashInternedDictType = {
+    dictSdsHash,             /* hash function */
+    NULL,                    /* key dup */
+    dictSdsKeyCompare,       /* key compare */
+    dictHashFieldDestructor, /* key destructor */
+    dictSdsDestructor,       /* val destructor */
+    NULL,                    /* allow to expand */
+};
+
+/* Interned hash field names, the value is the number of references. */
+dictType hashInternedFieldsDictType = {
+    dictSdsHash,       /* hash function */
+    NULL,              /* key dup */
+    dictSdsKeyCompare, /* key compare */
+    dictSdsDestructor, /* key destructor */
+    NULL,              /* val destructor */
+    NULL               /* allow to expand */
+};
+
 /* Dict type without destructor */
 dictType sdsReplyDictType = {
     dictSdsHash,       /* hash function */
@@ -1463,7 +1501,7 @@ long long serverCron(struct aeEventLoop *eventLoop, long long id, void *clientDa
     } else {
         /* If there is not a background saving/rewrite in progress check if
          * we have to save/rewrite now. */
-        for (j = 0; j < server.saveparamslen; j++) {
+        for (j = 0; j < server.saveparamslen && !server.rdb_forkless; j++) {
             struct saveparam *sp = server.saveparams + j;
 
             /* Save if we reached the given amount of changes,
@@ -1486,7 +1524,7 @@ long long serverCron(struct aeEventLoop *eventLoop, long long id, void *clientDa
             server.aof_current_size > server.aof_rewrite_min_size) {
             long long base = server.aof_rewrite_base_size ? server.aof_rewrite_base_size : 1;
             long long growth = (server.aof_current_size * 100 / base) - 100;
-            if (growth >= server.aof_rewrite_perc && !aofRewriteLimited()) {
+            if (growth >= server.aof_rewrite_perc && !aofRewriteLimited() && aofCompactIncrFiles() != C_OK) {
                 serverLog(LL_NOTICE, "Starting automatic rewriting of AOF on %lld%% growth", growth);
                 rewriteAppendOnlyFileBackground();
             }
@@ -2120,6 +2158,9 @@ void initServerConfig(void) {
     server.aof_flush_postponed_start = 0;
     server.aof_last_incr_size = 0;
     server.aof_last_incr_fsync_offset = 0;
+    server.aof_compaction_keys = NULL;
+    server.aof_compaction_keys_count = 0;
+    server.aof_compaction_start_seq = 0;
     server.active_defrag_running = 0;
     server.active_defrag_configuration_changed = 0;
     server.notify_keyspace_events = 0;
@@ -2161,6 +2202,9 @@ void initServerConfig(void) {
     server.repl_transfer_tmpfile = NULL;
     server.repl_transfer_fd = -1;
     server.repl_transfer_s = NULL;
+    server.repl_resume.tmpfile = NULL;
+    server.repl_stream_compressed = 0;
+    server.repl_sync_rdb.offset = -1;
     server.repl_syncio_timeout = CONFIG_REPL_SYNCIO_TIMEOUT;
     server.repl_down_since = 0; /* Never connected, repl is down since EVER. */
     server.primary_repl_offset = 0;
@@ -2590,6 +2634,7 @@ void resetServerStats(void) {
     server.stat_sync_full = 0;
     server.stat_sync_partial_ok = 0;
     server.stat_sync_partial_err = 0;
+    server.stat_sync_resume_ok = 0;
     server.stat_io_reads_processed = 0;
     server.stat_total_reads_processed = 0;
     server.stat_io_writes_processed = 0;
@@ -2605,6 +2650,7 @@ void resetServerStats(void) {
         memset(server.inst_metric[j].samples, 0, sizeof(server.inst_metric[j].samples));
     }
     server.stat_aof_rewrites = 0;
+    server.stat_aof_compactions = 0;
     server.stat_rdb_saves = 0;
     server.stat_aofrw_consecutive_failures = 0;
     server.stat_net_input_bytes = 0;
@@ -2647,6 +2693,7 @@ void initServer(void) {
     server.aof_state = server.aof_enabled ? AOF_ON : AOF_OFF;
     server.fsynced_reploff = server.aof_enabled ? 0 : -1;
     server.hz = server.config_hz;
+    quicklistSetCompressionCodec(server.list_compression_codec);
     server.in_fork_child = CHILD_TYPE_NONE;
     server.rdb_pipe_read = -1;
     server.rdb_child_exit_pipe = -1;
@@ -2663,6 +2710,7 @@ void initServer(void) {
     server.wait_before_rdb_client_free = DEFAULT_WAIT_BEFORE_RDB_CLIENT_FREE;
     server.clients_pending_write = listCreate();
     server.clients_pending_io_write = listCreate();
+    server.reply_generators = listCreate();
     server.clients_pending_io_read = listCreate();
     server.clients_timeout_table = raxNew();
     server.replication_allowed = 1;
@@ -2731,6 +2779,7 @@ void initServer(void) {
      * (which has to be kvstore), see pubsubtype.serverPubSubChannels */
     server.pubsub_channels = kvstoreCreate(&kvstoreChannelDictType, 0, KVSTORE_ALLOCATE_DICTS_ON_DEMAND);
     server.pubsub_patterns = dictCreate(&objToDictDictType);
+    server.hash_interned_fields = dictCreate(&hashInternedFieldsDictType);
     server.pubsubshard_channels = kvstoreCreate(&kvstoreChannelDictType, slot_count_bits,
                                                 KVSTORE_ALLOCATE_DICTS_ON_DEMAND | KVSTORE_FREE_EMPTY_DICTS);
     server.pubsub_clients = 0;
@@ -2743,6 +2792,7 @@ void initServer(void) {
     server.child_pid = -1;
     server.child_type = CHILD_TYPE_NONE;
     server.rdb_child_type = RDB_CHILD_TYPE_NONE;
+    server.rdb_forkless = NULL;
     server.rdb_pipe_conns = NULL;
     server.rdb_pipe_numconns = 0;
     server.rdb_pipe_numconns_writing = 0;
@@ -3340,8 +3390,27 @@ static void propagateNow(int dbid, robj **argv, int argc, int target) {
     serverAssert(!isPausedActions(PAUSE_ACTION_REPLICA) || server.client_pause_in_transaction ||
                  server.server_del_keys_in_slot);
 
-    if (server.aof_state != AOF_OFF && target & PROPAGATE_AOF) feedAppendOnlyFile(dbid, argv, argc);
-    if (target & PROPAGATE_REPL) replicationFeedReplicas(dbid, argv, argc);
+    if (server.aof_state == AOF_OFF || !(target & PROPAGATE_AOF)) {
+        if (target & PROPAGATE_REPL) replicationFeedReplicas(dbid, argv, argc);
+        return;
+    }
+
+    /* The AOF and the replication stream use the same RESP encoding of the
+     * command, so produce it once for both, in a buffer reused across calls. */
+    static sds cmd = NULL;
+    if (cmd == NULL) cmd = sdsempty();
+    cmd = catAppendOnlyGenericCommand(cmd, argc, argv);
+    aofTrackCompactionKeys(dbid, argv, argc);
+    feedAppendOnlyFile(dbid, cmd, sdslen(cmd));
+    if (target & PROPAGATE_REPL) replicationFeedReplicasEncoded(dbid, cmd, sdslen(cmd));
+
+    /* Don't hold on to the memory of a huge command. */
+    if (sdsalloc(cmd) > PROTO_IOBUF_LEN) {
+        sdsfree(cmd);
+        cmd = NULL;
+    } else {
+        sdsclear(cmd);
+    }
 }
 
 /* Used inside commands to schedule the propagation of additional commands
@@ -4437,6 +4506,7 @@ int finishShutdown(void) {
          * but OS will close this fd when process exits. */
         rdbRemoveTempFile(server.child_pid, 0);
     }
+    rdbForklessSaveAbort();
 
     /* Kill module child if there is one. */
     if (server.child_type == CHILD_TYPE_MODULE) {
@@ -5703,6 +5773,7 @@ sds genValkeyInfoString(dict *section_dict, int all_sections, int everything) {
                 "mem_cluster_links:%zu\r\n", mh->cluster_links,
                 "mem_aof_buffer:%zu\r\n", mh->aof_buffer,
                 "mem_allocator:%s\r\n", ZMALLOC_LIB,
+                "mem_hash_interned_fields:%lu\r\n", hashInternedFieldsCount(),
                 "mem_overhead_db_hashtable_rehashing:%zu\r\n", mh->overhead_db_hashtable_rehashing,
                 "active_defrag_running:%d\r\n", server.active_defrag_running,
                 "lazyfree_pending_objects:%zu\r\n", lazyfreeGetPendingObjectsCount(),
@@ -5733,11 +5804,11 @@ sds genValkeyInfoString(dict *section_dict, int all_sections, int everything) {
                 "current_save_keys_processed:%zu\r\n", server.stat_current_save_keys_processed,
                 "current_save_keys_total:%zu\r\n", server.stat_current_save_keys_total,
                 "rdb_changes_since_last_save:%lld\r\n", server.dirty,
-                "rdb_bgsave_in_progress:%d\r\n", server.child_type == CHILD_TYPE_RDB,
+                "rdb_bgsave_in_progress:%d\r\n", server.child_type == CHILD_TYPE_RDB || server.rdb_forkless,
                 "rdb_last_save_time:%jd\r\n", (intmax_t)server.lastsave,
                 "rdb_last_bgsave_status:%s\r\n", (server.lastbgsave_status == C_OK) ? "ok" : "err",
                 "rdb_last_bgsave_time_sec:%jd\r\n", (intmax_t)server.rdb_save_time_last,
-                "rdb_current_bgsave_time_sec:%jd\r\n", (intmax_t)((server.child_type != CHILD_TYPE_RDB) ? -1 : time(NULL) - server.rdb_save_time_start),
+                "rdb_current_bgsave_time_sec:%jd\r\n", (intmax_t)((server.child_type != CHILD_TYPE_RDB && !server.rdb_forkless) ? -1 : time(NULL) - server.rdb_save_time_start),
                 "rdb_saves:%lld\r\n", server.stat_rdb_saves,
                 "rdb_last_cow_size:%zu\r\n", server.stat_rdb_cow_bytes,
                 "rdb_last_load_keys_expired:%lld\r\n", server.rdb_last_load_keys_expired,
@@ -5749,6 +5820,7 @@ sds genValkeyInfoString(dict *section_dict, int all_sections, int everything) {
                 "aof_current_rewrite_time_sec:%jd\r\n", (intmax_t)((server.child_type != CHILD_TYPE_AOF) ? -1 : time(NULL) - server.aof_rewrite_time_start),
                 "aof_last_bgrewrite_status:%s\r\n", (server.aof_lastbgrewrite_status == C_OK ? "ok" : "err"),
                 "aof_rewrites:%lld\r\n", server.stat_aof_rewrites,
+                "aof_compactions:%lld\r\n", server.stat_aof_compactions,
                 "aof_rewrites_consecutive_failures:%lld\r\n", server.stat_aofrw_consecutive_failures,
                 "aof_last_write_status:%s\r\n", (server.aof_last_write_status == C_OK && aof_bio_fsync_status == C_OK) ? "ok" : "err",
                 "aof_last_cow_size:%zu\r\n", server.stat_aof_cow_bytes,
@@ -5829,6 +5901,7 @@ sds genValkeyInfoString(dict *section_dict, int all_sections, int everything) {
                 "sync_full:%lld\r\n", server.stat_sync_full,
                 "sync_partial_ok:%lld\r\n", server.stat_sync_partial_ok,
                 "sync_partial_err:%lld\r\n", server.stat_sync_partial_err,
+                "sync_resume_ok:%lld\r\n", server.stat_sync_resume_ok,
                 "expired_keys:%lld\r\n", server.stat_expiredkeys,
                 "expired_stale_perc:%.2f\r\n", server.stat_expired_stale_perc * 100,
                 "expired_time_cap_reached_count:%lld\r\n", server.stat_expired_time_cap_reached_count,
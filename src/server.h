@@ -81,6 +81,7 @@ typedef long long ustime_t; /* microsecond time type. */
 #include "rax.h"        /* Radix tree */
 #include "connection.h" /* Connection abstraction */
 #include "memory_prefetch.h"
+#include "compression.h" /* Codecs for RDB strings, list nodes and replication */
 
 #define VALKEYMODULE_CORE 1
 typedef struct serverObject robj;
@@ -433,6 +434,8 @@ typedef enum {
 #define REPLICA_CAPA_EOF (1 << 0)          /* Can parse the RDB EOF streaming format. */
 #define REPLICA_CAPA_PSYNC2 (1 << 1)       /* Supports PSYNC2 protocol. */
 #define REPLICA_CAPA_DUAL_CHANNEL (1 << 2) /* Supports dual channel replication sync */
+#define REPLICA_CAPA_LZF (1 << 3)          /* Can read a replication stream made of LZF frames. */
+#define REPLICA_CAPA_LZ4 (1 << 4)          /* Can read LZ4 frames and LZ4 strings in the RDB. */
 
 /* Replica requirements */
 #define REPLICA_REQ_NONE 0
@@ -713,6 +716,7 @@ struct moduleLoadQueueEntry;
 struct ValkeyModuleKeyOptCtx;
 struct ValkeyModuleCommand;
 struct clusterState;
+struct rdbForklessSave;
 
 /* Each module type implementation should export a set of methods in order
  * to serialize and deserialize the value in the RDB file, rewrite the AOF
@@ -943,6 +947,7 @@ typedef struct replBufBlock {
     long long id;          /* The unique incremental number. */
     long long repl_offset; /* Start replication offset of the block. */
     size_t size, used;
+    sds frame; /* Cached compressed frame of the whole block, or NULL. */
     char buf[];
 } replBufBlock;
 
@@ -1236,7 +1241,8 @@ typedef struct ClientFlags {
                                             * flag, we won't cache the primary in freeClient. */
     uint64_t fake : 1;                     /* This is a fake client without a real connection. */
     uint64_t import_source : 1;            /* This client is importing data to server and can visit expired key. */
-    uint64_t reserved : 4;                 /* Reserved for future use */
+    uint64_t repl_compressed : 1;          /* The replication stream to/from this client is made of LZF frames. */
+    uint64_t reserved : 3;                 /* Reserved for future use */
 } ClientFlags;
 
 typedef struct client {
@@ -1273,6 +1279,7 @@ typedef struct client {
                                            Used to update error stats in case the c->cmd was modified
                                            during the command invocation (like on GEOADD for example). */
     struct serverCommand *io_parsed_cmd; /* The command that was parsed by the IO thread. */
+    uint64_t io_key_hash;                /* Hash of the first key of io_parsed_cmd, if any. */
     user *user;                          /* User associated with this connection. If the
                                             user is set to NULL the connection can do
                                             anything (admin). */
@@ -1364,6 +1371,10 @@ typedef struct client {
                                   * see the definition of replBufBlock. */
     size_t ref_block_pos;        /* Access position of referenced buffer block,
                                   * i.e. the next offset to send. */
+    sds repl_frame;              /* Compressed replication stream: frame being sent
+                                  * to a replica, or partial frame read from the primary. */
+    size_t repl_frame_pos;       /* Bytes of repl_frame already sent to the replica. */
+    struct replyGenerator *reply_gen; /* Incremental reply in progress, or NULL. */
 
     /* list node in clients_pending_write or in clients_pending_io_write list */
     listNode clients_pending_write_node;
@@ -1393,6 +1404,25 @@ typedef struct client {
  * prepareClientForFutureWrites(client *c). */
 typedef struct writePreparedClient writePreparedClient;
 
+/* A large reply that is emitted incrementally, as the client output buffers
+ * drain, instead of all at once. See addReplyGenerator() for the details. */
+typedef struct replyGenerator replyGenerator;
+
+/* Emits up to 'count' more elements of the reply. Returns 1 once the last
+ * element was emitted, 0 otherwise. */
+typedef int replyGeneratorProc(client *c, replyGenerator *gen, long count);
+
+struct replyGenerator {
+    client *client;          /* The client receiving the reply. */
+    serverDb *db;            /* DB and name of the key the reply is read from. */
+    sds key;
+    robj *obj;               /* Value of the key. */
+    replyGeneratorProc *proc;
+    void *state;             /* Position of 'proc' in the value. */
+    void (*free_state)(void *state);
+    listNode *node;          /* Node in server.reply_generators. */
+};
+
 /* ACL information */
 typedef struct aclInfo {
     long long user_auth_failures;       /* Auth failure counts on user level */
@@ -1745,6 +1775,7 @@ struct valkeyServer {
     list *clients_pending_write;           /* There is to write or install handler. */
     list *clients_pending_io_read;         /* List of clients with pending read to be process by I/O threads. */
     list *clients_pending_io_write;        /* List of clients with pending write to be process by I/O threads. */
+    list *reply_generators;                /* Incremental replies in progress. */
     list *replicas, *monitors;             /* List of replicas and MONITORs */
     rax *replicas_waiting_psync;           /* Radix tree for tracking replicas awaiting partial synchronization.
                                             * Key: RDB client ID
@@ -1779,6 +1810,7 @@ struct valkeyServer {
     int active_io_threads_num;                /* Current number of active IO threads, includes main thread. */
     int events_per_io_thread;                 /* Number of events on the event loop to trigger IO threads activation. */
     int prefetch_batch_max_size;              /* Maximum number of keys to prefetch in a single batch */
+    unsigned long incremental_reply_min_elements; /* Replies at least this long are emitted incrementally. */
     long long events_processed_while_blocked; /* processEventsWhileBlocked() */
     int enable_protected_configs;             /* Enable the modification of protected configs, see PROTECTED_ACTION_ALLOWED_* */
     int enable_debug_cmd;                     /* Enable DEBUG commands, see PROTECTED_ACTION_ALLOWED_* */
@@ -1818,6 +1850,7 @@ struct valkeyServer {
     monotime stat_last_active_defrag_time;         /* Timestamp of current active defrag start */
     size_t stat_peak_memory;                       /* Max used memory record */
     long long stat_aof_rewrites;                   /* number of aof file rewrites performed */
+    long long stat_aof_compactions;                /* number of in place INCR AOF compactions */
     long long stat_aofrw_consecutive_failures;     /* The number of consecutive failures of aofrw */
     long long stat_rdb_saves;                      /* number of rdb saves performed */
     long long stat_fork_time;                      /* Time needed to perform latest fork() */
@@ -1827,6 +1860,7 @@ struct valkeyServer {
     long long stat_sync_full;                      /* Number of full resyncs with replicas. */
     long long stat_sync_partial_ok;                /* Number of accepted PSYNC requests. */
     long long stat_sync_partial_err;               /* Number of unaccepted PSYNC requests. */
+    long long stat_sync_resume_ok;                 /* Number of resumed RDB transfers. */
     list *slowlog;                                 /* SLOWLOG list of commands */
     long long slowlog_entry_id;                    /* SLOWLOG current entry ID */
     long long slowlog_log_slower_than;             /* SLOWLOG time limit (to get logged) */
@@ -1960,6 +1994,13 @@ struct valkeyServer {
     aofManifest *aof_manifest;          /* Used to track AOFs. */
     int aof_disable_auto_gc;            /* If disable automatically deleting HISTORY type AOFs?
                                            default no. (for testings). */
+    int aof_compaction_max_keys;        /* Compact INCR AOFs in place when at most this many
+                                           keys were written since the BASE. 0 to disable. */
+    long long aof_compaction_max_bytes; /* Give up a compaction that writes more than this. */
+    dict **aof_compaction_keys;         /* Per DB set of keys written in the INCR AOFs. */
+    unsigned long aof_compaction_keys_count; /* Number of keys in 'aof_compaction_keys'. */
+    long long aof_compaction_start_seq; /* Tracked keys cover every INCR AOF from this seq on,
+                                           0 if they can't be trusted until the next rewrite. */
 
     /* RDB persistence */
     long long dirty;                      /* Changes to DB from the last save */
@@ -1970,7 +2011,9 @@ struct valkeyServer {
     int saveparamslen;                    /* Number of saving points */
     char *rdb_filename;                   /* Name of RDB file */
     int rdb_compression;                  /* Use compression in RDB? */
+    int rdb_compression_codec;            /* COMPRESSION_CODEC_* used for RDB strings. */
     int rdb_checksum;                     /* Use RDB checksum? */
+    int rdb_slot_index;                   /* Save an index of the slot sections in RDB files? */
     int rdb_del_sync_files;               /* Remove RDB files used only for SYNC if
                                              the instance does not use persistence. */
     time_t lastsave;                      /* Unix time of last successful save */
@@ -1979,6 +2022,8 @@ struct valkeyServer {
     time_t rdb_save_time_start;           /* Current RDB save start time. */
     int rdb_bgsave_scheduled;             /* BGSAVE when possible if true. */
     int rdb_child_type;                   /* Type of save by active child. */
+    int bgsave_forkless;                  /* BGSAVE from the main thread, without fork. */
+    struct rdbForklessSave *rdb_forkless; /* Forkless BGSAVE in progress, or NULL. */
     int lastbgsave_status;                /* C_OK or C_ERR */
     int stop_writes_on_bgsave_err;        /* Don't allow writes if can't BGSAVE */
     int rdb_pipe_read;                    /* RDB pipe used to transfer the rdb data */
@@ -2043,6 +2088,8 @@ struct valkeyServer {
     int repl_min_replicas_max_lag;             /* Max lag of <count> replicas to write. */
     int repl_good_replicas_count;              /* Number of replicas with lag <= max_lag. */
     int repl_diskless_sync;                    /* Primary send RDB to replicas sockets directly. */
+    int repl_compression;                      /* Send the replication stream to replicas in compressed frames. */
+    int repl_compression_codec;                /* COMPRESSION_CODEC_* for replicas that support it. */
     int repl_diskless_load;                    /* Replica parse RDB directly from the socket.
                                                 * see REPL_DISKLESS_LOAD_* enum */
     int repl_diskless_sync_delay;              /* Delay to start a diskless repl BGSAVE. */
@@ -2054,6 +2101,11 @@ struct valkeyServer {
                                                 * to establish psync. */
     int debug_pause_after_fork;                /* Debug param that pauses the main process
                                                 * after a replication fork() (for bgsave). */
+    struct {
+        char replid[CONFIG_RUN_ID_SIZE + 1];
+        long long offset; /* -1 when the RDB file on disk can't be resumed. */
+        off_t size;
+    } repl_sync_rdb;                           /* Snapshot on disk last sent to replicas. */
     size_t repl_buffer_mem;                    /* The memory of replication buffer. */
     list *repl_buffer_blocks;                  /* Replication buffers blocks list
                                                 * (serving replica clients and repl backlog) */
@@ -2084,6 +2136,14 @@ struct valkeyServer {
     int repl_transfer_fd;               /* Replica -> Primary SYNC temp file descriptor */
     char *repl_transfer_tmpfile;        /* Replica-> Primary SYNC temp file name */
     time_t repl_transfer_lastio;        /* Unix time of the latest read, for timeout */
+    int repl_transfer_resume;           /* Keep interrupted RDB transfers to resume them. */
+    int repl_stream_compressed;         /* The primary agreed to send us LZF frames. */
+    struct {
+        char *tmpfile; /* NULL if there is no transfer to resume. */
+        char replid[CONFIG_RUN_ID_SIZE + 1];
+        long long offset;
+        off_t read;
+    } repl_resume;                      /* Interrupted RDB transfer from the primary. */
     int repl_serve_stale_data;          /* Serve stale data when link is down? */
     int repl_replica_ro;                /* Replica is read only? */
     int repl_replica_ignore_maxmemory;  /* If true replicas do not evict. */
@@ -2140,6 +2200,8 @@ struct valkeyServer {
     /* Zip structure config, see redis.conf for more information  */
     size_t hash_max_listpack_entries;
     size_t hash_max_listpack_value;
+    int hash_intern_fields;     /* Share field names across dict encoded hashes */
+    dict *hash_interned_fields; /* Interned hash field name -> reference count */
     size_t set_max_intset_entries;
     size_t set_max_listpack_entries;
     size_t set_max_listpack_value;
@@ -2151,6 +2213,7 @@ struct valkeyServer {
     /* List parameters */
     int list_max_listpack_size;
     int list_compress_depth;
+    int list_compression_codec;
     /* time cache */
     time_t unixtime;             /* Unix time sampled every cron cycle. */
     time_t timezone;             /* Cached timezone. As set by tzset(). */
@@ -2666,6 +2729,9 @@ extern dictType kvstoreKeysDictType;
 extern dictType kvstoreExpiresDictType;
 extern double R_Zero, R_PosInf, R_NegInf, R_Nan;
 extern dictType hashDictType;
+extern dictType hashInternedDictType;
+extern dictType hashEmbeddedDictType;
+extern dictType hashInternedFieldsDictType;
 extern dictType stringSetDictType;
 extern dictType externalStringType;
 extern dictType sdsHashDictType;
@@ -2852,12 +2918,19 @@ void addWritePreparedReplyMapLen(writePreparedClient *c, long length);
 void addReplySetLen(client *c, long length);
 void addReplyAttributeLen(client *c, long length);
 void addReplyPushLen(client *c, long length);
+int replyGeneratorAllowed(client *c, long count);
+void addReplyGenerator(client *c, robj *key, robj *obj, replyGeneratorProc *proc, void *state, void (*free_state)(void *));
+void releaseReplyGenerator(client *c);
+void continueReplyGenerator(client *c);
+void replyGeneratorsKeyWillChange(serverDb *db, sds key);
+void drainAllReplyGenerators(void);
+int keyHasReplyGenerator(serverDb *db, sds key);
 void addReplyHelp(client *c, const char **help);
 void addExtendedReplyHelp(client *c, const char **help, const char **extended_help);
 void addReplySubcommandSyntaxError(client *c);
 void addReplyLoadedModules(client *c);
 void copyReplicaOutputBuffer(client *dst, client *src);
-void addListRangeReply(client *c, robj *o, long start, long end, int reverse);
+void addListRangeReply(client *c, robj *key, robj *o, long start, long end, int reverse);
 void deferredAfterErrorReply(client *c, list *errors);
 size_t getStringObjectSdsUsedMemory(robj *o);
 void freeClientReplyValue(void *o);
@@ -2912,6 +2985,7 @@ int authRequired(client *c);
 void putClientInPendingWriteQueue(client *c);
 client *createCachedResponseClient(int resp);
 void deleteCachedResponseClient(client *recording_client);
+sds aggregateClientOutputBuffer(client *c);
 void waitForClientIO(client *c);
 void ioThreadReadQueryFromClient(void *data);
 void ioThreadWriteToClient(void *data);
@@ -3018,6 +3092,8 @@ robj *tryObjectEncoding(robj *o);
 robj *tryObjectEncodingEx(robj *o, int try_trim);
 robj *getDecodedObject(robj *o);
 size_t stringObjectLen(robj *o);
+#define OBJ_COMPUTE_SIZE_DEF_SAMPLES 5 /* Default sample size. */
+size_t objectComputeSize(robj *key, robj *o, size_t sample_size, int dbid);
 robj *createStringObjectFromLongLong(long long value);
 robj *createStringObjectFromLongLongForValue(long long value);
 robj *createStringObjectFromLongLongWithSds(long long value);
@@ -3061,10 +3137,13 @@ ssize_t syncReadLine(int fd, char *ptr, ssize_t size, long long timeout);
 
 /* Replication */
 void replicationFeedReplicas(int dictid, robj **argv, int argc);
+void replicationFeedReplicasEncoded(int dictid, const char *cmd, size_t len);
 void replicationFeedStreamFromPrimaryStream(char *buf, size_t buflen);
 void resetReplicationBuffer(void);
 void feedReplicationBuffer(char *buf, size_t len);
 void freeReplicaReferencedReplBuffer(client *replica);
+sds replicationNextFrame(client *replica);
+long long replicationInflateQueryBuf(client *c);
 void replicationFeedMonitors(client *c, list *monitors, int dictid, robj **argv, int argc);
 void updateReplicasWaitingBgsave(int bgsaveerr, int type);
 void replicationCron(void);
@@ -3129,9 +3208,13 @@ int bg_unlink(const char *filename);
 
 /* AOF persistence */
 void flushAppendOnlyFile(int force);
-void feedAppendOnlyFile(int dictid, robj **argv, int argc);
+sds catAppendOnlyGenericCommand(sds dst, int argc, robj **argv);
+void feedAppendOnlyFile(int dictid, const char *cmd, size_t len);
 void aofRemoveTempFile(pid_t childpid);
 int rewriteAppendOnlyFileBackground(void);
+void aofTrackCompactionKeys(int dictid, robj **argv, int argc);
+void aofResetCompactionKeys(long long start_seq);
+int aofCompactIncrFiles(void);
 int loadAppendOnlyFiles(aofManifest *am);
 void stopAppendOnly(void);
 int startAppendOnly(void);
@@ -3254,6 +3337,7 @@ typedef struct {
 zskiplist *zslCreate(void);
 void zslFree(zskiplist *zsl);
 zskiplistNode *zslInsert(zskiplist *zsl, double score, sds ele);
+zskiplistNode *zslInsertTail(zskiplist *zsl, zskiplistNode **tail, double score, sds ele);
 unsigned char *zzlInsert(unsigned char *zl, sds ele, double score);
 int zslDelete(zskiplist *zsl, double score, sds ele, zskiplistNode **node);
 zskiplistNode *zslNthInRange(zskiplist *zsl, zrangespec *range, long n);
@@ -3407,6 +3491,10 @@ robj *setTypeDup(robj *o);
 #define HASH_SET_COPY 0
 
 void hashTypeConvert(robj *o, int enc);
+dict *hashTypeCreateDict(void);
+int hashTypeDictAdd(dict *d, sds field, sds value);
+void hashFieldRelease(sds field);
+unsigned long hashInternedFieldsCount(void);
 void hashTypeTryConversion(robj *subject, robj **argv, int start, int end);
 int hashTypeExists(robj *o, sds key);
 int hashTypeDelete(robj *o, sds key);
@@ -3548,6 +3636,7 @@ robj *lookupKeyReadOrReply(client *c, robj *key, robj *reply);
 robj *lookupKeyWriteOrReply(client *c, robj *key, robj *reply);
 robj *lookupKeyReadWithFlags(serverDb *db, robj *key, int flags);
 robj *lookupKeyWriteWithFlags(serverDb *db, robj *key, int flags);
+void dbKeyWillChange(serverDb *db, robj *key);
 robj *objectCommandLookup(client *c, robj *key);
 robj *objectCommandLookupOrReply(client *c, robj *key, robj *reply);
 int objectSetLRUOrLFU(robj *val, long long lfu_freq, long long lru_idle, long long lru_clock, int lru_multiplier);
@@ -50,6 +50,74 @@ static int isReturnSubstPattern(sds pattern) {
     return pattern[0] == '#' && pattern[1] == '\0';
 }
 
+/* Return the name of the key that 'pattern' refers to for the element 'subst',
+ * following the rules of lookupKeyByPattern() below, or NULL if it refers to
+ * no key. When the pattern dereferences a hash field, '*field' and '*fieldlen'
+ * are set to the name of the field within the pattern, otherwise '*fieldlen'
+ * is set to 0. */
+static sds keyNameByPattern(sds spat, robj *subst, char **field, int *fieldlen) {
+    char *p, *f;
+    sds ssub, keyname;
+    int prefixlen, sublen, postfixlen;
+
+    /* If we can't find '*' in the pattern we return NULL as to GET a
+     * fixed key does not make sense. */
+    p = strchr(spat, '*');
+    if (!p) return NULL;
+
+    /* Find out if we're dealing with a hash dereference. */
+    if ((f = strstr(p + 1, "->")) != NULL && *(f + 2) != '\0') {
+        *fieldlen = sdslen(spat) - (f - spat) - 2;
+        *field = f + 2;
+    } else {
+        *fieldlen = 0;
+    }
+
+    /* The substitution object may be specially encoded. If so we create
+     * a decoded object on the fly. Otherwise getDecodedObject will just
+     * increment the ref count, that we'll decrement later. */
+    subst = getDecodedObject(subst);
+    ssub = subst->ptr;
+
+    /* Perform the '*' substitution. */
+    prefixlen = p - spat;
+    sublen = sdslen(ssub);
+    postfixlen = sdslen(spat) - (prefixlen + 1) - (*fieldlen ? *fieldlen + 2 : 0);
+    keyname = sdsnewlen(SDS_NOINIT, prefixlen + sublen + postfixlen);
+    memcpy(keyname, spat, prefixlen);
+    memcpy(keyname + prefixlen, ssub, sublen);
+    memcpy(keyname + prefixlen + sublen, p + 1, postfixlen);
+    decrRefCount(subst); /* Incremented by decodeObject() */
+    return keyname;
+}
+
+/* Return the value of the key 'keyname' like lookupKeyByPattern() below, or
+ * the value of its field 'fieldname' if not NULL. */
+static robj *lookupValueByKeyName(serverDb *db, sds keyname, sds fieldname) {
+    robj *keyobj, *o;
+
+    /* The key object may be retained, e.g. when the key is found expired. */
+    keyobj = createStringObject(keyname, sdslen(keyname));
+    o = lookupKeyRead(db, keyobj);
+    decrRefCount(keyobj);
+    if (o == NULL) return NULL;
+
+    if (fieldname) {
+        if (o->type != OBJ_HASH) return NULL;
+
+        /* Retrieve value from hash by the field name. The returned object
+         * is a new object with refcount already incremented. */
+        return hashTypeGetValueObject(o, fieldname);
+    } else {
+        if (o->type != OBJ_STRING) return NULL;
+
+        /* Every object that this function returns needs to have its refcount
+         * increased. sortCommand decreases it again. */
+        incrRefCount(o);
+        return o;
+    }
+}
+
 /* Return the value associated to the key with a name obtained using
  * the following rules:
  *
@@ -67,10 +135,10 @@ static int isReturnSubstPattern(sds pattern) {
  * The returned object will always have its refcount increased by 1
  * when it is non-NULL. */
 robj *lookupKeyByPattern(serverDb *db, robj *pattern, robj *subst) {
-    char *p, *f, *k;
-    sds spat, ssub;
-    robj *keyobj, *fieldobj = NULL, *o;
-    int prefixlen, sublen, postfixlen, fieldlen;
+    char *field;
+    sds spat, keyname, fieldname = NULL;
+    robj *o;
+    int fieldlen;
 
     /* If the pattern is "#" return the substitution object itself in order
      * to implement the "SORT ... GET #" feature. */
@@ -80,64 +148,65 @@ robj *lookupKeyByPattern(serverDb *db, robj *pattern, robj *subst) {
         return subst;
     }
 
-    /* The substitution object may be specially encoded. If so we create
-     * a decoded object on the fly. Otherwise getDecodedObject will just
-     * increment the ref count, that we'll decrement later. */
-    subst = getDecodedObject(subst);
-    ssub = subst->ptr;
-
-    /* If we can't find '*' in the pattern we return NULL as to GET a
-     * fixed key does not make sense. */
-    p = strchr(spat, '*');
-    if (!p) {
-        decrRefCount(subst);
-        return NULL;
-    }
-
-    /* Find out if we're dealing with a hash dereference. */
-    if ((f = strstr(p + 1, "->")) != NULL && *(f + 2) != '\0') {
-        fieldlen = sdslen(spat) - (f - spat) - 2;
-        fieldobj = createStringObject(f + 2, fieldlen);
-    } else {
-        fieldlen = 0;
-    }
-
-    /* Perform the '*' substitution. */
-    prefixlen = p - spat;
-    sublen = sdslen(ssub);
-    postfixlen = sdslen(spat) - (prefixlen + 1) - (fieldlen ? fieldlen + 2 : 0);
-    keyobj = createStringObject(NULL, prefixlen + sublen + postfixlen);
-    k = keyobj->ptr;
-    memcpy(k, spat, prefixlen);
-    memcpy(k + prefixlen, ssub, sublen);
-    memcpy(k + prefixlen + sublen, p + 1, postfixlen);
-    decrRefCount(subst); /* Incremented by decodeObject() */
-
-    /* Lookup substituted key */
-    o = lookupKeyRead(db, keyobj);
-    if (o == NULL) goto noobj;
-
-    if (fieldobj) {
-        if (o->type != OBJ_HASH) goto noobj;
+    keyname = keyNameByPattern(spat, subst, &field, &fieldlen);
+    if (!keyname) return NULL;
+    if (fieldlen) fieldname = sdsnewlen(field, fieldlen);
+    o = lookupValueByKeyName(db, keyname, fieldname);
+    sdsfree(keyname);
+    sdsfree(fieldname);
+    return o;
+}
 
-        /* Retrieve value from hash by the field name. The returned object
-         * is a new object with refcount already incremented. */
-        o = hashTypeGetValueObject(o, fieldobj->ptr);
-    } else {
-        if (o->type != OBJ_STRING) goto noobj;
+/* The key names a BY or GET pattern refers to for a batch of consecutive
+ * elements of the sorting vector. */
+typedef struct sortKeyBatch {
+    long start;                                 /* Index of the first element. */
+    long count;                                 /* Number of elements. */
+    sds fieldname;                              /* Hash field of the pattern, or NULL. */
+    sds keynames[PREFETCH_KEYS_MAX_BATCH];      /* NULL when the pattern refers to no key. */
+} sortKeyBatch;
+
+static void sortKeyBatchReset(sortKeyBatch *kb) {
+    for (long i = 0; i < kb->count; i++) sdsfree(kb->keynames[i]);
+    sdsfree(kb->fieldname);
+    kb->start = kb->count = 0;
+    kb->fieldname = NULL;
+}
 
-        /* Every object that this function returns needs to have its refcount
-         * increased. sortCommand decreases it again. */
-        incrRefCount(o);
+/* Like lookupKeyByPattern() for the element 'j' of 'vector'. Every key lookup
+ * is a likely cache miss, so the key names for the next elements up to 'end'
+ * are computed in batches of server.prefetch_batch_max_size, and the keys of
+ * a batch are prefetched (see prefetchKeys()) before they are looked up one by
+ * one. The elements must be looked up in order, and 'kb' must be reset when
+ * done with it. */
+static robj *lookupKeyByPatternBatched(sortKeyBatch *kb,
+                                       serverDb *db,
+                                       robj *pattern,
+                                       serverSortObject *vector,
+                                       long j,
+                                       long end) {
+    if (server.prefetch_batch_max_size == 0 || isReturnSubstPattern(pattern->ptr))
+        return lookupKeyByPattern(db, pattern, vector[j].obj);
+
+    if (j < kb->start || j >= kb->start + kb->count) {
+        char *field;
+        int fieldlen = 0;
+        sds prefetch[PREFETCH_KEYS_MAX_BATCH];
+        size_t n = 0;
+
+        sortKeyBatchReset(kb);
+        kb->start = j;
+        kb->count = min(end - j + 1, server.prefetch_batch_max_size);
+        for (long i = 0; i < kb->count; i++) {
+            kb->keynames[i] = keyNameByPattern(pattern->ptr, vector[j + i].obj, &field, &fieldlen);
+            if (kb->keynames[i]) prefetch[n++] = kb->keynames[i];
+        }
+        if (fieldlen) kb->fieldname = sdsnewlen(field, fieldlen);
+        prefetchKeys(db, prefetch, n);
     }
-    decrRefCount(keyobj);
-    if (fieldobj) decrRefCount(fieldobj);
-    return o;
 
-noobj:
-    decrRefCount(keyobj);
-    if (fieldlen) decrRefCount(fieldobj);
-    return NULL;
+    sds keyname = kb->keynames[j - kb->start];
+    return keyname ? lookupValueByKeyName(db, keyname, kb->fieldname) : NULL;
 }
 
 /* sortCompare() is used by qsort in sortCommand(). Given that qsort_r with
@@ -205,6 +274,8 @@ void sortCommandGeneric(client *c, int readonly) {
     int syntax_error = 0;
     robj *sortval, *sortby = NULL, *storekey = NULL;
     serverSortObject *vector;         /* Resulting vector to sort */
+    sortKeyBatch bykeys = {0};        /* Key names of the BY pattern */
+    sortKeyBatch *getkeys;            /* Key names of every GET pattern */
     int user_has_full_key_access = 0; /* ACL - used in order to verify 'get' and 'by' options can be used */
     /* Create a list of operations to perform for every sorted element.
      * Operations can be GET */
@@ -469,7 +540,7 @@ void sortCommandGeneric(client *c, int readonly) {
             robj *byval;
             if (sortby) {
                 /* lookup value to sort by */
-                byval = lookupKeyByPattern(c->db, sortby, vector[j].obj);
+                byval = lookupKeyByPatternBatched(&bykeys, c->db, sortby, vector, j, vectorlen - 1);
                 if (!byval) continue;
             } else {
                 /* use object itself to sort by */
@@ -513,8 +584,11 @@ void sortCommandGeneric(client *c, int readonly) {
             qsort(vector, vectorlen, sizeof(serverSortObject), sortCompare);
     }
 
+    sortKeyBatchReset(&bykeys);
+
     /* Send command output to the output buffer, performing the specified
      * GET/DEL/INCR/DECR operations if any. */
+    getkeys = zcalloc(sizeof(sortKeyBatch) * getop);
     outputlen = getop ? getop * (end - start + 1) : end - start + 1;
     if (int_conversion_error) {
         addReplyError(c, "One or more scores can't be converted into double");
@@ -527,9 +601,9 @@ void sortCommandGeneric(client *c, int readonly) {
 
             if (!getop) addReplyBulk(c, vector[j].obj);
             listRewind(operations, &li);
-            while ((ln = listNext(&li))) {
+            for (int k = 0; (ln = listNext(&li)); k++) {
                 serverSortOperation *sop = ln->value;
-                robj *val = lookupKeyByPattern(c->db, sop->pattern, vector[j].obj);
+                robj *val = lookupKeyByPatternBatched(&getkeys[k], c->db, sop->pattern, vector, j, end);
 
                 if (sop->type == SORT_OP_GET) {
                     if (!val) {
@@ -558,9 +632,9 @@ void sortCommandGeneric(client *c, int readonly) {
                 listTypePush(sobj, vector[j].obj, LIST_TAIL);
             } else {
                 listRewind(operations, &li);
-                while ((ln = listNext(&li))) {
+                for (int k = 0; (ln = listNext(&li)); k++) {
                     serverSortOperation *sop = ln->value;
-                    robj *val = lookupKeyByPattern(c->db, sop->pattern, vector[j].obj);
+                    robj *val = lookupKeyByPatternBatched(&getkeys[k], c->db, sop->pattern, vector, j, end);
 
                     if (sop->type == SORT_OP_GET) {
                         if (!val) val = createStringObject("", 0);
@@ -592,6 +666,8 @@ void sortCommandGeneric(client *c, int readonly) {
     }
 
     /* Cleanup */
+    for (j = 0; j < getop; j++) sortKeyBatchReset(&getkeys[j]);
+    zfree(getkeys);
     for (j = 0; j < vectorlen; j++) decrRefCount(vector[j].obj);
 
     decrRefCount(sortval);
@@ -82,10 +82,10 @@ typedef struct streamConsumer {
     rax *pel;             /* Consumer specific pending entries list: all
                              the pending messages delivered to this
                              consumer not yet acknowledged. Keys are
-                             big endian message IDs, while values are
-                             the same streamNACK structure referenced
-                             in the "pel" of the consumer group structure
-                             itself, so the value is shared. */
+                             big endian message IDs, values are NULL:
+                             the streamNACK structure is only referenced
+                             in the "pel" of the consumer group, see
+                             streamLookupNACK(). */
 } streamConsumer;
 
 /* Pending (yet not acknowledged) message in a consumer group. */
@@ -143,6 +143,7 @@ streamNACK *streamCreateNACK(streamConsumer *consumer);
 void streamDecodeID(void *buf, streamID *id);
 int streamCompareID(streamID *a, streamID *b);
 void streamFreeNACK(streamNACK *na);
+streamNACK *streamLookupNACK(streamCG *cg, unsigned char *rawid);
 int streamIncrID(streamID *id);
 int streamDecrID(streamID *id);
 void streamPropagateConsumerCreation(client *c, robj *key, robj *groupname, sds consumername);
@@ -156,5 +157,8 @@ void streamGetEdgeID(stream *s, int first, int skip_tombstones, streamID *edge_i
 long long streamEstimateDistanceFromFirstEverEntry(stream *s, streamID *id);
 int64_t streamTrimByLength(stream *s, long long maxlen, int approx);
 int64_t streamTrimByID(stream *s, streamID minid, int approx);
+int streamHasNewEntriesForClient(client *c, robj *key, stream *s);
+void streamSharedRepliesBegin(void);
+void streamSharedRepliesEnd(void);
 
 #endif
@@ -29,6 +29,95 @@
 
 #include "server.h"
 #include <math.h>
+#include <pthread.h>
+
+/*-----------------------------------------------------------------------------
+ * Interned field names
+ *
+ * Hashes sharing the same schema repeat the same field names over and over.
+ * When hash-intern-fields is enabled, dict encoded hashes are created with
+ * hashInternedDictType and their field names are stored once in
+ * server.hash_interned_fields together with a reference count, instead of
+ * being duplicated in every hash. Listpack encoded hashes are not affected.
+ *
+ * Hash dicts may be released by the lazyfree thread, so the table of interned
+ * names is protected by a mutex.
+ *----------------------------------------------------------------------------*/
+
+static pthread_mutex_t hash_interned_fields_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Return the interned copy of 'field', taking ownership of it: either 'field'
+ * itself becomes the interned copy or it is freed and the existing one is
+ * returned. Long field names are unlikely to repeat and are returned as they
+ * are. */
+static sds hashFieldIntern(sds field) {
+    if (sdslen(field) > server.hash_max_listpack_value) return field;
+
+    dictEntry *de, *existing;
+    sds shared = field;
+    pthread_mutex_lock(&hash_interned_fields_mutex);
+    de = dictAddRaw(server.hash_interned_fields, field, &existing);
+    if (de) {
+        dictSetUnsignedIntegerVal(de, 1);
+    } else {
+        dictIncrUnsignedIntegerVal(existing, 1);
+        shared = dictGetKey(existing);
+    }
+    pthread_mutex_unlock(&hash_interned_fields_mutex);
+    if (shared != field) sdsfree(field);
+    return shared;
+}
+
+/* Key destructor of hashInternedDictType. Drops a reference to an interned
+ * field name, or frees the field if it was never interned. */
+void hashFieldRelease(sds field) {
+    pthread_mutex_lock(&hash_interned_fields_mutex);
+    dictEntry *de = dictFind(server.hash_interned_fields, field);
+    if (de && dictGetKey(de) == field) {
+        uint64_t refcount = dictGetUnsignedIntegerVal(de) - 1;
+        if (refcount == 0)
+            dictDelete(server.hash_interned_fields, field);
+        else
+            dictSetUnsignedIntegerVal(de, refcount);
+        field = NULL;
+    }
+    pthread_mutex_unlock(&hash_interned_fields_mutex);
+    if (field) sdsfree(field);
+}
+
+unsigned long hashInternedFieldsCount(void) {
+    pthread_mutex_lock(&hash_interned_fields_mutex);
+    unsigned long count = dictSize(server.hash_interned_fields);
+    pthread_mutex_unlock(&hash_interned_fields_mutex);
+    return count;
+}
+
+/* Create the dict backing a hash table encoded hash. Unless the field names
+ * are interned, they are embedded in the dict entries. */
+dict *hashTypeCreateDict(void) {
+    return dictCreate(server.hash_intern_fields ? &hashInternedDictType : &hashEmbeddedDictType);
+}
+
+/* Set the key of a freshly added hash dict entry, taking ownership of 'field'.
+ * Embedded entries already hold a copy of the field made by the dict. */
+static void hashTypeDictSetField(dict *d, dictEntry *de, sds field) {
+    if (d->type->embedded_entry) {
+        sdsfree(field);
+        return;
+    }
+    if (d->type == &hashInternedDictType) field = hashFieldIntern(field);
+    dictSetKey(d, de, field);
+}
+
+/* Add a field-value pair to a hash dict, taking ownership of both on success.
+ * Returns DICT_ERR, leaving both to the caller, if the field already exists. */
+int hashTypeDictAdd(dict *d, sds field, sds value) {
+    dictEntry *de = dictAddRaw(d, field, NULL);
+    if (de == NULL) return DICT_ERR;
+    dictSetVal(d, de, value);
+    hashTypeDictSetField(d, de, field);
+    return DICT_OK;
+}
 
 /*-----------------------------------------------------------------------------
  * Hash type API
@@ -243,9 +332,10 @@ int hashTypeSet(robj *o, sds field, sds value, int flags) {
         if (de) {
             dictSetVal(ht, de, v);
             if (flags & HASH_SET_TAKE_FIELD) {
+                hashTypeDictSetField(ht, de, field);
                 field = NULL;
-            } else {
-                dictSetKey(ht, de, sdsdup(field));
+            } else if (!ht->type->embedded_entry) {
+                hashTypeDictSetField(ht, de, sdsdup(field));
             }
         } else {
             sdsfree(dictGetVal(existing));
@@ -450,7 +540,7 @@ void hashTypeConvertListpack(robj *o, int enc) {
         int ret;
 
         hashTypeInitIterator(o, &hi);
-        dict = dictCreate(&hashDictType);
+        dict = hashTypeCreateDict();
 
         /* Presize the dict to avoid rehashing */
         dictExpand(dict, hashTypeLength(o));
@@ -460,7 +550,7 @@ void hashTypeConvertListpack(robj *o, int enc) {
 
             key = hashTypeCurrentObjectNewSds(&hi, OBJ_HASH_KEY);
             value = hashTypeCurrentObjectNewSds(&hi, OBJ_HASH_VALUE);
-            ret = dictAdd(dict, key, value);
+            ret = hashTypeDictAdd(dict, key, value);
             if (ret != DICT_OK) {
                 sdsfree(key);
                 sdsfree(value);             /* Needed for gcc ASAN */
@@ -507,7 +597,7 @@ robj *hashTypeDup(robj *o) {
         hobj = createObject(OBJ_HASH, new_zl);
         hobj->encoding = OBJ_ENCODING_LISTPACK;
     } else if (o->encoding == OBJ_ENCODING_HT) {
-        dict *d = dictCreate(&hashDictType);
+        dict *d = dictCreate(((const dict *)o->ptr)->type);
         dictExpand(d, dictSize((const dict *)o->ptr));
 
         hashTypeInitIterator(o, &hi);
@@ -521,7 +611,7 @@ robj *hashTypeDup(robj *o) {
             newvalue = sdsdup(value);
 
             /* Add a field-value pair to a new hash object. */
-            dictAdd(d, newfield, newvalue);
+            hashTypeDictAdd(d, newfield, newvalue);
         }
         hashTypeResetIterator(&hi);
 
@@ -589,6 +679,50 @@ void hsetnxCommand(client *c) {
     }
 }
 
+/* Set the field-value pairs argv[start..end] on a listpack encoded hash, as
+ * calling hashTypeSet() on each pair in turn would. Existing fields are
+ * updated in place, while the new ones are appended with a single
+ * lpBatchAppend() call. Returns the number of fields created. */
+static int hashTypeListpackSetMulti(robj *o, robj **argv, int start, int end) {
+    serverAssert(o->encoding == OBJ_ENCODING_LISTPACK);
+    listpackEntry buf[32], *entries = buf;
+    int count = end - start + 1, created = 0;
+    if (count > (int)(sizeof(buf) / sizeof(buf[0]))) entries = zmalloc(sizeof(listpackEntry) * count);
+
+    for (int i = start; i < end; i += 2) {
+        sds field = argv[i]->ptr, value = argv[i + 1]->ptr;
+        unsigned char *zl = o->ptr, *fptr = lpFirst(zl);
+        if (fptr) fptr = lpFind(zl, fptr, (unsigned char *)field, sdslen(field), 1);
+        if (fptr) {
+            unsigned char *vptr = lpNext(zl, fptr);
+            serverAssert(vptr != NULL);
+            o->ptr = lpReplace(zl, &vptr, (unsigned char *)value, sdslen(value));
+            continue;
+        }
+
+        /* The field may also be repeated within the pending ones. */
+        int j;
+        for (j = 0; j < created; j++) {
+            listpackEntry *f = &entries[j * 2];
+            if (f->slen == sdslen(field) && memcmp(f->sval, field, f->slen) == 0) break;
+        }
+        entries[j * 2 + 1].sval = (unsigned char *)value;
+        entries[j * 2 + 1].slen = sdslen(value);
+        if (j == created) {
+            entries[j * 2].sval = (unsigned char *)field;
+            entries[j * 2].slen = sdslen(field);
+            created++;
+        }
+    }
+
+    if (created) o->ptr = lpBatchAppend(o->ptr, entries, created * 2);
+    if (entries != buf) zfree(entries);
+
+    /* Check if the listpack needs to be converted to a hash table */
+    if (hashTypeLength(o) > server.hash_max_listpack_entries) hashTypeConvert(o, OBJ_ENCODING_HT);
+    return created;
+}
+
 void hsetCommand(client *c) {
     int i, created = 0;
     robj *o;
@@ -601,7 +735,12 @@ void hsetCommand(client *c) {
     if ((o = hashTypeLookupWriteOrCreate(c, c->argv[1])) == NULL) return;
     hashTypeTryConversion(o, c->argv, 2, c->argc - 1);
 
-    for (i = 2; i < c->argc; i += 2) created += !hashTypeSet(o, c->argv[i]->ptr, c->argv[i + 1]->ptr, HASH_SET_COPY);
+    if (o->encoding == OBJ_ENCODING_LISTPACK) {
+        created = hashTypeListpackSetMulti(o, c->argv, 2, c->argc - 1);
+    } else {
+        for (i = 2; i < c->argc; i += 2)
+            created += !hashTypeSet(o, c->argv[i]->ptr, c->argv[i + 1]->ptr, HASH_SET_COPY);
+    }
 
     /* HMSET (deprecated) and HSET return value is different. */
     char *cmdname = c->argv[0]->ptr;
@@ -807,6 +946,31 @@ static void addHashIteratorCursorToReply(writePreparedClient *wpc, hashTypeItera
     }
 }
 
+/* Position of an incremental HGETALL, HKEYS or HVALS reply. */
+typedef struct {
+    hashTypeIterator hi;
+    int flags;
+} hashReplyGeneratorState;
+
+static void hashReplyGeneratorFree(void *state) {
+    hashReplyGeneratorState *st = state;
+    hashTypeResetIterator(&st->hi);
+    zfree(st);
+}
+
+static int hashReplyGeneratorProc(client *c, replyGenerator *gen, long count) {
+    hashReplyGeneratorState *st = gen->state;
+    writePreparedClient *wpc = prepareClientForFutureWrites(c);
+
+    while (count--) {
+        if (hashTypeNext(&st->hi) == C_ERR) return 1;
+        if (!wpc) continue;
+        if (st->flags & OBJ_HASH_KEY) addHashIteratorCursorToReply(wpc, &st->hi, OBJ_HASH_KEY);
+        if (st->flags & OBJ_HASH_VALUE) addHashIteratorCursorToReply(wpc, &st->hi, OBJ_HASH_VALUE);
+    }
+    return 0;
+}
+
 void genericHgetallCommand(client *c, int flags) {
     robj *o;
     hashTypeIterator hi;
@@ -826,6 +990,17 @@ void genericHgetallCommand(client *c, int flags) {
         addWritePreparedReplyArrayLen(wpc, length);
     }
 
+    if (replyGeneratorAllowed(c, length)) {
+        hashReplyGeneratorState *st = zmalloc(sizeof(*st));
+        hashTypeInitIterator(o, &st->hi);
+        /* Other clients may access the hash table until the reply is complete,
+         * so make sure they don't rehash it. */
+        if (st->hi.encoding == OBJ_ENCODING_HT) dictInitSafeIterator(&st->hi.di, o->ptr);
+        st->flags = flags;
+        addReplyGenerator(c, c->argv[1], o, hashReplyGeneratorProc, st, hashReplyGeneratorFree);
+        return;
+    }
+
     hashTypeInitIterator(o, &hi);
     while (hashTypeNext(&hi) != C_ERR) {
         if (flags & OBJ_HASH_KEY) {
@@ -176,6 +176,39 @@ void listTypePush(robj *subject, robj *value, int where) {
     }
 }
 
+/* Push the elements argv[start..end] to the list 'subject', leaving the list
+ * as calling listTypePush() on each of them in turn would. On a listpack
+ * encoded list all the elements are inserted at once, so the listpack is
+ * reallocated and moved only once regardless of the number of elements. */
+static void listTypePushMulti(robj *subject, robj **argv, int start, int end, int where) {
+    if (subject->encoding != OBJ_ENCODING_LISTPACK) {
+        for (int j = start; j <= end; j++) listTypePush(subject, argv[j], where);
+        return;
+    }
+
+    listpackEntry buf[16], *entries = buf;
+    int count = end - start + 1;
+    if (count > (int)(sizeof(buf) / sizeof(buf[0]))) entries = zmalloc(sizeof(listpackEntry) * count);
+    for (int j = 0; j < count; j++) {
+        /* Pushing one by one at the head reverses the order of the elements. */
+        robj *value = argv[where == LIST_HEAD ? end - j : start + j];
+        if (value->encoding == OBJ_ENCODING_INT) {
+            entries[j].sval = NULL;
+            entries[j].lval = (long)value->ptr;
+        } else {
+            entries[j].sval = value->ptr;
+            entries[j].slen = sdslen(value->ptr);
+        }
+    }
+
+    unsigned char *p = (where == LIST_HEAD) ? lpFirst(subject->ptr) : NULL;
+    if (p)
+        subject->ptr = lpBatchInsert(subject->ptr, p, LP_BEFORE, entries, count, NULL);
+    else
+        subject->ptr = lpBatchAppend(subject->ptr, entries, count);
+    if (entries != buf) zfree(entries);
+}
+
 void *listPopSaver(unsigned char *data, size_t sz) {
     return createStringObject((char *)data, sz);
 }
@@ -460,8 +493,6 @@ void listTypeDelRange(robj *subject, long start, long count) {
 /* Implements LPUSH/RPUSH/LPUSHX/RPUSHX.
  * 'xx': push if key exists. */
 void pushGenericCommand(client *c, int where, int xx) {
-    int j;
-
     robj *lobj = lookupKeyWrite(c->db, c->argv[1]);
     if (checkType(c, lobj, OBJ_LIST)) return;
     if (!lobj) {
@@ -475,10 +506,8 @@ void pushGenericCommand(client *c, int where, int xx) {
     }
 
     listTypeTryConversionAppend(lobj, c->argv, 2, c->argc - 1, NULL, NULL);
-    for (j = 2; j < c->argc; j++) {
-        listTypePush(lobj, c->argv[j], where);
-        server.dirty++;
-    }
+    listTypePushMulti(lobj, c->argv, 2, c->argc - 1, where);
+    server.dirty += c->argc - 2;
 
     addReplyLongLong(c, listTypeLength(lobj));
 
@@ -638,7 +667,7 @@ void listPopRangeAndReplyWithKey(client *c, robj *o, robj *key, int where, long
     /* We return key-name just once, and an array of elements */
     addReplyArrayLen(c, 2);
     addReplyBulk(c, key);
-    addListRangeReply(c, o, rangestart, rangeend, reverse);
+    addListRangeReply(c, NULL, o, rangestart, rangeend, reverse);
 
     /* Pop these elements. */
     listTypeDelRange(o, rangestart, rangelen);
@@ -652,8 +681,6 @@ void listPopRangeAndReplyWithKey(client *c, robj *o, robj *key, int where, long
 void addListQuicklistRangeReply(client *c, robj *o, int from, int rangelen, int reverse) {
     writePreparedClient *wpc = prepareClientForFutureWrites(c);
     if (!wpc) return;
-    /* Return the result in form of a multi-bulk reply */
-    addWritePreparedReplyArrayLen(wpc, rangelen);
 
     int direction = reverse ? AL_START_TAIL : AL_START_HEAD;
     quicklistIter *iter = quicklistGetIteratorAtIdx(o->ptr, direction, from);
@@ -675,8 +702,6 @@ void addListQuicklistRangeReply(client *c, robj *o, int from, int rangelen, int
 void addListListpackRangeReply(client *c, robj *o, int from, int rangelen, int reverse) {
     writePreparedClient *wpc = prepareClientForFutureWrites(c);
     if (!wpc) return;
-    /* Return the result in form of a multi-bulk reply */
-    addWritePreparedReplyArrayLen(wpc, rangelen);
     unsigned char *p = lpSeek(o->ptr, from);
     unsigned char *vstr;
     unsigned int vlen;
@@ -694,12 +719,33 @@ void addListListpackRangeReply(client *c, robj *o, int from, int rangelen, int r
     }
 }
 
+/* Position of an incremental LRANGE reply. */
+typedef struct {
+    long index; /* Next element to emit. */
+    long end;   /* Last element to emit. */
+} listRangeGeneratorState;
+
+static int listRangeGeneratorProc(client *c, replyGenerator *gen, long count) {
+    listRangeGeneratorState *st = gen->state;
+    long rangelen = min(count, st->end - st->index + 1);
+
+    if (gen->obj->encoding == OBJ_ENCODING_QUICKLIST)
+        addListQuicklistRangeReply(c, gen->obj, st->index, rangelen, 0);
+    else
+        addListListpackRangeReply(c, gen->obj, st->index, rangelen, 0);
+    st->index += rangelen;
+    return st->index > st->end;
+}
+
 /* A helper for replying with a list's range between the inclusive start and end
  * indexes as multi-bulk, with support for negative indexes. Note that start
  * must be less than end or an empty array is returned. When the reverse
  * argument is set to a non-zero value, the reply is reversed so that elements
- * are returned from end to start. */
-void addListRangeReply(client *c, robj *o, long start, long end, int reverse) {
+ * are returned from end to start.
+ *
+ * When 'key' is not NULL a long range may be emitted incrementally, so the
+ * caller must not modify the list after calling this function. */
+void addListRangeReply(client *c, robj *key, robj *o, long start, long end, int reverse) {
     long rangelen, llen = listTypeLength(o);
 
     /* Convert negative indexes. */
@@ -716,6 +762,16 @@ void addListRangeReply(client *c, robj *o, long start, long end, int reverse) {
     if (end >= llen) end = llen - 1;
     rangelen = (end - start) + 1;
 
+    /* Return the result in form of a multi-bulk reply */
+    addReplyArrayLen(c, rangelen);
+    if (key && !reverse && replyGeneratorAllowed(c, rangelen)) {
+        listRangeGeneratorState *st = zmalloc(sizeof(*st));
+        st->index = start;
+        st->end = end;
+        addReplyGenerator(c, key, o, listRangeGeneratorProc, st, zfree);
+        return;
+    }
+
     int from = reverse ? end : start;
     if (o->encoding == OBJ_ENCODING_QUICKLIST)
         addListQuicklistRangeReply(c, o, from, rangelen, reverse);
@@ -791,7 +847,7 @@ void popGenericCommand(client *c, int where) {
         long rangeend = (where == LIST_HEAD) ? rangelen - 1 : -1;
         int reverse = (where == LIST_HEAD) ? 0 : 1;
 
-        addListRangeReply(c, o, rangestart, rangeend, reverse);
+        addListRangeReply(c, NULL, o, rangestart, rangeend, reverse);
         listTypeDelRange(o, rangestart, rangelen);
         listElementsRemoved(c, c->argv[1], where, o, rangelen, 1, NULL);
     }
@@ -857,7 +913,7 @@ void lrangeCommand(client *c) {
 
     if ((o = lookupKeyReadOrReply(c, c->argv[1], shared.emptyarray)) == NULL || checkType(c, o, OBJ_LIST)) return;
 
-    addListRangeReply(c, o, start, end, 0);
+    addListRangeReply(c, c->argv[1], o, start, end, 0);
 }
 
 /* LTRIM <key> <start> <stop> */
@@ -586,6 +586,47 @@ robj *setTypeDup(robj *o) {
     return set;
 }
 
+/* Add the members argv[0..count-1] to a listpack encoded set, appending the
+ * new ones with a single lpBatchAppend() call. Returns the number of members
+ * added, or -1 without touching the set if it may outgrow the listpack
+ * encoding, in which case the members should be added one by one. */
+static int setTypeListpackAddMulti(robj *set, robj **argv, int count) {
+    serverAssert(set->encoding == OBJ_ENCODING_LISTPACK);
+    unsigned char *lp = set->ptr;
+    size_t sum = 0;
+
+    if (lpLength(lp) + count > server.set_max_listpack_entries) return -1;
+    for (int j = 0; j < count; j++) {
+        size_t len = sdslen(argv[j]->ptr);
+        if (len > server.set_max_listpack_value) return -1;
+        sum += len;
+    }
+    if (!lpSafeToAdd(lp, sum)) return -1;
+
+    listpackEntry buf[16], *entries = buf;
+    int added = 0;
+    if (count > (int)(sizeof(buf) / sizeof(buf[0]))) entries = zmalloc(sizeof(listpackEntry) * count);
+    for (int j = 0; j < count; j++) {
+        sds member = argv[j]->ptr;
+        unsigned char *p = lpFirst(lp);
+        if (p && lpFind(lp, p, (unsigned char *)member, sdslen(member), 0)) continue;
+
+        /* The member may also be repeated within the pending ones. */
+        int k;
+        for (k = 0; k < added; k++) {
+            if (entries[k].slen == sdslen(member) && memcmp(entries[k].sval, member, entries[k].slen) == 0) break;
+        }
+        if (k < added) continue;
+        entries[added].sval = (unsigned char *)member;
+        entries[added].slen = sdslen(member);
+        added++;
+    }
+
+    if (added) set->ptr = lpBatchAppend(lp, entries, added);
+    if (entries != buf) zfree(entries);
+    return added;
+}
+
 void saddCommand(client *c) {
     robj *set;
     int j, added = 0;
@@ -600,8 +641,11 @@ void saddCommand(client *c) {
         setTypeMaybeConvert(set, c->argc - 2);
     }
 
-    for (j = 2; j < c->argc; j++) {
-        if (setTypeAdd(set, c->argv[j]->ptr)) added++;
+    if (set->encoding != OBJ_ENCODING_LISTPACK || (added = setTypeListpackAddMulti(set, c->argv + 2, c->argc - 2)) < 0) {
+        added = 0;
+        for (j = 2; j < c->argc; j++) {
+            if (setTypeAdd(set, c->argv[j]->ptr)) added++;
+        }
     }
     if (added) {
         signalModifiedKey(c, c->db, c->argv[1]);
@@ -1244,6 +1288,28 @@ int qsortCompareSetsByRevCardinality(const void *s1, const void *s2) {
  * 'limit' work for SINTERCARD, stop searching after reaching the limit.
  * Passing a 0 means unlimited.
  */
+static void setReplyGeneratorFree(void *state) {
+    setTypeReleaseIterator(state);
+}
+
+/* Emits the members of an incremental SMEMBERS reply, the state is the set
+ * iterator. */
+static int setReplyGeneratorProc(client *c, replyGenerator *gen, long count) {
+    setTypeIterator *si = gen->state;
+    char *str;
+    size_t len;
+    int64_t intobj;
+
+    while (count--) {
+        if (setTypeNext(si, &str, &len, &intobj) == -1) return 1;
+        if (str != NULL)
+            addReplyBulkCBuffer(c, str, len);
+        else
+            addReplyBulkLongLong(c, intobj);
+    }
+    return 0;
+}
+
 void sinterGenericCommand(client *c,
                           robj **setkeys,
                           unsigned long setnum,
@@ -1259,6 +1325,7 @@ void sinterGenericCommand(client *c,
     void *replylen = NULL;
     unsigned long j, cardinality = 0;
     int encoding, empty = 0;
+    uint32_t *cursors = NULL;
 
     for (j = 0; j < setnum; j++) {
         robj *setobj = lookupKeyRead(c->db, setkeys[j]);
@@ -1294,6 +1361,22 @@ void sinterGenericCommand(client *c,
         return;
     }
 
+    /* SMEMBERS, or the intersection of a single set: a big reply can be
+     * emitted incrementally. */
+    if (setnum == 1 && !dstkey && !cardinality_only && replyGeneratorAllowed(c, setTypeSize(sets[0]))) {
+        addReplySetLen(c, setTypeSize(sets[0]));
+        si = setTypeInitIterator(sets[0]);
+        if (si->encoding == OBJ_ENCODING_HT) {
+            /* Other clients may access the hash table until the reply is
+             * complete, so make sure they don't rehash it. */
+            dictReleaseIterator(si->di);
+            si->di = dictGetSafeIterator(sets[0]->ptr);
+        }
+        addReplyGenerator(c, setkeys[0], sets[0], setReplyGeneratorProc, si, setReplyGeneratorFree);
+        zfree(sets);
+        return;
+    }
+
     /* Sort sets from the smallest to largest, this will improve our
      * algorithm's performance */
     qsort(sets, setnum, sizeof(robj *), qsortCompareSetsByCardinality);
@@ -1328,15 +1411,28 @@ void sinterGenericCommand(client *c,
         replylen = addReplyDeferredLen(c);
     }
 
+    /* When the first set is an intset its elements come in ascending order,
+     * so the lookups in the other intsets can resume from where the previous
+     * one ended instead of searching the whole intset each time. */
+    if (sets[0]->encoding == OBJ_ENCODING_INTSET) cursors = zcalloc(sizeof(uint32_t) * setnum);
+
     /* Iterate all the elements of the first (smallest) set, and test
      * the element against all the other sets, if at least one set does
      * not include the element it is discarded */
-    int only_integers = 1;
+    int only_integers = 1, exhausted = 0;
     si = setTypeInitIterator(sets[0]);
-    while ((encoding = setTypeNext(si, &str, &len, &intobj)) != -1) {
+    while (!exhausted && (encoding = setTypeNext(si, &str, &len, &intobj)) != -1) {
         for (j = 1; j < setnum; j++) {
             if (sets[j] == sets[0]) continue;
-            if (!setTypeIsMemberAux(sets[j], str, len, intobj, encoding == OBJ_ENCODING_HT)) break;
+            if (cursors && sets[j]->encoding == OBJ_ENCODING_INTSET) {
+                if (!intsetSearchFrom(sets[j]->ptr, intobj, &cursors[j])) {
+                    /* Nothing left in this intset can match a larger element. */
+                    if (cursors[j] == intsetLen(sets[j]->ptr)) exhausted = 1;
+                    break;
+                }
+            } else if (!setTypeIsMemberAux(sets[j], str, len, intobj, encoding == OBJ_ENCODING_HT)) {
+                break;
+            }
         }
 
         /* Only take action when all sets contain the member */
@@ -1370,6 +1466,7 @@ void sinterGenericCommand(client *c,
         }
     }
     setTypeReleaseIterator(si);
+    zfree(cursors);
 
     if (cardinality_only) {
         addReplyLongLong(c, cardinality);
@@ -1534,6 +1631,17 @@ void sunionDiffGenericCommand(client *c, robj **setkeys, int setnum, robj *dstke
         for (j = 0; j < setnum; j++) {
             if (!sets[j]) continue; /* non existing keys are like empty sets */
 
+            if (dstset->encoding == OBJ_ENCODING_INTSET && sets[j]->encoding == OBJ_ENCODING_INTSET) {
+                /* Both are sorted, so merge them in one pass rather than
+                 * inserting the elements one by one. */
+                intset *is = intsetUnion(dstset->ptr, sets[j]->ptr);
+                zfree(dstset->ptr);
+                dstset->ptr = is;
+                maybeConvertIntset(dstset);
+                cardinality = setTypeSize(dstset);
+                continue;
+            }
+
             si = setTypeInitIterator(sets[j]);
             while ((encoding = setTypeNext(si, &str, &len, &llval)) != -1) {
                 cardinality += setTypeAddAux(dstset, str, len, llval, encoding == OBJ_ENCODING_HT);
@@ -1550,13 +1658,22 @@ void sunionDiffGenericCommand(client *c, robj **setkeys, int setnum, robj *dstke
          * into all the other sets.
          *
          * This way we perform at max N*M operations, where N is the size of
-         * the first set, and M the number of sets. */
+         * the first set, and M the number of sets.
+         *
+         * As in SINTER, lookups in intsets resume from the previous one when
+         * the first set is an intset too. */
+        uint32_t *cursors = NULL;
+        if (sets[0]->encoding == OBJ_ENCODING_INTSET) cursors = zcalloc(sizeof(uint32_t) * setnum);
         si = setTypeInitIterator(sets[0]);
         while ((encoding = setTypeNext(si, &str, &len, &llval)) != -1) {
             for (j = 1; j < setnum; j++) {
                 if (!sets[j]) continue;        /* no key is an empty set. */
                 if (sets[j] == sets[0]) break; /* same set! */
-                if (setTypeIsMemberAux(sets[j], str, len, llval, encoding == OBJ_ENCODING_HT)) break;
+                if (cursors && sets[j]->encoding == OBJ_ENCODING_INTSET) {
+                    if (intsetSearchFrom(sets[j]->ptr, llval, &cursors[j])) break;
+                } else if (setTypeIsMemberAux(sets[j], str, len, llval, encoding == OBJ_ENCODING_HT)) {
+                    break;
+                }
             }
             if (j == setnum) {
                 /* There is no other set with this element. Add it. */
@@ -1564,6 +1681,7 @@ void sunionDiffGenericCommand(client *c, robj **setkeys, int setnum, robj *dstke
             }
         }
         setTypeReleaseIterator(si);
+        zfree(cursors);
     } else if (op == SET_OP_DIFF && sets[0] && diff_algo == 2) {
         /* DIFF Algorithm 2:
          *
@@ -60,6 +60,7 @@ size_t streamReplyWithRangeFromConsumerPEL(client *c,
                                            streamID *start,
                                            streamID *end,
                                            size_t count,
+                                           streamCG *group,
                                            streamConsumer *consumer);
 int streamParseStrictIDOrReply(client *c, robj *o, streamID *id, uint64_t missing_seq, int *seq_given);
 int streamParseIDOrReply(client *c, robj *o, streamID *id, uint64_t missing_seq);
@@ -247,7 +248,7 @@ robj *streamDup(robj *o) {
 
                 streamNACK *new_nack = result;
                 new_nack->consumer = new_consumer;
-                raxInsert(new_consumer->pel, ri_cpel.key, sizeof(streamID), new_nack, NULL);
+                raxInsert(new_consumer->pel, ri_cpel.key, sizeof(streamID), NULL, NULL);
             }
             raxStop(&ri_cpel);
         }
@@ -1592,6 +1593,25 @@ void streamPropagateConsumerCreation(client *c, robj *key, robj *groupname, sds
     decrRefCount(argv[4]);
 }
 
+/* Emit the entry the iterator 'si' is at, with the specified ID and number of
+ * fields, as a two elements array: the first is the ID, the second is an
+ * array of field-value pairs. */
+static void addReplyStreamEntry(client *c, streamIterator *si, streamID *id, int64_t numfields) {
+    addReplyArrayLen(c, 2);
+    addReplyStreamID(c, id);
+
+    addReplyArrayLen(c, numfields * 2);
+
+    /* Emit the field-value pairs. */
+    while (numfields--) {
+        unsigned char *key, *value;
+        int64_t key_len, value_len;
+        streamIteratorGetField(si, &key, &value, &key_len, &value_len);
+        addReplyBulkCBuffer(c, key, key_len);
+        addReplyBulkCBuffer(c, value, value_len);
+    }
+}
+
 /* Send the stream items in the specified range to the client 'c'. The range
  * the client will receive is between start and end inclusive, if 'count' is
  * non zero, no more than 'count' elements are sent.
@@ -1669,7 +1689,7 @@ size_t streamReplyWithRange(client *c,
      * the history of messages delivered to it and not yet confirmed
      * as delivered. */
     if (group && (flags & STREAM_RWR_HISTORY)) {
-        return streamReplyWithRangeFromConsumerPEL(c, s, start, end, count, consumer);
+        return streamReplyWithRangeFromConsumerPEL(c, s, start, end, count, group, consumer);
     }
 
     if (!(flags & STREAM_RWR_RAWENTRIES)) arraylen_ptr = addReplyDeferredLen(c);
@@ -1694,21 +1714,7 @@ size_t streamReplyWithRange(client *c,
             propagate_last_id = 1;
         }
 
-        /* Emit a two elements array for each item. The first is
-         * the ID, the second is an array of field-value pairs. */
-        addReplyArrayLen(c, 2);
-        addReplyStreamID(c, &id);
-
-        addReplyArrayLen(c, numfields * 2);
-
-        /* Emit the field-value pairs. */
-        while (numfields--) {
-            unsigned char *key, *value;
-            int64_t key_len, value_len;
-            streamIteratorGetField(&si, &key, &value, &key_len, &value_len);
-            addReplyBulkCBuffer(c, key, key_len);
-            addReplyBulkCBuffer(c, value, value_len);
-        }
+        addReplyStreamEntry(c, &si, &id, numfields);
 
         /* If a group is passed, we need to create an entry in the
          * PEL (pending entries list) of this group *and* this consumer.
@@ -1728,7 +1734,7 @@ size_t streamReplyWithRange(client *c,
              * if we find that there is already a entry for this ID. */
             streamNACK *nack = streamCreateNACK(consumer);
             int group_inserted = raxTryInsert(group->pel, buf, sizeof(buf), nack, NULL);
-            int consumer_inserted = raxTryInsert(consumer->pel, buf, sizeof(buf), nack, NULL);
+            int consumer_inserted = raxTryInsert(consumer->pel, buf, sizeof(buf), NULL, NULL);
 
             /* Now we can check if the entry was already busy, and
              * in that case reassign the entry to the new consumer,
@@ -1745,7 +1751,7 @@ size_t streamReplyWithRange(client *c,
                 nack->delivery_time = commandTimeSnapshot();
                 nack->delivery_count = 1;
                 /* Add the entry in the new consumer local PEL. */
-                raxInsert(consumer->pel, buf, sizeof(buf), nack, NULL);
+                raxInsert(consumer->pel, buf, sizeof(buf), NULL, NULL);
             } else if (group_inserted == 1 && consumer_inserted == 0) {
                 serverPanic("NACK half-created. Should not be possible.");
             }
@@ -1789,6 +1795,7 @@ size_t streamReplyWithRangeFromConsumerPEL(client *c,
                                            streamID *start,
                                            streamID *end,
                                            size_t count,
+                                           streamCG *group,
                                            streamConsumer *consumer) {
     raxIterator ri;
     unsigned char startkey[sizeof(streamID)];
@@ -1813,7 +1820,7 @@ size_t streamReplyWithRangeFromConsumerPEL(client *c,
             addReplyStreamID(c, &thisid);
             addReplyNullArray(c);
         } else {
-            streamNACK *nack = ri.data;
+            streamNACK *nack = streamLookupNACK(group, ri.key);
             nack->delivery_time = commandTimeSnapshot();
             nack->delivery_count++;
         }
@@ -2064,6 +2071,31 @@ void xaddCommand(client *c) {
     signalKeyAsReady(c->db, c->argv[1], OBJ_STREAM);
 }
 
+/* State of an incremental XRANGE/XREVRANGE reply. */
+typedef struct xrangeReplyGeneratorState {
+    streamIterator si;
+    long long remaining;
+} xrangeReplyGeneratorState;
+
+static void xrangeReplyGeneratorFree(void *state) {
+    xrangeReplyGeneratorState *st = state;
+    streamIteratorStop(&st->si);
+    zfree(st);
+}
+
+static int xrangeReplyGeneratorProc(client *c, replyGenerator *gen, long count) {
+    xrangeReplyGeneratorState *st = gen->state;
+    int64_t numfields;
+    streamID id;
+
+    while (st->remaining && count--) {
+        serverAssert(streamIteratorGetID(&st->si, &id, &numfields));
+        addReplyStreamEntry(c, &st->si, &id, numfields);
+        st->remaining--;
+    }
+    return st->remaining == 0;
+}
+
 /* XRANGE/XREVRANGE actual implementation.
  * The 'start' and 'end' IDs are parsed as follows:
  *   Incomplete 'start' has its sequence set to 0, and 'end' to UINT64_MAX.
@@ -2114,10 +2146,24 @@ void xrangeGenericCommand(client *c, int rev) {
 
     if (count == 0) {
         addReplyNullArray(c);
-    } else {
-        if (count == -1) count = 0;
-        streamReplyWithRange(c, s, &startid, &endid, count, rev, NULL, NULL, 0, NULL);
+        return;
+    }
+    if (count == -1) count = 0;
+
+    /* When the range covers the whole stream the length of the reply is known
+     * upfront, and a big reply can be emitted incrementally. */
+    if (s->length && streamCompareID(&startid, &s->first_id) <= 0 && streamCompareID(&endid, &s->last_id) >= 0) {
+        long long total = (count && (unsigned long long)count < s->length) ? count : (long long)s->length;
+        if (replyGeneratorAllowed(c, total)) {
+            xrangeReplyGeneratorState *st = zmalloc(sizeof(*st));
+            addReplyArrayLen(c, total);
+            streamIteratorStart(&st->si, s, &startid, &endid, rev);
+            st->remaining = total;
+            addReplyGenerator(c, c->argv[1], o, xrangeReplyGeneratorProc, st, xrangeReplyGeneratorFree);
+            return;
+        }
     }
+    streamReplyWithRange(c, s, &startid, &endid, count, rev, NULL, NULL, 0, NULL);
 }
 
 /* XRANGE key start end [COUNT <n>] */
@@ -2138,6 +2184,133 @@ void xlenCommand(client *c) {
     addReplyLongLong(c, s->length);
 }
 
+/* Clients blocked with XREAD on the same stream are usually waiting for the
+ * same entries. While they are served, see handleClientsBlockedOnKey(), the
+ * ranges they read are encoded once and kept here, so that the other clients
+ * reading the same range just get a copy. A range can be reused only as long
+ * as the stream is unchanged, which is checked against a few of its fields
+ * since other blocked clients (modules) may modify it. */
+#define STREAM_SHARED_REPLIES_MAX 16
+
+typedef struct streamSharedReply {
+    stream *s;
+    uint64_t length;
+    uint64_t entries_added;
+    streamID last_id;
+    streamID first_id;
+    streamID max_deleted_entry_id;
+    streamID start;
+    long long count;
+    int resp;
+    sds proto;
+} streamSharedReply;
+
+static struct {
+    int active;
+    int len;
+    streamSharedReply replies[STREAM_SHARED_REPLIES_MAX];
+} streamSharedReplies;
+
+void streamSharedRepliesBegin(void) {
+    serverAssert(!streamSharedReplies.active);
+    streamSharedReplies.active = 1;
+}
+
+void streamSharedRepliesEnd(void) {
+    for (int j = 0; j < streamSharedReplies.len; j++) sdsfree(streamSharedReplies.replies[j].proto);
+    streamSharedReplies.len = 0;
+    streamSharedReplies.active = 0;
+}
+
+static int streamSharedReplyMatches(streamSharedReply *r, stream *s, streamID *start, long long count, int resp) {
+    return r->s == s && r->length == s->length && r->entries_added == s->entries_added &&
+           streamCompareID(&r->last_id, &s->last_id) == 0 && streamCompareID(&r->first_id, &s->first_id) == 0 &&
+           streamCompareID(&r->max_deleted_entry_id, &s->max_deleted_entry_id) == 0 &&
+           streamCompareID(&r->start, start) == 0 && r->count == count && r->resp == resp;
+}
+
+/* Replies with the entries of 's' starting at 'start' for XREAD, like
+ * streamReplyWithRange() does, sharing the encoded range with the other
+ * clients served in the same pass, if any. */
+static void xreadReplyWithRange(client *c, stream *s, streamID *start, long long count) {
+    if (!streamSharedReplies.active) {
+        streamReplyWithRange(c, s, start, NULL, count, 0, NULL, NULL, 0, NULL);
+        return;
+    }
+
+    for (int j = 0; j < streamSharedReplies.len; j++) {
+        streamSharedReply *r = &streamSharedReplies.replies[j];
+        if (streamSharedReplyMatches(r, s, start, count, c->resp)) {
+            addReplyProto(c, r->proto, sdslen(r->proto));
+            return;
+        }
+    }
+
+    client *recording_client = createCachedResponseClient(c->resp);
+    streamReplyWithRange(recording_client, s, start, NULL, count, 0, NULL, NULL, 0, NULL);
+    sds proto = aggregateClientOutputBuffer(recording_client);
+    deleteCachedResponseClient(recording_client);
+    addReplyProto(c, proto, sdslen(proto));
+
+    if (streamSharedReplies.len == STREAM_SHARED_REPLIES_MAX) {
+        sdsfree(proto);
+        return;
+    }
+    streamSharedReply *r = &streamSharedReplies.replies[streamSharedReplies.len++];
+    r->s = s;
+    r->length = s->length;
+    r->entries_added = s->entries_added;
+    r->last_id = s->last_id;
+    r->first_id = s->first_id;
+    r->max_deleted_entry_id = s->max_deleted_entry_id;
+    r->start = *start;
+    r->count = count;
+    r->resp = c->resp;
+    r->proto = proto;
+}
+
+/* Returns 0 if the XREAD or XREADGROUP command of the client 'c', blocked on
+ * the stream 's' stored at 'key', has no new entries to read from it, so that
+ * re-executing it would just block the client again. When in doubt 1 is
+ * returned, and re-executing the command takes care of the rest. */
+int streamHasNewEntriesForClient(client *c, robj *key, stream *s) {
+    if (c->cmd->proc != xreadCommand) return 1;
+
+    robj *groupname = NULL;
+    int streams_arg = 0;
+    for (int i = 1; i < c->argc && !streams_arg; i++) {
+        int moreargs = c->argc - i - 1;
+        char *o = c->argv[i]->ptr;
+        if ((!strcasecmp(o, "BLOCK") || !strcasecmp(o, "COUNT")) && moreargs) {
+            i++;
+        } else if (!strcasecmp(o, "GROUP") && moreargs >= 2) {
+            groupname = c->argv[i + 1];
+            i += 2;
+        } else if (!strcasecmp(o, "STREAMS") && moreargs) {
+            streams_arg = i + 1;
+        }
+    }
+    if (!streams_arg) return 1;
+
+    int streams_count = (c->argc - streams_arg) / 2, found = 0;
+    for (int j = 0; j < streams_count; j++) {
+        if (!equalStringObjects(c->argv[streams_arg + j], key)) continue;
+        robj *idarg = c->argv[streams_arg + streams_count + j];
+        streamID id;
+        if (groupname) {
+            /* Only the special ">" ID blocks, other IDs read the history. */
+            streamCG *group;
+            if (strcmp(idarg->ptr, ">") || (group = streamLookupCG(s, groupname->ptr)) == NULL) return 1;
+            id = group->last_id;
+        } else if (streamParseStrictIDOrReply(NULL, idarg, &id, 0, NULL) != C_OK) {
+            return 1;
+        }
+        if (streamCompareID(&s->last_id, &id) > 0) return 1;
+        found = 1;
+    }
+    return !found;
+}
+
 /* XREAD [BLOCK <milliseconds>] [COUNT <count>] STREAMS key_1 key_2 ... key_N
  *       ID_1 ID_2 ... ID_N
  *
@@ -2336,6 +2509,9 @@ void xreadCommand(client *c) {
                     *gt = *last;
                 }
             }
+            /* Serving the group changes its state, even if no entry is
+             * delivered: the consumer is created or seen. */
+            dbKeyWillChange(c->db, c->argv[streams_arg + i]);
             consumer = streamLookupConsumer(groups[i], consumername->ptr);
             if (consumer == NULL) {
                 consumer = streamCreateConsumer(groups[i], consumername->ptr, c->argv[streams_arg + i], c->db->id,
@@ -2370,7 +2546,10 @@ void xreadCommand(client *c) {
             int flags = 0;
             if (noack) flags |= STREAM_RWR_NOACK;
             if (serve_history) flags |= STREAM_RWR_HISTORY;
-            streamReplyWithRange(c, s, &start, NULL, count, 0, groups ? groups[i] : NULL, consumer, flags, &spi);
+            if (groups)
+                streamReplyWithRange(c, s, &start, NULL, count, 0, groups[i], consumer, flags, &spi);
+            else
+                xreadReplyWithRange(c, s, &start, count);
             if (groups) server.dirty++;
         }
     }
@@ -2442,14 +2621,24 @@ void streamFreeNACK(streamNACK *na) {
     zfree(na);
 }
 
+/* Return the NACK of the pending entry with the big endian ID 'rawid' of a
+ * consumer of the group 'cg'. Consumer PELs only hold the IDs, the NACK is
+ * referenced by the group PEL. */
+streamNACK *streamLookupNACK(streamCG *cg, unsigned char *rawid) {
+    void *nack;
+    int found = raxFind(cg->pel, rawid, sizeof(streamID), &nack);
+    serverAssert(found);
+    return nack;
+}
+
 /* Free a consumer and associated data structures. Note that this function
  * will not reassign the pending messages associated with this consumer
  * nor will delete them from the stream, so when this function is called
  * to delete a consumer, and not when the whole stream is destroyed, the caller
  * should do some work before. */
 void streamFreeConsumer(streamConsumer *sc) {
-    raxFree(sc->pel); /* No value free callback: the PEL entries are shared
-                         between the consumer and the main stream PEL. */
+    raxFree(sc->pel); /* No value free callback: the consumer PEL only holds
+                         the IDs, the NACKs belong to the group PEL. */
     sdsfree(sc->name);
     zfree(sc);
 }
@@ -2526,8 +2715,8 @@ void streamDelConsumer(streamCG *cg, streamConsumer *consumer) {
     raxStart(&ri, consumer->pel);
     raxSeek(&ri, "^", NULL, 0);
     while (raxNext(&ri)) {
-        streamNACK *nack = ri.data;
-        raxRemove(cg->pel, ri.key, ri.key_len, NULL);
+        void *nack;
+        raxRemove(cg->pel, ri.key, ri.key_len, &nack);
         streamFreeNACK(nack);
     }
     raxStop(&ri);
@@ -2795,6 +2984,7 @@ void xackCommand(client *c) {
         addReply(c, shared.czero);
         return;
     }
+    dbKeyWillChange(c->db, c->argv[1]);
 
     /* Start parsing the IDs, so that we abort ASAP if there is a syntax
      * error: the return value of this command cannot be an error in case
@@ -2977,7 +3167,7 @@ void xpendingCommand(client *c) {
         size_t arraylen = 0;
 
         while (count && raxNext(&ri) && memcmp(ri.key, endkey, ri.key_len) <= 0) {
-            streamNACK *nack = ri.data;
+            streamNACK *nack = consumer ? streamLookupNACK(group, ri.key) : ri.data;
 
             if (minidle) {
                 mstime_t this_idle = now - nack->delivery_time;
@@ -3176,6 +3366,7 @@ void xclaimCommand(client *c) {
     }
 
     /* Do the actual claiming. */
+    dbKeyWillChange(c->db, c->argv[1]);
     streamConsumer *consumer = streamLookupConsumer(group, c->argv[3]->ptr);
     if (consumer == NULL) {
         consumer = streamCreateConsumer(group, c->argv[3]->ptr, c->argv[1], c->db->id, SCC_DEFAULT);
@@ -3249,7 +3440,7 @@ void xclaimCommand(client *c) {
             }
             if (nack->consumer != consumer) {
                 /* Add the entry in the new consumer local PEL. */
-                raxInsert(consumer->pel, buf, sizeof(buf), nack, NULL);
+                raxInsert(consumer->pel, buf, sizeof(buf), NULL, NULL);
                 nack->consumer = consumer;
             }
             /* Send the reply for this entry. */
@@ -3355,6 +3546,7 @@ void xautoclaimCommand(client *c) {
     }
 
     /* Do the actual claiming. */
+    dbKeyWillChange(c->db, c->argv[1]);
     streamConsumer *consumer = streamLookupConsumer(group, c->argv[3]->ptr);
     if (consumer == NULL) {
         consumer = streamCreateConsumer(group, c->argv[3]->ptr, c->argv[1], c->db->id, SCC_DEFAULT);
@@ -3418,7 +3610,7 @@ void xautoclaimCommand(client *c) {
 
         if (nack->consumer != consumer) {
             /* Add the entry in the new consumer local PEL. */
-            raxInsert(consumer->pel, ri.key, ri.key_len, nack, NULL);
+            raxInsert(consumer->pel, ri.key, ri.key_len, NULL, NULL);
             nack->consumer = consumer;
         }
 
@@ -3759,7 +3951,7 @@ void xinfoReplyWithStreamInfo(client *c, stream *s) {
                     raxStart(&ri_cpel, consumer->pel);
                     raxSeek(&ri_cpel, "^", NULL, 0);
                     while (raxNext(&ri_cpel) && (!count || arraylen_cpel < count)) {
-                        streamNACK *nack = ri_cpel.data;
+                        streamNACK *nack = streamLookupNACK(cg, ri_cpel.key);
                         addReplyArrayLen(c, 3);
 
                         /* Entry ID. */
@@ -189,6 +189,44 @@ zskiplistNode *zslInsert(zskiplist *zsl, double score, sds ele) {
     return x;
 }
 
+/* Insert a new node at the tail of the skiplist, for callers building a
+ * skiplist out of elements that are already sorted, which is cheaper than
+ * searching for the insert position of every element with zslInsert().
+ * 'tail' holds the last node at every level: before the first call it must be
+ * set to zsl->header at all the ZSKIPLIST_MAXLEVEL levels, and the skiplist
+ * must not be modified by other means between calls. The caller guarantees
+ * that the new element sorts after all the others. The skiplist takes
+ * ownership of the passed SDS string 'ele'. */
+zskiplistNode *zslInsertTail(zskiplist *zsl, zskiplistNode **tail, double score, sds ele) {
+    zskiplistNode *x;
+    int i, level;
+
+    serverAssert(!isnan(score));
+    level = zslRandomLevel();
+    if (level > zsl->level) {
+        for (i = zsl->level; i < level; i++) zsl->header->level[i].span = zsl->length;
+        zsl->level = level;
+    }
+    x = zslCreateNode(level, score, ele);
+    x->backward = (tail[0] == zsl->header) ? NULL : tail[0];
+
+    /* The span of the last node at every level is the number of nodes after
+     * it, so it grows by one on every level, and on the levels of the new
+     * node it now reaches the new node. */
+    for (i = 0; i < level; i++) {
+        tail[i]->level[i].forward = x;
+        tail[i]->level[i].span++;
+        x->level[i].forward = NULL;
+        x->level[i].span = 0;
+        tail[i] = x;
+    }
+    for (i = level; i < zsl->level; i++) tail[i]->level[i].span++;
+
+    zsl->tail = x;
+    zsl->length++;
+    return x;
+}
+
 /* Internal function used by zslDelete, zslDeleteRangeByScore and
  * zslDeleteRangeByRank. */
 void zslDeleteNode(zskiplist *zsl, zskiplistNode *x, zskiplistNode **update) {
@@ -1049,29 +1087,22 @@ unsigned char *zzlDelete(unsigned char *zl, unsigned char *eptr) {
 }
 
 unsigned char *zzlInsertAt(unsigned char *zl, unsigned char *eptr, sds ele, double score) {
-    unsigned char *sptr;
     char scorebuf[MAX_D2STRING_CHARS];
-    int scorelen = 0;
-    long long lscore;
-    int score_is_long = double2ll(score, &lscore);
-    if (!score_is_long) scorelen = d2string(scorebuf, sizeof(scorebuf), score);
-    if (eptr == NULL) {
-        zl = lpAppend(zl, (unsigned char *)ele, sdslen(ele));
-        if (score_is_long)
-            zl = lpAppendInteger(zl, lscore);
-        else
-            zl = lpAppend(zl, (unsigned char *)scorebuf, scorelen);
+    listpackEntry entries[2];
+
+    /* Member and score are inserted with a single call, so that the tail of
+     * the listpack is moved only once. */
+    entries[0].sval = (unsigned char *)ele;
+    entries[0].slen = sdslen(ele);
+    if (double2ll(score, &entries[1].lval)) {
+        entries[1].sval = NULL;
     } else {
-        /* Insert member before the element 'eptr'. */
-        zl = lpInsertString(zl, (unsigned char *)ele, sdslen(ele), eptr, LP_BEFORE, &sptr);
-
-        /* Insert score after the member. */
-        if (score_is_long)
-            zl = lpInsertInteger(zl, lscore, sptr, LP_AFTER, NULL);
-        else
-            zl = lpInsertString(zl, (unsigned char *)scorebuf, scorelen, sptr, LP_AFTER, NULL);
+        entries[1].sval = (unsigned char *)scorebuf;
+        entries[1].slen = d2string(scorebuf, sizeof(scorebuf), score);
     }
-    return zl;
+    if (eptr == NULL) return lpBatchAppend(zl, entries, 2);
+    /* Insert member and score before the element 'eptr'. */
+    return lpBatchInsert(zl, eptr, LP_BEFORE, entries, 2, NULL);
 }
 
 /* Insert (element,score) pair in listpack. This function assumes the element is
@@ -2352,6 +2383,41 @@ inline static void zunionInterAggregate(double *target, double val, int aggregat
     }
 }
 
+/* An element of a ZUNION/ZINTER result. The elements are collected unsorted
+ * and sorted once at the end, so that the resulting sorted set can be built,
+ * or replied to the client, in a single ordered pass. */
+typedef struct {
+    sds ele;
+    double score;
+    dictEntry *de; /* Entry of 'ele' in the dict accumulating a union, or NULL. */
+} zsetopres;
+
+/* Order results like the skiplist does: by score, then by element. */
+static int zsetopresCompare(const void *a, const void *b) {
+    const zsetopres *r1 = a, *r2 = b;
+    if (r1->score < r2->score) return -1;
+    if (r1->score > r2->score) return 1;
+    return sdscmp(r1->ele, r2->ele);
+}
+
+/* Build the skiplist of the empty 'zs' out of the sorted results, linking
+ * every node at the tail. The skiplist takes ownership of the elements. The
+ * dict entries of a union are updated to point to the score in the node,
+ * other elements are added to the dict. */
+static void zsetopresToSkiplist(zset *zs, zsetopres *res, size_t len) {
+    zskiplistNode *tail[ZSKIPLIST_MAXLEVEL];
+    for (int i = 0; i < ZSKIPLIST_MAXLEVEL; i++) tail[i] = zs->zsl->header;
+
+    if (len && res[0].de == NULL) dictExpand(zs->dict, len);
+    for (size_t i = 0; i < len; i++) {
+        zskiplistNode *znode = zslInsertTail(zs->zsl, tail, res[i].score, res[i].ele);
+        if (res[i].de)
+            dictSetVal(zs->dict, res[i].de, &znode->score);
+        else
+            dictAdd(zs->dict, res[i].ele, &znode->score);
+    }
+}
+
 static size_t zsetDictGetMaxElementLength(dict *d, size_t *totallen) {
     dictIterator *di;
     dictEntry *de;
@@ -2553,7 +2619,8 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
     size_t maxelelen = 0, totelelen = 0;
     robj *dstobj = NULL;
     zset *dstzset = NULL;
-    zskiplistNode *znode;
+    zsetopres *res = NULL;
+    size_t reslen = 0, rescap = 0;
     int withscores = 0;
     unsigned long cardinality = 0;
     long limit = 0; /* Stop searching after reaching the limit. 0 means unlimited. */
@@ -2707,9 +2774,15 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
                         break;
                     }
                 } else if (j == setnum) {
+                    if (reslen == rescap) {
+                        rescap = rescap ? rescap * 2 : 16;
+                        res = zrealloc(res, sizeof(zsetopres) * rescap);
+                    }
                     tmp = zuiNewSdsFromValue(&zval);
-                    znode = zslInsert(dstzset->zsl, score, tmp);
-                    dictAdd(dstzset->dict, tmp, &znode->score);
+                    res[reslen].ele = tmp;
+                    res[reslen].score = score;
+                    res[reslen].de = NULL;
+                    reslen++;
                     totelelen += sdslen(tmp);
                     if (sdslen(tmp) > maxelelen) maxelelen = sdslen(tmp);
                 }
@@ -2765,14 +2838,15 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
             zuiClearIterator(&src[i]);
         }
 
-        /* Step 2: convert the dictionary into the final sorted set. */
+        /* Step 2: collect the elements with their aggregated scores, so they
+         * can be sorted below. */
+        res = zmalloc(sizeof(zsetopres) * dictSize(dstzset->dict));
         di = dictGetIterator(dstzset->dict);
-
         while ((de = dictNext(di)) != NULL) {
-            sds ele = dictGetKey(de);
-            score = dictGetDoubleVal(de);
-            znode = zslInsert(dstzset->zsl, score, ele);
-            dictSetVal(dstzset->dict, de, &znode->score);
+            res[reslen].ele = dictGetKey(de);
+            res[reslen].score = dictGetDoubleVal(de);
+            res[reslen].de = de;
+            reslen++;
         }
         dictReleaseIterator(di);
     } else if (op == SET_OP_DIFF) {
@@ -2781,8 +2855,31 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
         serverPanic("Unknown operator");
     }
 
+    /* Sort the union or intersection once, instead of inserting every element
+     * in the skiplist at a random position. The result is then built in order,
+     * directly as a listpack when it is small enough, or just replied. */
+    if (op != SET_OP_DIFF && !cardinality_only) {
+        qsort(res, reslen, sizeof(zsetopres), zsetopresCompare);
+        if (dstkey && reslen <= server.zset_max_listpack_entries && maxelelen <= server.zset_max_listpack_value &&
+            lpSafeToAdd(NULL, totelelen)) {
+            /* The dict of a union doesn't own its keys, so they are freed
+             * after the dict. */
+            decrRefCount(dstobj);
+            dstobj = createZsetListpackObject();
+            dstzset = NULL;
+            for (size_t k = 0; k < reslen; k++) {
+                dstobj->ptr = zzlInsertAt(dstobj->ptr, NULL, res[k].ele, res[k].score);
+                sdsfree(res[k].ele);
+            }
+            reslen = 0;
+        } else if (dstkey) {
+            zsetopresToSkiplist(dstzset, res, reslen);
+            reslen = 0;
+        }
+    }
+
     if (dstkey) {
-        if (dstzset->zsl->length) {
+        if (zsetLength(dstobj)) {
             zsetConvertToListpackIfNeeded(dstobj, maxelelen, totelelen);
             setKey(c, c->db, dstkey, dstobj, 0);
             addReplyLongLong(c, zsetLength(dstobj));
@@ -2802,9 +2899,10 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
     } else if (cardinality_only) {
         addReplyLongLong(c, cardinality);
     } else {
-        unsigned long length = dstzset->zsl->length;
-        zskiplist *zsl = dstzset->zsl;
-        zskiplistNode *zn = zsl->header->level[0].forward;
+        /* ZDIFF replies from the skiplist, ZUNION and ZINTER from the sorted
+         * results, which were never turned into a skiplist. */
+        unsigned long length = (op == SET_OP_DIFF) ? dstzset->zsl->length : reslen;
+        zskiplistNode *zn = dstzset->zsl->header->level[0].forward;
         /* In case of WITHSCORES, respond with a single array in RESP2, and
          * nested arrays in RESP3. We can't use a map response type since the
          * client library needs to know to respect the order. */
@@ -2813,14 +2911,19 @@ void zunionInterDiffGenericCommand(client *c, robj *dstkey, int numkeysIndex, in
         else
             addReplyArrayLen(c, length);
 
-        while (zn != NULL) {
+        for (unsigned long k = 0; k < length; k++) {
+            sds ele = (op == SET_OP_DIFF) ? zn->ele : res[k].ele;
+            double score = (op == SET_OP_DIFF) ? zn->score : res[k].score;
             if (withscores && c->resp > 2) addReplyArrayLen(c, 2);
-            addReplyBulkCBuffer(c, zn->ele, sdslen(zn->ele));
-            if (withscores) addReplyDouble(c, zn->score);
-            zn = zn->level[0].forward;
+            addReplyBulkCBuffer(c, ele, sdslen(ele));
+            if (withscores) addReplyDouble(c, score);
+            if (op == SET_OP_DIFF) zn = zn->level[0].forward;
         }
         server.lazyfree_lazy_server_del ? freeObjAsync(NULL, dstobj, -1) : decrRefCount(dstobj);
     }
+    /* Elements of the results that didn't move into a sorted set. */
+    for (size_t k = 0; k < reslen; k++) sdsfree(res[k].ele);
+    zfree(res);
     zfree(src);
 }
 
@@ -3034,8 +3137,77 @@ static void zrangeResultHandlerDestinationKeySet(zrange_result_handler *handler,
     handler->dstkey = dstkey;
 }
 
-/* This command implements ZRANGE, ZREVRANGE. */
+/* Position of a ZRANGE/ZREVRANGE by rank in the sorted set, and elements left
+ * to emit. The reply of big ranges can be generated incrementally, so the
+ * cursor keeps its own copy of the result handler. */
+typedef struct zrangeRankCursor {
+    zrange_result_handler handler;
+    robj *zobj;
+    unsigned char *eptr, *sptr; /* Listpack encoding. */
+    zskiplistNode *ln;          /* Skiplist encoding. */
+    long remaining;
+    int withscores;
+    int reverse;
+} zrangeRankCursor;
+
+/* Emits up to 'count' elements of the range, returns 1 once the whole range
+ * was emitted. */
+static int zrangeRankCursorEmit(zrangeRankCursor *cur, long count) {
+    zrange_result_handler *handler = &cur->handler;
+    client *c = handler->client;
+    robj *zobj = cur->zobj;
+
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *zl = zobj->ptr;
+        unsigned char *vstr;
+        unsigned int vlen;
+        long long vlong;
+        double score = 0.0;
+
+        while (cur->remaining && count--) {
+            serverAssertWithInfo(c, zobj, cur->eptr != NULL && cur->sptr != NULL);
+            vstr = lpGetValue(cur->eptr, &vlen, &vlong);
+
+            if (cur->withscores) /* don't bother to extract the score if it's gonna be ignored. */
+                score = zzlGetScore(cur->sptr);
+
+            if (vstr == NULL) {
+                handler->emitResultFromLongLong(handler, vlong, score);
+            } else {
+                handler->emitResultFromCBuffer(handler, vstr, vlen, score);
+            }
+
+            /* Don't step past the last element, there may be none. */
+            if (--cur->remaining == 0) break;
+            if (cur->reverse)
+                zzlPrev(zl, &cur->eptr, &cur->sptr);
+            else
+                zzlNext(zl, &cur->eptr, &cur->sptr);
+        }
+    } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
+        while (cur->remaining && count--) {
+            serverAssertWithInfo(c, zobj, cur->ln != NULL);
+            sds ele = cur->ln->ele;
+            handler->emitResultFromCBuffer(handler, ele, sdslen(ele), cur->ln->score);
+            cur->ln = cur->reverse ? cur->ln->backward : cur->ln->level[0].forward;
+            cur->remaining--;
+        }
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+    return cur->remaining == 0;
+}
+
+static int zrangeRankReplyGeneratorProc(client *c, replyGenerator *gen, long count) {
+    UNUSED(c);
+    return zrangeRankCursorEmit(gen->state, count);
+}
+
+/* This command implements ZRANGE, ZREVRANGE. 'key' is the key of 'zobj' when
+ * the range is sent to the client, so that a big reply can be emitted
+ * incrementally, NULL otherwise. */
 void genericZrangebyrankCommand(zrange_result_handler *handler,
+                                robj *key,
                                 robj *zobj,
                                 long start,
                                 long end,
@@ -3045,6 +3217,7 @@ void genericZrangebyrankCommand(zrange_result_handler *handler,
     long llen;
     long rangelen;
     size_t result_cardinality;
+    zrangeRankCursor cur;
 
     /* Sanitize indexes. */
     llen = zsetLength(zobj);
@@ -3065,65 +3238,47 @@ void genericZrangebyrankCommand(zrange_result_handler *handler,
     result_cardinality = rangelen;
 
     handler->beginResultEmission(handler, rangelen);
+    cur.handler = *handler;
+    cur.zobj = zobj;
+    cur.remaining = rangelen;
+    cur.withscores = withscores;
+    cur.reverse = reverse;
     if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
         unsigned char *zl = zobj->ptr;
-        unsigned char *eptr, *sptr;
-        unsigned char *vstr;
-        unsigned int vlen;
-        long long vlong;
-        double score = 0.0;
 
         if (reverse)
-            eptr = lpSeek(zl, -2 - (2 * start));
+            cur.eptr = lpSeek(zl, -2 - (2 * start));
         else
-            eptr = lpSeek(zl, 2 * start);
-
-        serverAssertWithInfo(c, zobj, eptr != NULL);
-        sptr = lpNext(zl, eptr);
-
-        while (rangelen--) {
-            serverAssertWithInfo(c, zobj, eptr != NULL && sptr != NULL);
-            vstr = lpGetValue(eptr, &vlen, &vlong);
-
-            if (withscores) /* don't bother to extract the score if it's gonna be ignored. */
-                score = zzlGetScore(sptr);
-
-            if (vstr == NULL) {
-                handler->emitResultFromLongLong(handler, vlong, score);
-            } else {
-                handler->emitResultFromCBuffer(handler, vstr, vlen, score);
-            }
-
-            if (reverse)
-                zzlPrev(zl, &eptr, &sptr);
-            else
-                zzlNext(zl, &eptr, &sptr);
-        }
+            cur.eptr = lpSeek(zl, 2 * start);
 
+        serverAssertWithInfo(c, zobj, cur.eptr != NULL);
+        cur.sptr = lpNext(zl, cur.eptr);
     } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
         zset *zs = zobj->ptr;
         zskiplist *zsl = zs->zsl;
-        zskiplistNode *ln;
 
         /* Check if starting point is trivial, before doing log(N) lookup. */
         if (reverse) {
-            ln = zsl->tail;
-            if (start > 0) ln = zslGetElementByRank(zsl, llen - start);
+            cur.ln = zsl->tail;
+            if (start > 0) cur.ln = zslGetElementByRank(zsl, llen - start);
         } else {
-            ln = zsl->header->level[0].forward;
-            if (start > 0) ln = zslGetElementByRank(zsl, start + 1);
-        }
-
-        while (rangelen--) {
-            serverAssertWithInfo(c, zobj, ln != NULL);
-            sds ele = ln->ele;
-            handler->emitResultFromCBuffer(handler, ele, sdslen(ele), ln->score);
-            ln = reverse ? ln->backward : ln->level[0].forward;
+            cur.ln = zsl->header->level[0].forward;
+            if (start > 0) cur.ln = zslGetElementByRank(zsl, start + 1);
         }
     } else {
         serverPanic("Unknown sorted set encoding");
     }
 
+    /* The length was emitted upfront, so the client handler doesn't need to
+     * be finalized, and the elements can follow later. */
+    if (key && handler->type == ZRANGE_CONSUMER_TYPE_CLIENT && replyGeneratorAllowed(c, rangelen)) {
+        zrangeRankCursor *state = zmalloc(sizeof(*state));
+        *state = cur;
+        addReplyGenerator(c, key, zobj, zrangeRankReplyGeneratorProc, state, zfree);
+        return;
+    }
+
+    zrangeRankCursorEmit(&cur, rangelen);
     handler->finalizeResultEmission(handler, result_cardinality);
 }
 
@@ -3664,7 +3819,7 @@ void zrangeGenericCommand(zrange_result_handler *handler,
     switch (rangetype) {
     case ZRANGE_AUTO:
     case ZRANGE_RANK:
-        genericZrangebyrankCommand(handler, zobj, opt_start, opt_end, opt_withscores || store,
+        genericZrangebyrankCommand(handler, store ? NULL : key, zobj, opt_start, opt_end, opt_withscores || store,
                                    direction == ZRANGE_DIRECTION_REVERSE);
         break;
 
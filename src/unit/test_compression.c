@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../compression.h"
+#include "../zmalloc.h"
+
+#include "test_help.h"
+
+/* Fill 'buf' with text made of a few words, that compresses well. */
+static void fillText(unsigned char *buf, size_t len) {
+    static const char *words[] = {"valkey ", "list ", "string ", "replica ", "snapshot "};
+    size_t pos = 0;
+    while (pos < len) {
+        const char *w = words[rand() % 5];
+        size_t wlen = strlen(w);
+        if (wlen > len - pos) wlen = len - pos;
+        memcpy(buf + pos, w, wlen);
+        pos += wlen;
+    }
+}
+
+int test_compressionRoundTrip(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    static const size_t sizes[] = {1, 13, 64, 1000, 65536, 300000};
+    for (int codec = 0; codec < COMPRESSION_CODEC_COUNT; codec++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            size_t len = sizes[i];
+            unsigned char *in = zmalloc(len), *out = zmalloc(len), *back = zmalloc(len);
+
+            /* Compressible data round trips. */
+            fillText(in, len);
+            size_t clen = compressionCompress(codec, in, len, out, len);
+            if (len >= 1000) TEST_ASSERT(clen > 0 && clen < len / 2);
+            if (clen) {
+                TEST_ASSERT(compressionDecompress(codec, out, clen, back, len) == len);
+                TEST_ASSERT(memcmp(in, back, len) == 0);
+                /* The output buffer is too small for the data. */
+                TEST_ASSERT(compressionDecompress(codec, out, clen, back, len - 1) == 0);
+            }
+
+            /* Random data does not fit in fewer bytes. */
+            for (size_t j = 0; j < len; j++) in[j] = rand();
+            if (len > 1) TEST_ASSERT(compressionCompress(codec, in, len, out, len - 1) == 0);
+
+            zfree(in);
+            zfree(out);
+            zfree(back);
+        }
+    }
+    return 0;
+}
+
+int test_compressionLz4Format(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    /* A block produced by the reference LZ4 library. */
+    const char *text = "Valkey Valkey Valkey Valkey Valkey Valkey Valkey Valkey, lists and strings.";
+    const unsigned char block[] = "\x7f\x56\x61\x6c\x6b\x65\x79\x20\x07\x00\x1d\xf0\x05\x2c\x20\x6c\x69"
+                                  "\x73\x74\x73\x20\x61\x6e\x64\x20\x73\x74\x72\x69\x6e\x67\x73\x2e";
+    size_t len = strlen(text), blocklen = sizeof(block) - 1;
+    char out[128];
+
+    TEST_ASSERT(compressionDecompress(COMPRESSION_CODEC_LZ4, block, blocklen, out, sizeof(out)) == len);
+    TEST_ASSERT(memcmp(out, text, len) == 0);
+
+    /* Our own block decompresses to the same text. */
+    unsigned char ours[128];
+    size_t ourlen = compressionCompress(COMPRESSION_CODEC_LZ4, text, len, ours, len - 1);
+    TEST_ASSERT(ourlen > 0);
+    TEST_ASSERT(compressionDecompress(COMPRESSION_CODEC_LZ4, ours, ourlen, out, sizeof(out)) == len);
+    TEST_ASSERT(memcmp(out, text, len) == 0);
+
+    /* Truncated blocks are rejected, or decode to a prefix of the text when
+     * they end where a sequence does. Offsets before the start of the output
+     * are rejected. */
+    for (size_t i = 1; i < blocklen; i++) {
+        size_t outlen = compressionDecompress(COMPRESSION_CODEC_LZ4, block, i, out, sizeof(out));
+        TEST_ASSERT(outlen < len && memcmp(out, text, outlen) == 0);
+    }
+    unsigned char bad[sizeof(block)];
+    memcpy(bad, block, sizeof(block));
+    bad[8] = 0x10;
+    TEST_ASSERT(compressionDecompress(COMPRESSION_CODEC_LZ4, bad, blocklen, out, sizeof(out)) == 0);
+    return 0;
+}
@@ -26,5 +26,10 @@ int test_crc64(int argc, char **argv, int flags) {
 
     TEST_ASSERT_MESSAGE("[calcula]: CRC64 TEXT'", (uint64_t)_crc64(0, li, sizeof(li)) == 14373597793578550195ull);
     TEST_ASSERT_MESSAGE("[calcula]: CRC64 TEXT", (uint64_t)crc64(0, li, sizeof(li)) == 14373597793578550195ull);
+
+    uint64_t prefix = crc64(0, li, 100);
+    TEST_ASSERT_MESSAGE("[calcula]: CRC64 suffix",
+                        crc64_suffix(prefix, crc64(prefix, li + 100, sizeof(li) - 100), sizeof(li) - 100) ==
+                            crc64(0, li + 100, sizeof(li) - 100));
     return 0;
 }
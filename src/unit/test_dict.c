@@ -235,6 +235,147 @@ int test_dictDeleteOneKeyTriggerResizeAgain(int argc, char **argv, int flags) {
     return 0;
 }
 
+static void scanCursorPassedCallback(void *privdata, const dictEntry *de) {
+    char *visited = privdata;
+    visited[strtol(dictGetKey(de), NULL, 10)] = 1;
+}
+
+int test_dictScanCursorPassed(int argc, char **argv, int flags) {
+    /* While the table can't change in size, a key is behind the cursor
+     * exactly when dictScan() already returned it. */
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    long count = 1000;
+    char visited[1000] = {0};
+    dict *d = dictCreate(&BenchmarkDictType);
+    dictSetResizeEnabled(DICT_RESIZE_ENABLE);
+    for (j = 0; j < count; j++) {
+        retval = dictAdd(d, stringFromLongLong(j), (void *)j);
+        TEST_ASSERT(retval == DICT_OK);
+    }
+    while (dictIsRehashing(d)) dictRehashMicroseconds(d, 1000);
+    dictPauseRehashing(d);
+    dictPauseAutoResize(d);
+
+    unsigned long cursor = 0;
+    do {
+        cursor = dictScan(d, cursor, scanCursorPassedCallback, visited);
+        if (cursor == 0) break;
+        for (j = 0; j < count; j++) {
+            char *key = stringFromLongLong(j);
+            TEST_ASSERT(dictScanCursorPassed(d, cursor, key) == visited[j]);
+            zfree(key);
+        }
+    } while (1);
+    for (j = 0; j < count; j++) TEST_ASSERT(visited[j]);
+
+    dictResumeAutoResize(d);
+    dictResumeRehashing(d);
+    dictRelease(d);
+    return 0;
+}
+
+static void segmentedScanCallback(void *privdata, const dictEntry *de) {
+    char *visited = privdata;
+    visited[strtol(dictGetKey(de), NULL, 10)] = 1;
+}
+
+static unsigned long countAllocatedSegments(dict *d, int htidx) {
+    unsigned long allocated = 0;
+    if (!dictTableIsSegmented(d->ht_size_exp[htidx])) return 0;
+    for (unsigned long s = 0; s < DICTHT_SIZE(d->ht_size_exp[htidx]) >> DICT_SEGMENT_EXP; s++) {
+        if (dictTableSegments(d, htidx)[s]) allocated++;
+    }
+    return allocated;
+}
+
+int test_dictSegmentedRehash(int argc, char **argv, int flags) {
+    /* Large tables are segmented: the old table's segments are released as
+     * the rehashing moves past them, and the new table's segments are only
+     * allocated when keys are moved there. */
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    long count = 200000, extra = 1000;
+    char *visited = zcalloc(count + extra);
+    dict *d = dictCreate(&BenchmarkDictType);
+    dictSetResizeEnabled(DICT_RESIZE_ENABLE);
+    for (j = 0; j < count; j++) {
+        retval = dictAdd(d, stringFromLongLong(j), (void *)j);
+        TEST_ASSERT(retval == DICT_OK);
+    }
+    while (dictIsRehashing(d)) dictRehash(d, 1000);
+    TEST_ASSERT(dictTableIsSegmented(d->ht_size_exp[0]));
+    TEST_ASSERT(countAllocatedSegments(d, 0) == DICTHT_SIZE(d->ht_size_exp[0]) >> DICT_SEGMENT_EXP);
+
+    /* Expand, checking the memory held by both tables while rehashing. */
+    TEST_ASSERT(dictExpand(d, DICTHT_SIZE(d->ht_size_exp[0]) * 2) == DICT_OK);
+    TEST_ASSERT(dictIsRehashing(d));
+    TEST_ASSERT(countAllocatedSegments(d, 1) == 0);
+    while (dictIsRehashing(d) && (unsigned long)d->rehashidx < DICTHT_SIZE(d->ht_size_exp[0]) / 2) {
+        dictRehash(d, 100);
+        unsigned long passed = d->rehashidx >> DICT_SEGMENT_EXP;
+        for (unsigned long s = 0; s < passed; s++) TEST_ASSERT(dictTableSegments(d, 0)[s] == NULL);
+        TEST_ASSERT(countAllocatedSegments(d, 1) <= 2 * (passed + 1));
+    }
+    TEST_ASSERT(dictIsRehashing(d));
+
+    /* Keys added in the middle of the rehashing, and all the others, are
+     * found by lookups and by a full scan. */
+    for (j = count; j < count + extra; j++) {
+        retval = dictAdd(d, stringFromLongLong(j), (void *)j);
+        TEST_ASSERT(retval == DICT_OK);
+    }
+    unsigned long cursor = 0;
+    do {
+        cursor = dictScan(d, cursor, segmentedScanCallback, visited);
+    } while (cursor != 0);
+    for (j = 0; j < count + extra; j++) TEST_ASSERT(visited[j]);
+    for (j = 0; j < count + extra; j++) {
+        char *key = stringFromLongLong(j);
+        TEST_ASSERT(dictFind(d, key) != NULL);
+        zfree(key);
+    }
+
+    /* Delete everything, shrinking through segmented tables again. */
+    for (j = 0; j < count + extra; j++) {
+        char *key = stringFromLongLong(j);
+        retval = dictDelete(d, key);
+        TEST_ASSERT(retval == DICT_OK);
+        zfree(key);
+    }
+    TEST_ASSERT(dictSize(d) == 0);
+
+    zfree(visited);
+    dictRelease(d);
+    return 0;
+}
+
+int test_dictTryExpandSegmented(int argc, char **argv, int flags) {
+    /* dictTryExpand() allocates all the segments upfront, so that a failure
+     * is reported right away, and refuses sizes that can't be satisfied. */
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    dict *d = dictCreate(&BenchmarkDictType);
+    TEST_ASSERT(dictTryExpand(d, 1UL << 58) == DICT_ERR);
+    TEST_ASSERT(dictTryExpand(d, DICT_SEGMENT_SIZE * 4) == DICT_OK);
+    TEST_ASSERT(dictTableIsSegmented(d->ht_size_exp[0]));
+    TEST_ASSERT(countAllocatedSegments(d, 0) == DICTHT_SIZE(d->ht_size_exp[0]) >> DICT_SEGMENT_EXP);
+    for (j = 0; j < 1000; j++) {
+        retval = dictAdd(d, stringFromLongLong(j), (void *)j);
+        TEST_ASSERT(retval == DICT_OK);
+    }
+    TEST_ASSERT(dictSize(d) == 1000);
+
+    dictRelease(d);
+    return 0;
+}
+
 int test_dictBenchmark(int argc, char **argv, int flags) {
     long j;
     long long start, elapsed;
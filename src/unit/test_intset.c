@@ -236,6 +236,67 @@ int test_intsetStressAddDelete(int argc, char **argv, int flags) {
     return 0;
 }
 
+int test_intsetSearchFrom(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    intset *is = intsetNew();
+    uint32_t pos = 0;
+    TEST_ASSERT(!intsetSearchFrom(is, 5, &pos));
+    TEST_ASSERT(pos == 0);
+    zfree(is);
+
+    /* Look up ascending values with a shared cursor and compare against
+     * intsetSearch(), for dense and sparse lookups and all encodings. */
+    for (int bits = 16; bits <= 48; bits += 16) {
+        for (int stride = 1; stride <= 1000; stride *= 10) {
+            is = createSet(bits, 2000);
+            TEST_ASSERT(checkConsistency(is) == 1);
+            int64_t max = _intsetGet(is, intsetLen(is) - 1);
+            pos = 0;
+            for (int64_t v = _intsetGet(is, 0) - 1; v <= max + 1; v += stride) {
+                uint32_t expected;
+                uint8_t found = intsetSearch(is, v, &expected);
+                TEST_ASSERT(intsetSearchFrom(is, v, &pos) == found);
+                TEST_ASSERT(pos == expected);
+            }
+            TEST_ASSERT(!intsetSearchFrom(is, max + 1, &pos));
+            TEST_ASSERT(pos == intsetLen(is));
+            zfree(is);
+        }
+    }
+
+    return 0;
+}
+
+int test_intsetUnion(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    for (int i = 0; i < 100; i++) {
+        intset *a = createSet(i % 2 ? 12 : 40, rand() % 500);
+        intset *b = createSet(12, rand() % 500);
+        intset *expected = intsetNew();
+        for (uint32_t j = 0; j < intsetLen(a); j++) expected = intsetAdd(expected, _intsetGet(a, j), NULL);
+        for (uint32_t j = 0; j < intsetLen(b); j++) expected = intsetAdd(expected, _intsetGet(b, j), NULL);
+
+        intset *u = intsetUnion(a, b);
+        TEST_ASSERT(intsetBlobLen(u) == intsetBlobLen(expected));
+        TEST_ASSERT(memcmp(u, expected, intsetBlobLen(u)) == 0);
+        zfree(u);
+        u = intsetUnion(b, a);
+        TEST_ASSERT(memcmp(u, expected, intsetBlobLen(u)) == 0);
+        zfree(u);
+        zfree(a);
+        zfree(b);
+        zfree(expected);
+    }
+
+    return 0;
+}
+
 #if defined(__GNUC__) && __GNUC__ >= 12
 #pragma GCC diagnostic pop
 #endif
@@ -550,6 +550,62 @@ int test_listpackBatchDelete(int argc, char **argv, int flags) {
     return 0;
 }
 
+int test_listpackBatchInsert(int argc, char **argv, int flags) {
+    /* Batch insert produces the same listpack as single inserts */
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    char big[300];
+    memset(big, 'x', sizeof(big));
+    listpackEntry entries[20];
+    for (int i = 0; i < 20; i++) {
+        if (i % 3 == 0) {
+            entries[i].sval = NULL;
+            entries[i].lval = (long long)i * -123456789;
+        } else {
+            entries[i].sval = (unsigned char *)(i % 3 == 1 ? big : mixlist[i % 4]);
+            entries[i].slen = i % 3 == 1 ? sizeof(big) - i : strlen(mixlist[i % 4]);
+        }
+    }
+
+    /* Insert after the second element of a non empty listpack. */
+    unsigned char *expected = createList();
+    unsigned char *p = lpNext(expected, lpFirst(expected));
+    for (int i = 0; i < 20; i++) {
+        if (entries[i].sval)
+            expected = lpInsertString(expected, entries[i].sval, entries[i].slen, p, LP_AFTER, &p);
+        else
+            expected = lpInsertInteger(expected, entries[i].lval, p, LP_AFTER, &p);
+    }
+    unsigned char *lp = createList(), *newp;
+    lp = lpBatchInsert(lp, lpNext(lp, lpFirst(lp)), LP_AFTER, entries, 20, &newp);
+    TEST_ASSERT(lpLength(lp) == 24);
+    TEST_ASSERT(lpBytes(lp) == lpBytes(expected));
+    TEST_ASSERT(memcmp(lp, expected, lpBytes(lp)) == 0);
+    TEST_ASSERT(lpNext(lp, newp) == lpSeek(lp, 22));
+    TEST_ASSERT(lpValidateIntegrity(lp, lpBytes(lp), 1, NULL, NULL) == 1);
+    lpFree(expected);
+    lpFree(lp);
+
+    /* Append to an empty listpack. */
+    expected = lpNew(0);
+    for (int i = 0; i < 3; i++) {
+        if (entries[i].sval)
+            expected = lpAppend(expected, entries[i].sval, entries[i].slen);
+        else
+            expected = lpAppendInteger(expected, entries[i].lval);
+    }
+    lp = lpBatchAppend(lpNew(0), entries, 3);
+    TEST_ASSERT(lpLength(lp) == 3);
+    TEST_ASSERT(lpBytes(lp) == lpBytes(expected));
+    TEST_ASSERT(memcmp(lp, expected, lpBytes(lp)) == 0);
+    lpFree(expected);
+    lpFree(lp);
+
+    return 0;
+}
+
 int test_listpackDeleteFooWhileIterating(int argc, char **argv, int flags) {
     /* Delete foo while iterating */
     UNUSED(argc);
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include "test_files.h"
 #include "test_help.h"
+#include "../zmalloc.h"
 
 /* We override the default assertion mechanism, so that it prints out info and then dies. */
 void _serverAssert(const char *estr, const char *file, int line) {
@@ -24,6 +25,9 @@ int runTestSuite(struct unitTestSuite *test, int argc, char **argv, int flags) {
     for (int id = 0; test->tests[id].proc != NULL; id++) {
         test_num++;
         int test_result = (test->tests[id].proc(argc, argv, flags) != 0);
+        /* Objects kept in the allocation cache are counted as used memory,
+         * that the next tests expect to start from zero. */
+        zmalloc_cache_release();
         if (!test_result) {
             printf("[" KGRN "ok" KRESET "] - %s:%s\n", test->filename, test->tests[id].name);
         } else {
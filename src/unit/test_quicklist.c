@@ -143,7 +143,7 @@ static int _ql_verify_compress(quicklist *ql) {
                     errors++;
                 }
             } else {
-                if (node->encoding != QUICKLIST_NODE_ENCODING_LZF &&
+                if (!quicklistNodeIsCompressed(node) &&
                     !node->attempted_compress) {
                     TEST_PRINT_INFO("Incorrect non-compression: node %d is NOT "
                                     "compressed at depth %d ((%u, %u); total "
@@ -2136,7 +2136,7 @@ int test_quicklistVerifySpecificCompressionOfInteriorNodes(int argc, char **argv
                                 err++;
                             }
                         } else {
-                            if (node->encoding != QUICKLIST_NODE_ENCODING_LZF) {
+                            if (!quicklistNodeIsCompressed(node)) {
                                 TEST_PRINT_INFO("Incorrect non-compression: node %d is NOT "
                                                 "compressed at depth %d ((%u, %u); total "
                                                 "nodes: %lu; size: %zu; attempted: %d)",
@@ -2220,6 +2220,94 @@ int test_quicklistBookmarkLimit(int argc, char **argv, int flags) {
     return 0;
 }
 
+/* Check that every sample of the positional index points to the right node
+ * with the right number of elements before it. */
+static int quicklistIndexIsValid(quicklist *ql) {
+    quicklistIndex *idx = ql->index;
+    unsigned long long before = 0;
+    unsigned long sampled = 0;
+    for (quicklistNode *node = ql->head; node; node = node->next) {
+        if (node->indexed) {
+            if (!idx || sampled == idx->len) return 0;
+            quicklistIndexEntry *e = &idx->entries[idx->start + sampled++];
+            if (e->node != node || e->before + idx->shift != (long long)before) return 0;
+        }
+        before += node->count;
+    }
+    return !idx || sampled == idx->len;
+}
+
+int test_quicklistPositionalIndex(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+    TEST("positional index stays consistent with pushes, pops and edits");
+
+    const long max = 20000;
+    long long *model = zmalloc(sizeof(long long) * max * 2);
+    long long *first = model + max, next = 0; /* model[first .. first + len - 1] */
+    long len = 0, indexed_seeks = 0;
+    char buf[32];
+    quicklist *ql = quicklistNew(4, 0);
+    srand(1234);
+
+    for (int i = 0; i < 12000; i++) {
+        int op = rand() % 10;
+        if (op < 3 || len < 4000) {
+            /* Push at either end. */
+            int head = rand() % 2;
+            long long v = next++;
+            int n = snprintf(buf, sizeof(buf), "%lld", v);
+            if (head) {
+                quicklistPushHead(ql, buf, n);
+                *--first = v;
+            } else {
+                quicklistPushTail(ql, buf, n);
+                first[len] = v;
+            }
+            len++;
+        } else if (op < 5) {
+            /* Pop at either end. */
+            int head = rand() % 2;
+            long long v;
+            TEST_ASSERT(quicklistPop(ql, head ? QUICKLIST_HEAD : QUICKLIST_TAIL, NULL, NULL, &v));
+            TEST_ASSERT(v == (head ? first[0] : first[len - 1]));
+            if (head) first++;
+            len--;
+        } else if (op < 9) {
+            /* Seek, from either end. */
+            long pos = rand() % len;
+            quicklistEntry entry;
+            quicklistIter *iter = quicklistGetIteratorEntryAtIdx(ql, rand() % 2 ? pos : pos - len, &entry);
+            TEST_ASSERT(iter != NULL);
+            TEST_ASSERT(entry.value == NULL && entry.longval == first[pos]);
+            quicklistReleaseIterator(iter);
+            if (ql->index) indexed_seeks++;
+        } else if (rand() % 2) {
+            /* Replace an element, in place. */
+            long pos = rand() % len;
+            long long v = next++;
+            int n = snprintf(buf, sizeof(buf), "%lld", v);
+            TEST_ASSERT(quicklistReplaceAtIndex(ql, pos, buf, n));
+            first[pos] = v;
+        } else {
+            /* Delete an element, which discards the index unless it's at
+             * either end. */
+            long pos = rand() % len;
+            TEST_ASSERT(quicklistDelRange(ql, pos, 1));
+            memmove(first + pos, first + pos + 1, sizeof(long long) * (len - pos - 1));
+            len--;
+        }
+        TEST_ASSERT(ql->count == (unsigned long)len);
+        TEST_ASSERT(quicklistIndexIsValid(ql));
+    }
+    TEST_ASSERT(indexed_seeks > 0);
+
+    quicklistRelease(ql);
+    zfree(model);
+    return 0;
+}
+
 int test_quicklistCompressAndDecompressQuicklistListpackNode(int argc, char **argv, int flags) {
     UNUSED(argc);
     UNUSED(argv);
@@ -919,6 +919,67 @@ int test_raxBenchmark(int argc, char **argv, int flags) {
     return 0;
 }
 
+/* Benchmark lookups in trees whose shape stresses the child search: random
+ * binary keys create nodes with up to 256 children in the upper levels,
+ * while stream-like IDs create long compressed nodes shared by many keys. */
+int test_raxDenseBenchmark(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    if (!(flags & UNIT_TEST_SINGLE)) return 0;
+
+    const int numkeys = 2000000;
+    for (int mode = 0; mode < 2; mode++) {
+        printf("Benchmark with %s keys:\n", (mode == 0) ? "random binary" : "stream ID");
+        unsigned char *keys = zmalloc((size_t)numkeys * 16);
+        for (int i = 0; i < numkeys; i++) {
+            unsigned char *key = keys + (size_t)i * 16;
+            if (mode == 0) {
+                uint64_t r1 = genrand64_int64(), r2 = genrand64_int64();
+                memcpy(key, &r1, 8);
+                memcpy(key + 8, &r2, 8);
+            } else {
+                /* Big endian milliseconds and sequence, like streamEncodeID(). */
+                uint64_t ms = 1700000000000ULL + i / 8, seq = i % 8;
+                for (int j = 0; j < 8; j++) {
+                    key[j] = (ms >> (56 - j * 8)) & 0xff;
+                    key[8 + j] = (seq >> (56 - j * 8)) & 0xff;
+                }
+            }
+        }
+
+        rax *t = raxNew();
+        long long start = _ustime();
+        for (int i = 0; i < numkeys; i++) raxInsert(t, keys + (size_t)i * 16, 16, (void *)(long)i, NULL);
+        printf("Insert: %f\n", (double)(_ustime() - start) / 1000000);
+        printf("%llu total nodes\n", (unsigned long long)t->numnodes);
+        printf("%zu bytes allocated\n", raxAllocSize(t));
+
+        start = _ustime();
+        for (int i = 0; i < numkeys; i++) {
+            int r = genrand64_int64() % numkeys;
+            void *data;
+            TEST_ASSERT(raxFind(t, keys + (size_t)r * 16, 16, &data) && data == (void *)(long)r);
+        }
+        printf("Random lookup: %f\n", (double)(_ustime() - start) / 1000000);
+
+        start = _ustime();
+        for (int i = 0; i < numkeys; i++) {
+            unsigned char buf[16];
+            memcpy(buf, keys + (size_t)i * 16, 16);
+            buf[15] ^= 0x80; /* Never a key of the tree, the low bit is < 8 in stream IDs. */
+            if (mode == 0) buf[genrand64_int64() % 16] ^= 0x5a;
+            void *data;
+            if (raxFind(t, buf, 16, &data)) TEST_ASSERT(mode == 0);
+        }
+        printf("Failed lookup: %f\n", (double)(_ustime() - start) / 1000000);
+
+        raxFree(t);
+        zfree(keys);
+    }
+    return 0;
+}
+
 /* Compressed nodes can only hold (2^29)-1 characters, so it is important
  * to test for keys bigger than this amount, in order to make sure that
  * the code to handle this edge case works as expected.
@@ -1,3 +1,5 @@
+#include <pthread.h>
+
 #include "../zmalloc.h"
 #include "test_help.h"
 
@@ -53,3 +55,80 @@ int test_zmallocAllocZeroByteAndFree(int argc, char **argv, int flags) {
 
     return 0;
 }
+
+int test_zmallocCachedAllocAndFree(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    void *ptrs[300];
+    int j;
+
+    for (j = 0; j < 300; j++) ptrs[j] = zmalloc_cached(24);
+    TEST_ASSERT(zmalloc_used_memory() >= 300 * 24);
+    for (j = 0; j < 300; j++) zfree_cached(ptrs[j], 24);
+#ifdef USE_JEMALLOC
+    /* Cached objects are still counted as used memory. */
+    size_t cached = zmalloc_used_memory();
+    TEST_ASSERT(cached >= 256 * 24);
+#else
+    TEST_ASSERT(zmalloc_used_memory() == 0);
+#endif
+
+    void *ptr = zmalloc_cached(24);
+#ifdef USE_JEMALLOC
+    TEST_ASSERT(zmalloc_used_memory() == cached);
+#endif
+#ifdef USE_JEMALLOC
+    /* The last released object is the first one to be reused. */
+    TEST_ASSERT(ptr == ptrs[255]);
+#endif
+    zfree_cached(ptr, 24);
+
+    /* Sizes that aren't cached just use the allocator. */
+    ptr = zmalloc_cached(1000);
+    zfree_cached(ptr, 1000);
+
+    zmalloc_cache_release();
+    TEST_ASSERT(zmalloc_used_memory() == 0);
+
+    return 0;
+}
+
+typedef struct {
+    void *ptrs[100];
+    size_t cached; /* Used memory before the thread released its cache. */
+} cachedFreeArgs;
+
+/* Free objects allocated by another thread into this thread's cache, and
+ * release it, like bio threads do after every job. */
+static void *freeCachedInThread(void *arg) {
+    cachedFreeArgs *args = arg;
+    for (int j = 0; j < 100; j++) zfree_cached(args->ptrs[j], 24);
+    args->cached = zmalloc_used_memory();
+    zmalloc_cache_release();
+    return NULL;
+}
+
+int test_zmallocCacheReleasedByOtherThread(int argc, char **argv, int flags) {
+    UNUSED(argc);
+    UNUSED(argv);
+    UNUSED(flags);
+
+    cachedFreeArgs args;
+    pthread_t tid;
+
+    for (int j = 0; j < 100; j++) args.ptrs[j] = zmalloc_cached(24);
+    size_t used = zmalloc_used_memory();
+    TEST_ASSERT(used >= 100 * 24);
+
+    TEST_ASSERT(pthread_create(&tid, NULL, freeCachedInThread, &args) == 0);
+    TEST_ASSERT(pthread_join(tid, NULL) == 0);
+#ifdef USE_JEMALLOC
+    /* Cached objects are counted until the thread releases them. */
+    TEST_ASSERT(args.cached == used);
+#endif
+    TEST_ASSERT(zmalloc_used_memory() == 0);
+
+    return 0;
+}
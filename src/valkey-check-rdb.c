@@ -180,6 +180,102 @@ void rdbCheckSetupSignals(void) {
     sigaction(SIGABRT, &act, NULL);
 }
 
+/* Verify the sections listed by the "slot-index" AUX field against the
+ * content of the file. Return 0 if they all match, otherwise 1. */
+static int rdbCheckSlotIndex(FILE *fp, off_t filesize, rdbSlotIndexEntry *entries, size_t count) {
+    unsigned char buf[64 * 1024];
+    off_t pos = ftello(fp);
+    int retval = 1;
+
+    for (size_t j = 0; j < count; j++) {
+        rdbSlotIndexEntry *e = &entries[j];
+        if (e->offset < 9 || e->length > (uint64_t)filesize || e->offset > (uint64_t)filesize - e->length) {
+            rdbCheckError("Slot index section of DB %u slot %u is out of the file", e->dbid, e->slot);
+            goto done;
+        }
+        if (e->crc == 0) continue; /* Saved with rdbchecksum disabled. */
+
+        uint64_t crc = 0, left = e->length;
+        if (fseeko(fp, e->offset, SEEK_SET) == -1) goto ioerr;
+        while (left) {
+            size_t n = left < sizeof(buf) ? left : sizeof(buf);
+            if (fread(buf, n, 1, fp) != 1) goto ioerr;
+            crc = crc64(crc, buf, n);
+            left -= n;
+        }
+        if (crc != e->crc) {
+            rdbCheckError("Slot index CRC error in the section of DB %u slot %u", e->dbid, e->slot);
+            goto done;
+        }
+    }
+    rdbCheckInfo("Slot index OK: %zu sections", count);
+    retval = 0;
+    goto done;
+
+ioerr:
+    rdbCheckError("Error reading the sections of the slot index: %s", strerror(errno));
+done:
+    if (pos != -1) fseeko(fp, pos, SEEK_SET);
+    return retval;
+}
+
+/* Locate the slot index from the end of the file, like a reader that only
+ * needs some of the slots would, and verify that it is the same index the
+ * "slot-index" AUX field holds. Return 0 if it is, or if the file has no
+ * index at all, otherwise 1. */
+static int rdbCheckSlotIndexTrailer(FILE *fp,
+                                    off_t filesize,
+                                    rdbSlotIndexEntry *entries,
+                                    size_t count,
+                                    int has_slot_index) {
+    unsigned char trailer[RDB_SLOT_INDEX_TRAILER_LEN], *buf = NULL;
+    rdbSlotIndexEntry *found = NULL;
+    size_t found_count = 0;
+    uint64_t n;
+    off_t pos = ftello(fp), end = filesize - RDB_SLOT_INDEX_TRAILER_END_OFFSET;
+    int retval = 1;
+
+    if (end < 9 || fseeko(fp, end, SEEK_SET) == -1 || fread(trailer, sizeof(trailer), 1, fp) != 1 ||
+        memcmp(trailer + 8, RDB_SLOT_INDEX_MAGIC, 8)) {
+        if (has_slot_index) {
+            rdbCheckError("The slot index can't be found from the end of the file");
+            goto done;
+        }
+        retval = 0;
+        goto done;
+    }
+    if (!has_slot_index) {
+        rdbCheckError("The end of the file has a slot index trailer, but there is no slot-index AUX field");
+        goto done;
+    }
+
+    memcpy(&n, trailer, 8);
+    memrev64ifbe(&n);
+    if (n > (uint64_t)(end - 9) / RDB_SLOT_INDEX_ENTRY_LEN) {
+        rdbCheckError("The slot index trailer counts more sections than the file can hold");
+        goto done;
+    }
+    size_t len = n * RDB_SLOT_INDEX_ENTRY_LEN + RDB_SLOT_INDEX_TRAILER_LEN;
+    buf = zmalloc(len);
+    if (fseeko(fp, end - n * RDB_SLOT_INDEX_ENTRY_LEN, SEEK_SET) == -1 || fread(buf, len, 1, fp) != 1) {
+        rdbCheckError("Error reading the slot index from the end of the file: %s", strerror(errno));
+        goto done;
+    }
+    if (rdbSlotIndexDecode(buf, len, &found, &found_count) == C_ERR || found_count != count ||
+        (count && memcmp(found, entries, sizeof(*entries) * count))) {
+        rdbCheckError("The slot index at the end of the file differs from the slot-index AUX field");
+        goto done;
+    }
+    rdbCheckInfo("Slot index found from the end of the file");
+    retval = 0;
+
+done:
+    zfree(buf);
+    zfree(found);
+    if (pos != -1) fseeko(fp, pos, SEEK_SET);
+    return retval;
+}
+
 /* Check the specified RDB file. Return 0 if the RDB looks sane, otherwise
  * 1 is returned.
  * The file is specified as a filename in 'rdbfilename' if 'fp' is NULL,
@@ -192,6 +288,9 @@ int redis_check_rdb(char *rdbfilename, FILE *fp) {
     long long expiretime, now = mstime();
     static rio rdb; /* Pointed by global struct riostate. */
     struct stat sb;
+    rdbSlotIndexEntry *slot_index = NULL;
+    size_t slot_index_count = 0;
+    int has_slot_index = 0;
 
     int closefile = (fp == NULL);
     if (fp == NULL && (fp = fopen(rdbfilename, "r")) == NULL) return 1;
@@ -280,7 +379,21 @@ int redis_check_rdb(char *rdbfilename, FILE *fp) {
                 goto eoferr;
             }
 
-            rdbCheckInfo("AUX FIELD %s = '%s'", (char *)auxkey->ptr, (char *)auxval->ptr);
+            if (!strcasecmp(auxkey->ptr, RDB_SLOT_INDEX_AUX)) {
+                zfree(slot_index);
+                slot_index = NULL;
+                if (rdbSlotIndexDecode(auxval->ptr, sdslen(auxval->ptr), &slot_index, &slot_index_count) ==
+                    C_ERR) {
+                    rdbCheckError("Invalid slot index");
+                    decrRefCount(auxkey);
+                    decrRefCount(auxval);
+                    goto err;
+                }
+                has_slot_index = 1;
+                rdbCheckInfo("AUX FIELD %s = %zu sections", (char *)auxkey->ptr, slot_index_count);
+            } else {
+                rdbCheckInfo("AUX FIELD %s = '%s'", (char *)auxkey->ptr, (char *)auxval->ptr);
+            }
             decrRefCount(auxkey);
             decrRefCount(auxval);
             continue; /* Read type again. */
@@ -356,7 +469,10 @@ int redis_check_rdb(char *rdbfilename, FILE *fp) {
             rdbCheckInfo("Checksum OK");
         }
     }
+    if (has_slot_index && rdbCheckSlotIndex(fp, sb.st_size, slot_index, slot_index_count)) goto err;
+    if (rdbCheckSlotIndexTrailer(fp, sb.st_size, slot_index, slot_index_count, has_slot_index)) goto err;
 
+    zfree(slot_index);
     if (closefile) fclose(fp);
     stopLoading(1);
     return 0;
@@ -368,6 +484,7 @@ eoferr: /* unexpected end of file is handled here with a fatal exit */
         rdbCheckError("Unexpected EOF reading RDB file");
     }
 err:
+    zfree(slot_index);
     if (closefile) fclose(fp);
     stopLoading(0);
     return 1;
@@ -426,6 +426,97 @@ void zfree_with_size(void *ptr, size_t size) {
     zfree_internal(ptr, size);
 }
 
+/* Per-thread caches of small fixed-size allocations.
+ *
+ * Hot structures that are created and destroyed all the time, like dict
+ * entries and quicklist nodes, are allocated with zmalloc_cached() and
+ * released with zfree_cached(), passing the same size. Released objects are
+ * kept in a small per-thread free list of their size class and handed out
+ * again by the next allocation, skipping the allocator and the size lookup
+ * that zfree() needs. Cached objects are still allocated, so they remain
+ * counted in used_memory until they are released.
+ *
+ * A thread's cache can only be released by the thread itself, with
+ * zmalloc_cache_release(): bio threads do it after every job, and the main
+ * thread before every active defrag scan, since cached objects keep their
+ * allocator slabs in use. Caching is only enabled with jemalloc: with other allocators
+ * (including the ones used for sanitizer and valgrind builds) these calls
+ * map directly to zmalloc() and zfree(). */
+#define ZMALLOC_CACHE_MAX_SIZE 64
+#define ZMALLOC_CACHE_MAX_OBJECTS 256
+
+#ifdef USE_JEMALLOC
+typedef struct zmallocCache {
+    void *head;         /* Free list, linked through the first word of each object. */
+    unsigned int count; /* Number of objects in the free list. */
+    size_t usable;      /* Allocation size of the objects, 0 if not known yet. */
+} zmallocCache;
+
+static thread_local zmallocCache zmalloc_caches[ZMALLOC_CACHE_MAX_SIZE / sizeof(void *)];
+
+static inline zmallocCache *zmalloc_cache_for_size(size_t size) {
+    if (size < sizeof(void *) || size > ZMALLOC_CACHE_MAX_SIZE) return NULL;
+    return &zmalloc_caches[(size - 1) / sizeof(void *)];
+}
+#endif
+
+void *zmalloc_cached(size_t size) {
+#ifdef USE_JEMALLOC
+    zmallocCache *cache = zmalloc_cache_for_size(size);
+    if (cache && cache->head) {
+        void *ptr = cache->head;
+        cache->head = *(void **)ptr;
+        cache->count--;
+        return ptr;
+    }
+    size_t usable;
+    void *ptr = zmalloc_usable(size, &usable);
+    if (cache) cache->usable = usable;
+    return ptr;
+#else
+    return zmalloc(size);
+#endif
+}
+
+/* Releases an allocation made with zmalloc_cached(size) or zmalloc(size). */
+void zfree_cached(void *ptr, size_t size) {
+    if (ptr == NULL) return;
+#ifdef USE_JEMALLOC
+    zmallocCache *cache = zmalloc_cache_for_size(size);
+    if (cache == NULL) {
+        zfree(ptr);
+        return;
+    }
+    /* The object may have been allocated by another thread. */
+    if (cache->usable == 0) cache->usable = zmalloc_size(ptr);
+    if (cache->count == ZMALLOC_CACHE_MAX_OBJECTS) {
+        zfree_internal(ptr, cache->usable);
+        return;
+    }
+    *(void **)ptr = cache->head;
+    cache->head = ptr;
+    cache->count++;
+#else
+    UNUSED(size);
+    zfree(ptr);
+#endif
+}
+
+/* Returns the objects cached by the calling thread to the allocator. */
+void zmalloc_cache_release(void) {
+#ifdef USE_JEMALLOC
+    for (size_t j = 0; j < sizeof(zmalloc_caches) / sizeof(zmalloc_caches[0]); j++) {
+        zmallocCache *cache = &zmalloc_caches[j];
+        while (cache->head) {
+            void *ptr = cache->head;
+            cache->head = *(void **)ptr;
+            zfree_internal(ptr, cache->usable);
+        }
+        cache->count = 0;
+    }
+#endif
+}
+
 char *zstrdup(const char *s) {
     size_t l = strlen(s) + 1;
     char *p = zmalloc(l);
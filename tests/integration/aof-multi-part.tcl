@@ -1361,4 +1361,110 @@ tags {"external:skip"} {
             }
         }
     }
+
+    start_server {tags {"Multi Part AOF"} overrides {aof-use-rdb-preamble {yes} appendonly {no} save {}}} {
+        set dir [get_valkey_dir]
+        set aof_basename "appendonly.aof"
+        set aof_dirname "appendonlydir"
+        set aof_dirpath "$dir/$aof_dirname"
+        set aof_manifest_name "$aof_basename$::manifest_suffix"
+        set aof_manifest_file "$dir/$aof_dirname/$aof_manifest_name"
+
+        test "AOF incremental compaction replaces the INCR AOFs without a fork" {
+            r debug populate 1000
+            r config set aof-compaction-max-keys 10
+            r config set appendonly yes
+            waitForBgrewriteaof r
+
+            # A few hot keys rewritten many times
+            for {set j 0} {$j < 3000} {incr j} {
+                r incr counter
+            }
+            r rpush list a b c
+            r lpop list
+            r hset hash f1 v1 f2 v2
+            r set volatile v px 100000
+            r set gone v
+            r del gone
+            r del key:1
+
+            set total_forks [s total_forks]
+            set d1 [r debug digest]
+            r config set auto-aof-rewrite-min-size 0
+            r config set auto-aof-rewrite-percentage 100
+            wait_for_condition 1000 10 {
+                [s aof_compactions] == 1
+            } else {
+                fail "AOF incremental compaction not performed"
+            }
+            assert_equal $total_forks [s total_forks]
+
+            assert_aof_manifest_content $aof_manifest_file {
+                {file appendonly.aof.1.base.rdb seq 1 type b}
+                {file appendonly.aof.2.incr.aof seq 2 type i}
+            }
+            wait_for_condition 1000 10 {
+                [check_file_exist $aof_dirpath "${aof_basename}.1${::incr_aof_sufix}${::aof_format_suffix}"] == 0
+            } else {
+                fail "Failed to delete history AOF"
+            }
+
+            # New writes are appended to the compacted INCR AOF
+            r incr counter
+            set d1 [r debug digest]
+            r debug loadaof
+            assert_equal $d1 [r debug digest]
+            assert_equal 3001 [r get counter]
+            assert_equal 0 [r exists key:1 gone]
+        }
+
+        test "AOF incremental compaction falls back to a rewrite after writes without keys" {
+            r config set auto-aof-rewrite-percentage 0
+            r swapdb 9 10
+            r swapdb 9 10
+            for {set j 0} {$j < 3000} {incr j} {
+                r incr counter
+            }
+
+            set rewrites [s aof_rewrites]
+            r config set auto-aof-rewrite-percentage 100
+            wait_for_condition 1000 10 {
+                [s aof_rewrites] == $rewrites + 1
+            } else {
+                fail "AOF rewrite not performed"
+            }
+            waitForBgrewriteaof r
+            assert_equal 1 [s aof_compactions]
+
+            set d1 [r debug digest]
+            r debug loadaof
+            assert_equal $d1 [r debug digest]
+        }
+
+        test "AOF incremental compaction falls back to a rewrite when the keys are too big" {
+            r config set auto-aof-rewrite-percentage 0
+            r config set aof-compaction-max-bytes 100000
+            waitForBgrewriteaof r
+            r set big [string repeat x 200000]
+            for {set j 0} {$j < 3000} {incr j} {
+                r incr counter
+            }
+
+            set rewrites [s aof_rewrites]
+            r config set auto-aof-rewrite-percentage 100
+            wait_for_condition 1000 10 {
+                [s aof_rewrites] == $rewrites + 1
+            } else {
+                fail "AOF rewrite not performed"
+            }
+            waitForBgrewriteaof r
+            assert_equal 1 [s aof_compactions]
+            verify_log_message 0 "*compaction given up: more than 100000 bytes to write*" 0
+
+            set d1 [r debug digest]
+            r debug loadaof
+            assert_equal $d1 [r debug digest]
+            r config set aof-compaction-max-bytes 4mb
+        }
+    }
 }
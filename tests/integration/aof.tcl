@@ -66,6 +66,25 @@ tags {"aof external:skip"} {
         }
     }
 
+    ## Arguments bigger than the read buffer of the loader, and a short read
+    ## in the middle of one of them.
+    set big [string repeat x 3000000]
+    create_aof $aof_dirpath $aof_file {
+        append_to_aof [formatCommand set big $big]
+        append_to_aof [formatCommand rpush list a b c]
+        append_to_aof [string range [formatCommand set big2 $big] 0 end-1000]
+    }
+
+    start_server_aof [list dir $server_path aof-load-truncated yes] {
+        test "Big arguments: Truncated AOF loaded" {
+            set client [valkey [srv host] [srv port] 0 $::tls]
+            wait_done_loading $client
+            assert_equal 3000000 [$client strlen big]
+            assert_equal {a b c} [$client lrange list 0 -1]
+            assert_equal 0 [$client exists big2]
+        }
+    }
+
     ## Test that the server exits when the AOF contains a format error
     create_aof $aof_dirpath $aof_file {
         append_to_aof [formatCommand set foo hello]
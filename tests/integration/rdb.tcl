@@ -475,3 +475,260 @@ start_server {} {
 }
 
 } ;# tags
+
+start_server {overrides {save "" bgsave-forkless yes}} {
+    test {Forkless bgsave saves a point-in-time snapshot} {
+        # 500 keys with 1ms sleep per key should take half a second
+        r config set rdb-key-save-delay 1000
+        for {set j 0} {$j < 500} {incr j} {
+            r set key:$j old:$j
+        }
+        r rpush list a b c
+        r set volatile old ex 1000
+        r select 10
+        r set otherdb old
+        r select 9
+        set forks [s total_forks]
+
+        r bgsave
+        assert_equal [s rdb_bgsave_in_progress] 1
+        for {set j 0} {$j < 500} {incr j 5} {
+            r set key:$j new:$j
+            r del key:[expr {$j + 1}]
+            r set newkey:$j new
+        }
+        r rpush list d
+        r persist volatile
+        r select 10
+        r del otherdb
+        r select 9
+        waitForBgsave r
+        assert_equal [s rdb_last_bgsave_status] ok
+        # Changes made while saving are not part of the snapshot
+        assert_equal [s rdb_changes_since_last_save] 303
+        assert_equal [s total_forks] $forks
+
+        r debug reload nosave
+        for {set j 0} {$j < 500} {incr j} {
+            assert_equal [r get key:$j] old:$j
+        }
+        assert_equal [r dbsize] 502
+        assert_equal [r lrange list 0 -1] {a b c}
+        assert_morethan [r ttl volatile] 0
+        r select 10
+        assert_equal [r get otherdb] old
+        r select 9
+    } {OK} {needs:debug}
+
+    test {Forkless bgsave saves consumer groups as of the snapshot} {
+        r flushall
+        r config set rdb-key-save-delay 1000
+        populate 200
+        for {set j 0} {$j < 20} {incr j} {
+            r xadd stream:$j 1-1 a 1
+            r xadd stream:$j 2-1 b 2
+            r xgroup create stream:$j group 0
+            r xreadgroup group group alice count 1 streams stream:$j >
+        }
+        set before {}
+        for {set j 0} {$j < 20} {incr j} {
+            lappend before [r xinfo stream stream:$j full]
+        }
+
+        # Consumer group commands modify streams they don't look up for
+        # writing, the ones not saved yet must be saved before that.
+        r bgsave
+        assert_equal [s rdb_bgsave_in_progress] 1
+        for {set j 0} {$j < 20} {incr j} {
+            r xreadgroup group group bob streams stream:$j >
+            r xack stream:$j group 1-1
+            r xclaim stream:$j group carol 0 2-1
+            r xautoclaim stream:$j group dave 0 0-0
+        }
+        waitForBgsave r
+        assert_equal [s rdb_last_bgsave_status] ok
+
+        r debug reload nosave
+        for {set j 0} {$j < 20} {incr j} {
+            assert_equal [lindex $before $j] [r xinfo stream stream:$j full]
+        }
+        r config set rdb-key-save-delay 0
+    } {OK} {needs:debug}
+
+    test {Forkless bgsave is aborted by FLUSHALL and BGSAVE CANCEL} {
+        r config set rdb-key-save-delay 1000
+        populate 1000
+        r bgsave
+        assert_equal [s rdb_bgsave_in_progress] 1
+        assert_error "ERR Background save already in progress" {r bgsave}
+        assert {[r bgsave cancel] eq {Background saving cancelled}}
+        assert_equal [s rdb_bgsave_in_progress] 0
+        assert_equal [s rdb_last_bgsave_status] ok
+
+        r bgsave
+        assert_equal [s rdb_bgsave_in_progress] 1
+        r flushall
+        assert_equal [s rdb_bgsave_in_progress] 0
+        set dir [lindex [r config get dir] 1]
+        assert_equal [glob -nocomplain -directory $dir temp-forkless-*.rdb] {}
+        r config set rdb-key-save-delay 0
+    }
+}
+
+start_server {tags {"repl external:skip"} overrides {save "" bgsave-forkless yes repl-diskless-sync no}} {
+    set primary [srv 0 client]
+    set primary_host [srv 0 host]
+    set primary_port [srv 0 port]
+
+    start_server {} {
+        set replica [srv 0 client]
+
+        test {Full sync started during a forkless bgsave waits for it} {
+            populate 200 key: 10 -1
+            $primary config set rdb-key-save-delay 5000
+            $primary bgsave
+            assert_equal [s -1 rdb_bgsave_in_progress] 1
+
+            $replica replicaof $primary_host $primary_port
+            wait_for_log_messages -1 {"*Forkless BGSAVE in progress. BGSAVE for replication delayed*"} 0 50 100
+            assert_equal [s -1 rdb_bgsave_in_progress] 1
+            $primary config set rdb-key-save-delay 0
+
+            wait_for_condition 100 100 {
+                [status $replica master_link_status] eq "up"
+            } else {
+                fail "replica didn't sync in time"
+            }
+            assert_equal [s -1 rdb_last_bgsave_status] ok
+            assert_equal 0 [count_log_message -1 "BGSAVE failed"]
+            assert_equal 1 [s -1 sync_full]
+            assert_equal [$primary debug digest] [$replica debug digest]
+        } {} {needs:debug}
+    }
+}
+
+start_server {overrides {save "" rdb-slot-index yes}} {
+    test {RDB ends with an index of the DB sections} {
+        r flushall
+        populate 1000 a:
+        r select 10
+        populate 500 b:
+        r select 9
+        r save
+
+        set dir [lindex [r config get dir] 1]
+        set dbfilename [lindex [r config get dbfilename] 1]
+        set fd [open [file join $dir $dbfilename] r]
+        fconfigure $fd -translation binary
+        set rdb [read $fd]
+        close $fd
+
+        # The trailer of the index sits right before the EOF opcode and the checksum.
+        set trailer [string range $rdb end-24 end-9]
+        binary scan $trailer wa8 count magic
+        assert_equal SLOTIDX1 $magic
+        assert_equal 2 $count
+        set index [string range $rdb [expr {[string length $rdb] - 25 - 40 * $count}] end-25]
+        binary scan $index iiwwwwiiwwww db1 slot1 off1 len1 keys1 crc1 db2 slot2 off2 len2 keys2 crc2
+        assert_equal {9 1000 10 500} [list $db1 $keys1 $db2 $keys2]
+        assert {$crc1 != 0 && $crc2 != 0}
+        # Only the SELECTDB and RESIZEDB opcodes of db 10 are between them.
+        assert_equal [expr {$off1 + $len1 + 6}] $off2
+
+        set digest [debug_digest]
+        r debug reload
+        assert_equal $digest [debug_digest]
+    } {} {needs:debug needs:save}
+    test {valkey-check-rdb finds the slot index from the end of the file} {
+        r save
+        set rdbfile [file join [lindex [r config get dir] 1] [lindex [r config get dbfilename] 1]]
+        set result [exec src/valkey-check-rdb $rdbfile]
+        assert_match "*Slot index OK: 2 sections*" $result
+        assert_match "*Slot index found from the end of the file*" $result
+
+        # Data after the checksum hides the index from readers that seek to it.
+        set copy [file join [lindex [r config get dir] 1] bad-index.rdb]
+        file copy -force $rdbfile $copy
+        set fd [open $copy a]
+        fconfigure $fd -translation binary
+        puts -nonewline $fd "trailing"
+        close $fd
+        catch {exec src/valkey-check-rdb $copy} result
+        assert_match "*slot index can't be found from the end of the file*" $result
+        file delete $copy
+
+        r config set rdb-slot-index no
+        r save
+        set result [exec src/valkey-check-rdb $rdbfile]
+        r config set rdb-slot-index yes
+        assert_no_match "*Slot index*" $result
+    } {} {needs:save}
+    test {Forkless BGSAVE does not write the slot index} {
+        r config set bgsave-forkless yes
+        r bgsave
+        waitForBgsave r
+        r config set bgsave-forkless no
+        verify_log_message 0 "*Forkless BGSAVE does not support rdb-slot-index*" 0
+
+        set dir [lindex [r config get dir] 1]
+        set dbfilename [lindex [r config get dbfilename] 1]
+        set fd [open [file join $dir $dbfilename] r]
+        fconfigure $fd -translation binary
+        set rdb [read $fd]
+        close $fd
+        assert_no_match "*SLOTIDX1*" $rdb
+    } {} {needs:save}
+}
+
+start_server {overrides {save "" list-compress-depth 1}} {
+    proc rdb_file_size {} {
+        r save
+        file size [file join [lindex [r config get dir] 1] [lindex [r config get dbfilename] 1]]
+    }
+
+    test {RDB strings and list nodes compressed with LZ4 load back} {
+        r flushall
+        for {set j 0} {$j < 200} {incr j} {
+            r set str:$j [string repeat "value-$j " 50]
+        }
+        r rpush list {*}[lrepeat 20000 element]
+
+        r config set rdbcompression no
+        set raw [rdb_file_size]
+        r config set rdbcompression yes
+        set lzf [rdb_file_size]
+
+        # List nodes keep the codec they were compressed with.
+        r config set rdb-compression-codec lz4 list-compression-codec lz4
+        r del list
+        r rpush list {*}[lrepeat 20000 element]
+        set lz4 [rdb_file_size]
+        assert_match "*serializedlength:*" [r debug object str:1]
+        assert_match "*serializedlength:*" [r debug object list]
+        assert_lessthan $lzf [expr {$raw / 4}]
+        assert_lessthan $lz4 [expr {$raw / 4}]
+        assert {$lz4 != $lzf}
+
+        set digest [debug_digest]
+        r debug reload
+        assert_equal $digest [debug_digest]
+        assert_equal 20000 [r llen list]
+    } {} {needs:debug needs:save}
+
+    test {DUMP payloads are compressed with LZF} {
+        r config set rdb-compression-codec lz4 list-compression-codec lz4
+        set lz4 [r dump str:1]
+        r config set rdb-compression-codec lzf
+        assert_equal $lz4 [r dump str:1]
+
+        r del list
+        r rpush list {*}[lrepeat 20000 element]
+        set payload [r dump list]
+        r config set list-compression-codec lzf
+        r del list
+        r rpush list {*}[lrepeat 20000 element]
+        assert_equal $payload [r dump list]
+        r restore list2 0 $payload
+        assert_equal [r lrange list 0 -1] [r lrange list2 0 -1]
+    } {} {needs:debug}
+}
@@ -1574,3 +1574,174 @@ start_server {tags {"repl external:skip"}} {
         }
     }
 }
+
+start_server {tags {"repl external:skip"}} {
+    set replica [srv 0 client]
+    set replica_pid [srv 0 pid]
+    $replica config set repl-transfer-resume yes
+    $replica config set repl-diskless-load disabled
+
+    start_server {} {
+        set primary [srv 0 client]
+        set primary_host [srv 0 host]
+        set primary_port [srv 0 port]
+        $primary config set repl-diskless-sync no
+        $primary config set rdbcompression no
+        $primary config set save ""
+        # 50MB of data, more than the socket buffers can hold
+        $primary debug populate 5000 key 10000
+
+        test {Interrupted disk-based transfer is resumed} {
+            # Slow down the BGSAVE so the replica can be paused before
+            # the transfer starts.
+            $primary config set rdb-key-save-delay 100
+            $replica replicaof $primary_host $primary_port
+            wait_for_condition 50 100 {
+                [s 0 rdb_bgsave_in_progress] == 1
+            } else {
+                fail "bgsave did not start"
+            }
+            pause_process $replica_pid
+            wait_for_condition 100 100 {
+                [string match "*send_bulk*" [s 0 slave0]]
+            } else {
+                fail "transfer did not start"
+            }
+            $primary config set rdb-key-save-delay 0
+
+            # Cut the transfer while the replica only got the data that was
+            # buffered in the socket.
+            $primary client kill type replica
+            $primary set after-snapshot 1
+            resume_process $replica_pid
+            wait_for_log_messages -1 {"*Keeping the * bytes of RDB received so far*"} 0 100 100
+
+            wait_for_condition 100 100 {
+                [s -1 master_link_status] eq {up}
+            } else {
+                fail "replica did not sync"
+            }
+            assert_equal 1 [s 0 sync_full]
+            assert_equal 1 [s 0 sync_resume_ok]
+            wait_for_ofs_sync $primary $replica
+            assert_equal [$primary debug digest] [$replica debug digest]
+            assert_equal 1 [$replica get after-snapshot]
+        }
+
+        test {Interrupted transfer is not resumed by a diskless sync} {
+            $replica replicaof no one
+            $primary config set rdb-key-save-delay 100
+            $replica replicaof $primary_host $primary_port
+            wait_for_condition 50 100 {
+                [s 0 rdb_bgsave_in_progress] == 1
+            } else {
+                fail "bgsave did not start"
+            }
+            pause_process $replica_pid
+            wait_for_condition 100 100 {
+                [string match "*send_bulk*" [s 0 slave0]]
+            } else {
+                fail "transfer did not start"
+            }
+            $primary config set rdb-key-save-delay 0
+            $primary config set repl-diskless-sync yes
+            $primary config set repl-diskless-sync-delay 0
+
+            $primary client kill type replica
+            resume_process $replica_pid
+            wait_for_log_messages 0 {"*Unable to resume the RDB transfer*diskless sync is enabled*"} 0 100 100
+
+            wait_for_condition 100 100 {
+                [s -1 master_link_status] eq {up}
+            } else {
+                fail "replica did not sync"
+            }
+            assert_equal 1 [s 0 sync_resume_ok]
+            wait_for_ofs_sync $primary $replica
+            assert_equal [$primary debug digest] [$replica debug digest]
+        }
+    }
+}
+
+start_server {tags {"repl external:skip"}} {
+    set replica [srv 0 client]
+
+    start_server {} {
+        set primary [srv 0 client]
+        set primary_host [srv 0 host]
+        set primary_port [srv 0 port]
+        $primary config set repl-compression yes
+
+        test {Replication stream is compressed} {
+            $replica replicaof $primary_host $primary_port
+            wait_for_sync $replica
+            set before [s 0 total_net_repl_output_bytes]
+            set offset [s 0 master_repl_offset]
+            for {set j 0} {$j < 1000} {incr j} {
+                $primary set key:$j [string repeat "value-$j" 100]
+            }
+            $primary rpush list {*}[lrepeat 5000 element]
+            wait_for_ofs_sync $primary $replica
+            assert_equal [$primary debug digest] [$replica debug digest]
+            set sent [expr {[s 0 total_net_repl_output_bytes] - $before}]
+            assert_lessthan $sent [expr {([s 0 master_repl_offset] - $offset) / 4}]
+        }
+
+        test {Compressed replication stream survives a partial resync} {
+            $primary client kill type replica
+            for {set j 0} {$j < 1000} {incr j} {
+                $primary incr counter
+            }
+            wait_for_condition 50 100 {
+                [s -1 master_link_status] eq {up}
+            } else {
+                fail "replica did not reconnect"
+            }
+            assert_equal 1 [s 0 sync_full]
+            assert_equal 1 [s 0 sync_partial_ok]
+            wait_for_ofs_sync $primary $replica
+            assert_equal [$primary debug digest] [$replica debug digest]
+            assert_equal 1000 [$replica get counter]
+            assert_equal [status $primary master_replid] [status $replica master_replid]
+        }
+    }
+}
+
+start_server {tags {"repl external:skip"}} {
+    set replica [srv 0 client]
+
+    start_server {overrides {repl-compression yes repl-compression-codec lz4 rdb-compression-codec lz4 list-compression-codec lz4 list-compress-depth 1}} {
+        set primary [srv 0 client]
+        set primary_host [srv 0 host]
+        set primary_port [srv 0 port]
+
+        foreach diskless {yes no} {
+            test "Replication stream and RDB compressed with LZ4 (diskless $diskless)" {
+                $primary config set repl-diskless-sync $diskless
+                $primary flushall
+                for {set j 0} {$j < 200} {incr j} {
+                    $primary set str:$j [string repeat "value-$j " 50]
+                }
+                $primary rpush list {*}[lrepeat 20000 element]
+
+                set full [s 0 sync_full]
+                $replica replicaof $primary_host $primary_port
+                wait_for_sync $replica
+                assert_equal [expr {$full + 1}] [s 0 sync_full]
+                assert_equal [$primary debug digest] [$replica debug digest]
+
+                set before [s 0 total_net_repl_output_bytes]
+                set offset [s 0 master_repl_offset]
+                for {set j 0} {$j < 1000} {incr j} {
+                    $primary set key:$j [string repeat "value-$j" 100]
+                }
+                wait_for_ofs_sync $primary $replica
+                assert_equal [$primary debug digest] [$replica debug digest]
+                set sent [expr {[s 0 total_net_repl_output_bytes] - $before}]
+                assert_lessthan $sent [expr {([s 0 master_repl_offset] - $offset) / 4}]
+
+                $replica replicaof no one
+            } {OK} {needs:debug}
+        }
+    }
+}
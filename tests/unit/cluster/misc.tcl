@@ -13,6 +13,24 @@ start_cluster 2 2 {tags {external:skip cluster}} {
         R 0 ping
     } {PONG}
 
+    test {Multi-key commands are routed by the slot of all their keys} {
+        # {b} is served by the first node, {a} by the second one
+        set slot [R 0 CLUSTER KEYSLOT "{b}"]
+        assert_equal {OK} [R 0 mset "{b}1" v1 "{b}2" v2]
+        assert_equal {v1 v2} [R 0 mget "{b}1" "{b}2"]
+        assert_error {CROSSSLOT*} {R 0 mget "{b}1" "{a}1"}
+        assert_error {MOVED*} {R 0 mget "{a}1" "{a}2"}
+
+        # Keys missing from a migrating slot are redirected
+        set trg_id [R 1 CLUSTER MYID]
+        R 0 CLUSTER SETSLOT $slot MIGRATING $trg_id
+        assert_equal {v1 v2} [R 0 mget "{b}1" "{b}2"]
+        assert_error {ASK*} {R 0 mget "{b}3" "{b}4"}
+        assert_error {TRYAGAIN*} {R 0 mget "{b}1" "{b}3"}
+        R 0 CLUSTER SETSLOT $slot STABLE
+        assert_equal [list v1 {}] [R 0 mget "{b}1" "{b}3"]
+    }
+
     test "Coverage: Basic cluster commands" {
         assert_equal {OK} [R 0 CLUSTER saveconfig]
 
@@ -543,6 +543,25 @@ start_server {tags {"geo"}} {
         assert_equal {point2 point1} [r geosearch points fromlonlat -179 37 bybox 400 400 km asc]
     }
 
+    test {GEOSEARCH the search spans -180° or 180° in a skiplist} {
+        r del points
+        set argv {}
+        set expected_radius {}
+        set expected_box {}
+        for {set j 0} {$j < 500} {incr j} {
+            set lon [expr {179 + ($j % 25) * 0.08}]
+            if {$lon > 180} {set lon [expr {$lon - 360}]}
+            set lat [expr {-1 + ($j / 25) * 0.1}]
+            lappend argv $lon $lat "place:$j"
+            if {[pointInCircle 100 $lon $lat 179.9 0]} {lappend expected_radius "place:$j"}
+            if {[pointInRectangle 150 120 $lon $lat -179.9 0 1]} {lappend expected_box "place:$j"}
+        }
+        r geoadd points {*}$argv
+        assert_encoding skiplist points
+        assert_equal [lsort $expected_radius] [lsort [r geosearch points fromlonlat 179.9 0 byradius 100 km]]
+        assert_equal [lsort $expected_box] [lsort [r geosearch points fromlonlat -179.9 0 bybox 150 120 km]]
+    }
+
     test {GEOSEARCH with small distance} {
         r del points
         r geoadd points -122.407107 37.794300 1
@@ -0,0 +1,174 @@
+start_server {tags {"incremental-reply"}} {
+    proc fill_big_list {key n} {
+        r eval {
+            for i = 1, tonumber(ARGV[1]) do
+                server.call('rpush', KEYS[1], string.rep('x', 2000) .. i)
+            end
+        } 1 $key $n
+    }
+
+    proc client_field {name field} {
+        foreach line [split [r client list] "\n"] {
+            if {[string match "*name=$name *" $line] && [regexp "$field=(\[^ \]+)" $line - value]} {
+                return $value
+            }
+        }
+        return {}
+    }
+
+    test {Incremental reply keeps the output buffer bounded} {
+        r config set incremental-reply-min-elements 1000
+        r del biglist
+        fill_big_list biglist 5000
+
+        set rd [valkey_deferring_client]
+        $rd client setname inc
+        $rd read
+        $rd lrange biglist 0 -1
+        $rd ping
+
+        # The client doesn't read, so the reply can't be sent at once. Only the
+        # part that doesn't fit in the socket buffers should be waiting.
+        wait_for_condition 50 100 {
+            [client_field inc cmd] eq {lrange}
+        } else {
+            fail "LRANGE wasn't processed"
+        }
+        after 200
+        assert_range [client_field inc omem] 0 1000000
+
+        set reply [$rd read]
+        assert_equal 5000 [llength $reply]
+        assert_equal "[string repeat x 2000]1" [lindex $reply 0]
+        assert_equal "[string repeat x 2000]5000" [lindex $reply end]
+        assert_equal PONG [$rd read]
+        $rd close
+    }
+
+    test {Incremental reply is a snapshot of the value before it is modified} {
+        r config set incremental-reply-min-elements 1000
+        r del biglist
+        fill_big_list biglist 5000
+
+        set rd [valkey_deferring_client]
+        $rd client setname inc
+        $rd read
+        $rd lrange biglist 0 -1
+        wait_for_condition 50 100 {
+            [client_field inc cmd] eq {lrange}
+        } else {
+            fail "LRANGE wasn't processed"
+        }
+
+        r lset biglist -1 changed
+        r rpush biglist extra
+        assert_equal changed [r lindex biglist -2]
+
+        set reply [$rd read]
+        assert_equal 5000 [llength $reply]
+        assert_equal "[string repeat x 2000]5000" [lindex $reply end]
+
+        # Deleting the key while the reply is in progress.
+        $rd lrange biglist 0 -1
+        wait_for_condition 50 100 {
+            [client_field inc cmd] eq {lrange}
+        } else {
+            fail "LRANGE wasn't processed"
+        }
+        r del biglist
+        set reply [$rd read]
+        assert_equal 5001 [llength $reply]
+        assert_equal extra [lindex $reply end]
+        $rd close
+    }
+
+    test {Incremental reply is dropped when the client disconnects} {
+        r config set incremental-reply-min-elements 1000
+        fill_big_list biglist 5000
+        set rd [valkey_deferring_client]
+        $rd client setname inc
+        $rd read
+        $rd lrange biglist 0 -1
+        wait_for_condition 50 100 {
+            [client_field inc cmd] eq {lrange}
+        } else {
+            fail "LRANGE wasn't processed"
+        }
+        $rd close
+        wait_for_condition 50 100 {
+            [client_field inc cmd] eq {}
+        } else {
+            fail "Client wasn't freed"
+        }
+        r rpush biglist extra
+    } {5001}
+
+    foreach {type setup} {
+        list {
+            for {set i 0} {$i < 300} {incr i} { r rpush k "elem$i" }
+        }
+        listpack-list {
+            for {set i 0} {$i < 30} {incr i} { r rpush k $i }
+        }
+        hash {
+            for {set i 0} {$i < 300} {incr i} { r hset k "field$i" "value$i" }
+        }
+        listpack-hash {
+            for {set i 0} {$i < 30} {incr i} { r hset k "field$i" $i }
+        }
+        set {
+            for {set i 0} {$i < 300} {incr i} { r sadd k "member$i" }
+        }
+        intset {
+            for {set i 0} {$i < 300} {incr i} { r sadd k $i }
+        }
+        zset {
+            for {set i 0} {$i < 300} {incr i} { r zadd k [expr {$i * 1.5}] "member$i" }
+        }
+        listpack-zset {
+            for {set i 0} {$i < 30} {incr i} { r zadd k $i $i }
+        }
+        stream {
+            for {set i 0} {$i < 300} {incr i} { r xadd k * field $i value [string repeat v $i] }
+        }
+    } {
+        test "Incremental reply matches the regular reply - $type" {
+            r del k
+            eval $setup
+            set commands {
+                {lrange k 0 -1} {lrange k 5 -3} {lrange k -1000 1000}
+                {hgetall k} {hkeys k} {hvals k}
+                {smembers k}
+                {zrange k 0 -1 withscores} {zrange k 3 -5} {zrevrange k 0 -1 withscores}
+                {xrange k - +} {xrevrange k + - count 17} {xrange k - + count 1000}
+            }
+            foreach resp {2 3} {
+                if {[lsearch $::denytags "resp3"] >= 0 && $resp == 3} continue
+                r hello $resp
+                foreach cmd $commands {
+                    r config set incremental-reply-min-elements 0
+                    catch {r {*}$cmd} expected
+                    r config set incremental-reply-min-elements 1
+                    catch {r {*}$cmd} reply
+                    assert_equal $expected $reply
+                }
+            }
+            r hello 2
+            r config set incremental-reply-min-elements 16384
+        }
+    }
+
+    test {Incremental reply is not used inside MULTI and scripts} {
+        r config set incremental-reply-min-elements 1
+        r del k
+        r rpush k a b c
+        r multi
+        r lrange k 0 -1
+        r rpush k d
+        r lrange k 0 -1
+        set res [r exec]
+        assert_equal {{a b c} 4 {a b c d}} $res
+        assert_equal {a b c d} [r eval {return server.call('lrange', KEYS[1], 0, -1)} 1 k]
+        r config set incremental-reply-min-elements 16384
+    }
+}
@@ -368,6 +368,33 @@ foreach command {SORT SORT_RO} {
         assert_match "*ql_listpack_max:-1 ql_compressed:1*" [r debug object lst_dst{t}]
         config_set list-max-listpack-size $origin_config
     } {} {needs:debug}
+
+    test {SORT BY/GET with key prefetching matches the unbatched result} {
+        set origin_config [config_get_set prefetch-batch-max-size 0]
+        r del pfl{t} pfdst{t}
+        for {set i 0} {$i < 100} {incr i} {
+            r rpush pfl{t} $i
+            r set pfw_$i [randomInt 1000]
+            r hset pfh_$i f [randomInt 1000]
+            # Leave some keys missing
+            if {$i % 7} {r set pfv_$i val_$i}
+        }
+        set cmd {sort pfl{t} by pfw_* get # get pfv_* get pfh_*->f}
+        set expected [r {*}$cmd]
+        set expected_limit [r {*}$cmd limit 10 37]
+        set expected_hash [r sort pfl{t} by pfh_*->f get pfw_*]
+        r {*}$cmd store pfdst{t}
+        set expected_store [r lrange pfdst{t} 0 -1]
+        foreach size {2 16 128} {
+            r config set prefetch-batch-max-size $size
+            assert_equal $expected [r {*}$cmd]
+            assert_equal $expected_limit [r {*}$cmd limit 10 37]
+            assert_equal $expected_hash [r sort pfl{t} by pfh_*->f get pfw_*]
+            assert_equal 300 [r {*}$cmd store pfdst{t}]
+            assert_equal $expected_store [r lrange pfdst{t} 0 -1]
+        }
+        config_set prefetch-batch-max-size $origin_config
+    } {} {cluster:skip}
 }
 
 start_cluster 1 0 {tags {"external:skip cluster sort"}} {
@@ -322,6 +322,14 @@ start_server {tags {"hash"}} {
         assert_error {*wrong number of arguments for 'hmset' command} {r hmset smallhash key1 val1 key2}
     }
 
+    test {HSET with repeated fields against a small hash} {
+        r del h
+        r hset h a 1 b 2
+        assert_equal 2 [r hset h a 10 c 3 d 4 c 30 b 20]
+        assert_encoding listpack h
+        assert_equal {a 10 b 20 c 30 d 4} [r hgetall h]
+    }
+
     test {HMSET - small hash} {
         set args {}
         foreach {k v} [array get smallhash] {
@@ -861,4 +869,74 @@ start_server {tags {"hash"}} {
             assert_equal 0 [r exists hfoo]
         }
     }
+
+    test {Hash tables share interned field names} {
+        r flushall
+        r config set hash-intern-fields yes
+        r config set hash-max-listpack-entries 4
+        assert_equal 0 [s mem_hash_interned_fields]
+        for {set i 0} {$i < 10} {incr i} {
+            r hset user:$i name n$i email e$i city c$i country x$i age $i
+        }
+        assert_encoding hashtable user:0
+        assert_equal 5 [s mem_hash_interned_fields]
+        assert_equal {n3 e3 {}} [r hmget user:3 name email country2]
+        r hset user:3 country2 y
+        r hdel user:4 name email city
+        assert_equal 6 [s mem_hash_interned_fields]
+        assert_equal {age 4 country x4} [lsort -stride 2 [r hgetall user:4]]
+
+        r copy user:3 user:copy
+        r del user:3
+        assert_equal {n3 e3 y} [r hmget user:copy name email country2]
+        r del user:copy
+        assert_equal 5 [s mem_hash_interned_fields]
+
+        r debug reload
+        assert_equal 5 [s mem_hash_interned_fields]
+        assert_equal {n7 e7 c7 x7 7} [r hmget user:7 name email city country age]
+
+        r flushall async
+        wait_for_condition 50 100 {
+            [s mem_hash_interned_fields] == 0
+        } else {
+            fail "interned field names were not released"
+        }
+        r config set hash-intern-fields no
+        r config set hash-max-listpack-entries 512
+    } {OK} {needs:debug}
+
+    test {Hash tables with embedded field names} {
+        r flushall
+        r config set hash-max-listpack-entries 4
+        for {set i 0} {$i < 100} {incr i} {
+            r hset h f$i v$i [string repeat x 40]$i long$i
+        }
+        assert_encoding hashtable h
+        assert_equal {v7 long7 {}} [r hmget h f7 [string repeat x 40]7 f100]
+        r hset h f7 w7 f100 v100
+        r hdel h f8 [string repeat x 40]8
+        r hincrby h counter 5
+        assert_equal 200 [r hlen h]
+        assert_range [r memory usage h] 1000 100000
+
+        r copy h h2
+        r del h
+        set fields [lsort [r hkeys h2]]
+        assert_equal [lsort [dict keys [r hgetall h2]]] $fields
+        set scanned {}
+        set cursor 0
+        while 1 {
+            set res [r hscan h2 $cursor count 10]
+            set cursor [lindex $res 0]
+            foreach {f v} [lindex $res 1] { lappend scanned $f }
+            if {$cursor == 0} break
+        }
+        assert_equal $fields [lsort -unique $scanned]
+        assert_equal 2 [llength [r hrandfield h2 -2]]
+
+        r debug reload
+        assert_equal {w7 5 v100} [r hmget h2 f7 counter f100]
+        r config set hash-max-listpack-entries 512
+    } {OK} {needs:debug}
 }
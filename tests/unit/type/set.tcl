@@ -96,6 +96,14 @@ start_server {
         assert_encoding hashtable myset
     }
 
+    test "SADD repeated members against a small set" {
+        create_set myset {a b}
+        assert_encoding listpack myset
+        assert_equal 2 [r sadd myset b c d c a]
+        assert_encoding listpack myset
+        assert_equal {a b c d} [lsort [r smembers myset]]
+    }
+
     test "SADD an integer larger than 64 bits" {
         create_set myset {213244124402402314402033402}
         assert_encoding listpack myset
@@ -431,6 +439,46 @@ foreach type {single multiple single_multiple} {
         assert_equal [lsort $union] [lsort [r sunion set1{t} set2{t}]]
     }
 
+    test "SINTER/SUNION/SDIFF against intsets of skewed sizes" {
+        r del small{t} big{t} other{t} res{t}
+        set small {}
+        set big {}
+        set other {}
+        for {set i 0} {$i < 20} {incr i} {lappend small [expr {$i * 37 - 100}]}
+        for {set i 0} {$i < 300} {incr i} {lappend big [expr {$i * 2}]}
+        for {set i 0} {$i < 150} {incr i} {lappend other [expr {$i * 3 + 70000}]}
+        r sadd small{t} {*}$small
+        r sadd big{t} {*}$big
+        r sadd other{t} {*}$other
+        assert_encoding intset small{t}
+        assert_encoding intset big{t}
+        assert_encoding intset other{t}
+
+        set inter {}
+        set diff {}
+        foreach v $small {
+            if {$v >= 0 && $v < 600 && $v % 2 == 0} {lappend inter $v} else {lappend diff $v}
+        }
+        assert_equal [lsort -integer $inter] [lsort -integer [r sinter small{t} big{t}]]
+        assert_equal [llength $inter] [r sintercard 2 small{t} big{t}]
+        assert_equal {} [r sinter small{t} big{t} other{t}]
+        assert_equal [lsort -integer $diff] [lsort -integer [r sdiff small{t} big{t} other{t}]]
+
+        set union [lsort -integer -unique [concat $small $big $other]]
+        assert_equal $union [lsort -integer [r sunion small{t} big{t} other{t}]]
+        assert_equal [llength $union] [r sunionstore res{t} small{t} big{t} other{t}]
+        assert_equal $union [lsort -integer [r smembers res{t}]]
+        assert_encoding intset res{t}
+
+        # The union no longer fits in an intset
+        set origin_max [lindex [r config get set-max-intset-entries] 1]
+        r config set set-max-intset-entries 400
+        assert_equal [llength $union] [r sunionstore res{t} small{t} big{t} other{t}]
+        assert_equal $union [lsort -integer [r smembers res{t}]]
+        assert_encoding hashtable res{t}
+        r config set set-max-intset-entries $origin_max
+    }
+
     test "SDIFF with first set empty" {
         r del set1{t} set2{t} set3{t}
         r sadd set2{t} 1 2 3 4
@@ -526,6 +526,34 @@ start_server {
         $rd2 close
     }
 
+    test {Blocking XREADGROUP consumers with no new entries are not woken up} {
+        r DEL mystream
+        r XGROUP CREATE mystream mygroup $ MKSTREAM
+
+        set clients {}
+        for {set j 0} {$j < 10} {incr j} {
+            set rd [valkey_deferring_client]
+            $rd xreadgroup GROUP mygroup consumer$j BLOCK 0 STREAMS mystream >
+            lappend clients $rd
+        }
+        wait_for_blocked_clients_count 10
+
+        # Only the first consumer gets the entry, the command of the others
+        # isn't executed again, so they don't look the key up.
+        r config resetstat
+        r xadd mystream 1-0 f v
+        assert_equal {{mystream {{1-0 {f v}}}}} [[lindex $clients 0] read]
+        wait_for_blocked_clients_count 9
+        assert_range [s keyspace_hits] 1 4
+
+        # The others are served in the order they blocked.
+        for {set j 1} {$j < 10} {incr j} {
+            r xadd mystream $j-1 f v$j
+            assert_equal "{mystream {{$j-1 {f v$j}}}}" [[lindex $clients $j] read]
+        }
+        foreach rd $clients { $rd close }
+    }
+
     test {XGROUP DESTROY should unblock XREADGROUP with -NOGROUP} {
         r config resetstat
         r del mystream
@@ -916,6 +944,32 @@ start_server {
         assert_equal [dict get $reply entries] "{100-0 {a 1}}"
     }
 
+    test {Consumer PELs see the delivery info kept in the group PEL} {
+        r del x
+        for {set i 1} {$i <= 5} {incr i} { r XADD x $i-0 f v }
+        r XGROUP CREATE x g 0
+        r XREADGROUP GROUP g Alice COUNT 3 STREAMS x >
+        r XREADGROUP GROUP g Bob COUNT 2 STREAMS x >
+        # Reading the history of Alice counts a new delivery.
+        r XREADGROUP GROUP g Alice COUNT 1 STREAMS x 0
+        r XCLAIM x g Bob 0 2-0 RETRYCOUNT 7
+        r XAUTOCLAIM x g Alice 0 5-0 COUNT 1
+
+        foreach reload {0 1} {
+            if {$reload} { r debug reload }
+            assert_equal {{1-0 Alice 2} {2-0 Bob 7} {3-0 Alice 1} {4-0 Bob 1} {5-0 Alice 2}} \
+                [lmap e [r XPENDING x g - + 10] {list [lindex $e 0] [lindex $e 1] [lindex $e 3]}]
+            assert_equal {{1-0 2} {3-0 1} {5-0 2}} \
+                [lmap e [r XPENDING x g - + 10 Alice] {list [lindex $e 0] [lindex $e 3]}]
+            set group [lindex [dict get [r XINFO STREAM x FULL] groups] 0]
+            set bob [lindex [dict get $group consumers] 1]
+            assert_equal {{2-0 7} {4-0 1}} [lmap e [dict get $bob pending] {list [lindex $e 0] [lindex $e 2]}]
+        }
+
+        r XGROUP DELCONSUMER x g Alice
+        assert_equal {2-0 4-0} [lmap e [r XPENDING x g - + 10] {lindex $e 0}]
+    } {} {needs:debug}
+
     test {Consumer seen-time and active-time} {
         r DEL mystream
         r XGROUP CREATE mystream mygroup $ MKSTREAM
@@ -357,6 +357,43 @@ start_server {
         $rd close
     }
 
+    test {Blocking XREAD clients reading the same entries get the same reply} {
+        r DEL s1
+        r XADD s1 1-0 old v
+        set clients {}
+        for {set j 0} {$j < 12} {incr j} {
+            set rd [valkey_deferring_client]
+            if {$j % 2} {
+                $rd hello 3
+                $rd read
+            }
+            switch [expr {$j % 4}] {
+                0 - 1 { $rd XREAD BLOCK 0 STREAMS s1 $ }
+                2 { $rd XREAD COUNT 1 BLOCK 0 STREAMS s1 $ }
+                3 { $rd XREAD BLOCK 0 STREAMS s2 s1 $ $ }
+            }
+            lappend clients $rd
+        }
+        wait_for_blocked_clients_count 12
+
+        r MULTI
+        r XADD s1 2-0 a 1
+        r XADD s1 3-0 b [string repeat x 1000]
+        r EXEC
+        set all [list {2-0 {a 1}} [list 3-0 [list b [string repeat x 1000]]]]
+        for {set j 0} {$j < 12} {incr j} {
+            set reply [[lindex $clients $j] read]
+            # RESP3 replies are maps.
+            if {$j % 2} { set reply [list $reply] }
+            switch [expr {$j % 4}] {
+                0 - 1 { assert_equal [list [list s1 $all]] $reply }
+                2 { assert_equal [list [list s1 [lrange $all 0 0]]] $reply }
+                3 { assert_equal [list [list s1 $all]] $reply }
+            }
+        }
+        foreach rd $clients { $rd close }
+    }
+
     test {Blocking XREAD will not reply with an empty array} {
         r del s1
         r XADD s1 666 f v
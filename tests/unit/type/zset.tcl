@@ -1543,6 +1543,65 @@ start_server {tags {"zset"}} {
         }
     }
 
+    test {ZUNIONSTORE/ZINTERSTORE results have consistent ranks} {
+        # The results are built by appending to the skiplist, check that
+        # every element is ranked and scored as in a model of the result.
+        r del one{t} two{t} dest{t}
+        set cmd1 [list r zadd one{t}]
+        set cmd2 [list r zadd two{t}]
+        for {set j 0} {$j < 1000} {incr j} {
+            lappend cmd1 [randomInt 50] [randomInt 1000]
+            lappend cmd2 [randomInt 50] [randomInt 1000]
+        }
+        {*}$cmd1
+        {*}$cmd2
+        foreach {ele score} [r zrange one{t} 0 -1 withscores] {set s1($ele) $score}
+        foreach {ele score} [r zrange two{t} 0 -1 withscores] {set s2($ele) $score}
+
+        foreach op {zunionstore zinterstore} {
+            set model {}
+            foreach ele [lsort -unique [concat [array names s1] [array names s2]]] {
+                set in1 [info exists s1($ele)]
+                set in2 [info exists s2($ele)]
+                if {$op eq {zinterstore} && !($in1 && $in2)} continue
+                set score 0
+                if {$in1} {incr score $s1($ele)}
+                if {$in2} {incr score [expr {$s2($ele) * 2}]}
+                lappend model [list $ele $score]
+            }
+            set model [lsort -command {apply {{a b} {
+                set c [expr {[lindex $a 1] - [lindex $b 1]}]
+                if {$c != 0} {return $c}
+                string compare [lindex $a 0] [lindex $b 0]
+            }}} $model]
+
+            assert_equal [llength $model] [r $op dest{t} 2 one{t} two{t} weights 1 2]
+            assert_encoding skiplist dest{t}
+            set rank 0
+            foreach item $model {
+                lassign $item ele score
+                assert_equal $rank [r zrank dest{t} $ele]
+                assert_equal [expr {[llength $model] - $rank - 1}] [r zrevrank dest{t} $ele]
+                assert_equal [list $ele $score] [r zrange dest{t} $rank $rank withscores]
+                incr rank
+            }
+            set ops [string range $op 0 end-5]
+            assert_equal [join $model] [r $ops 2 one{t} two{t} weights 1 2 withscores]
+        }
+    }
+
+    test {ZUNIONSTORE/ZINTERSTORE build small results as listpack} {
+        r del one{t} two{t} dest{t}
+        r zadd one{t} 3 a 1 b 2 c
+        r zadd two{t} 1 c 5 d 0 a
+        assert_equal 4 [r zunionstore dest{t} 2 one{t} two{t}]
+        assert_encoding listpack dest{t}
+        assert_equal {b 1 a 3 c 3 d 5} [r zrange dest{t} 0 -1 withscores]
+        assert_equal 2 [r zinterstore dest{t} 2 one{t} two{t} aggregate max]
+        assert_encoding listpack dest{t}
+        assert_equal {c 2 a 3} [r zrange dest{t} 0 -1 withscores]
+    }
+
     test "ZUNIONSTORE/ZINTERSTORE/ZDIFFSTORE error if using WITHSCORES " {
         assert_error "*ERR*syntax*" {r zunionstore foo{t} 2 zsetd{t} zsetf{t} withscores}
         assert_error "*ERR*syntax*" {r zinterstore foo{t} 2 zsetd{t} zsetf{t} withscores}